@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineBroadcaster.h"
+
+FHierarchicalStateMachineBroadcaster::~FHierarchicalStateMachineBroadcaster()
+{
+	for (auto& indicesPair : m_subscriptionIndices)
+	{
+		indicesPair.Key->m_broadcasters.Remove(this);
+	}
+	m_subscriptionIndices.Empty();
+	m_subscriptions.Empty();
+}
+
+void FHierarchicalStateMachineBroadcaster::Register(FHierarchicalStateMachine* _stateMachine)
+{
+	STATEMACHINE_ASSERT(_stateMachine);
+	STATEMACHINE_ASSERT_MSG(!_stateMachine->m_broadcasters.Contains(this), TEXT("State Machine already registered."));
+
+	_stateMachine->m_broadcasters.Add(this);
+	TArray<int32>& subscriptionIndices = m_subscriptionIndices.Add(_stateMachine);
+	subscriptionIndices.Init(INDEX_NONE, _stateMachine->m_events.Num());
+	for (auto& eventPair : _stateMachine->m_eventIds)
+	{
+		// Timers of unrelated machines share the names of their events
+		if (_stateMachine->m_events[eventPair.Value].timed)
+			continue;
+
+		subscriptionIndices[eventPair.Value] = m_subscriptions.FindOrAdd(eventPair.Key).Add(Subscription{ _stateMachine, eventPair.Value });
+	}
+}
+
+void FHierarchicalStateMachineBroadcaster::Unregister(FHierarchicalStateMachine* _stateMachine)
+{
+	if (_stateMachine->m_broadcasters.Remove(this) == 0)
+		return;
+
+	TArray<int32> subscriptionIndices;
+	m_subscriptionIndices.RemoveAndCopyValue(_stateMachine, subscriptionIndices);
+	for (auto& eventPair : _stateMachine->m_eventIds)
+	{
+		const int32 subscriptionIndex = subscriptionIndices.IsValidIndex(eventPair.Value) ? subscriptionIndices[eventPair.Value] : INDEX_NONE;
+		if (subscriptionIndex == INDEX_NONE)
+			continue;
+
+		TArray<Subscription>& subscriptions = m_subscriptions.FindChecked(eventPair.Key);
+		STATEMACHINE_ASSERT(subscriptions[subscriptionIndex].stateMachine == _stateMachine);
+		subscriptions.RemoveAtSwap(subscriptionIndex, 1, false);
+		if (subscriptionIndex < subscriptions.Num())
+		{
+			// The last subscription took its place
+			const Subscription& moved = subscriptions[subscriptionIndex];
+			m_subscriptionIndices.FindChecked(moved.stateMachine)[moved.eventId] = subscriptionIndex;
+		}
+		else if (subscriptions.Num() == 0)
+		{
+			m_subscriptions.Remove(eventPair.Key);
+		}
+	}
+}
+
+int32 FHierarchicalStateMachineBroadcaster::Broadcast(FName _eventName, bool _onlyIfHandled)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_Broadcast);
+
+	const TArray<Subscription>* subscriptions = m_subscriptions.Find(_eventName);
+	if (!subscriptions)
+		return 0;
+
+	// Local, a callback may broadcast again
+	TArray<FHierarchicalStateMachine*> dequeuingStateMachines;
+	int32 queuedCount = 0;
+	for (const Subscription& subscription : *subscriptions)
+	{
+		FHierarchicalStateMachine* stateMachine = subscription.stateMachine;
+		if (_onlyIfHandled && !stateMachine->_CanReactToEvent(subscription.eventId))
+			continue;
+
+		if (!stateMachine->_EnqueuePostedEvent(subscription.eventId))
+			continue;
+
+		++queuedCount;
+		if (stateMachine->_ShouldDequeueImmediately())
+		{
+			dequeuingStateMachines.Add(stateMachine);
+		}
+	}
+
+	for (FHierarchicalStateMachine* stateMachine : dequeuingStateMachines)
+	{
+		// Callbacks of the machines dequeued before may have stopped this one
+		if (stateMachine->_ShouldDequeueImmediately())
+		{
+			stateMachine->DequeueEvents();
+		}
+	}
+	return queuedCount;
+}
+
+int32 FHierarchicalStateMachineBroadcaster::GetSubscribersCount(FName _eventName) const
+{
+	const TArray<Subscription>* subscriptions = m_subscriptions.Find(_eventName);
+	return subscriptions ? subscriptions->Num() : 0;
+}
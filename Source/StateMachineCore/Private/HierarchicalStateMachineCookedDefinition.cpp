@@ -0,0 +1,495 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineCookedDefinition.h"
+
+#define STATEMACHINE_COOKED_MAGIC 0x434D5348 // "HSMC"
+#define STATEMACHINE_COOKED_VERSION 3
+
+// The header is followed by the tables in this order, then by namesCount null terminated UTF-8 names. Every index is into a table
+// of the same data, INDEX_NONE when there is nothing to reference.
+struct CookedHeader
+{
+	uint32 magic;
+	uint32 version;
+	int32 namesCount;
+	int32 namesSize; // In bytes
+	int32 tracksCount;
+	int32 statesCount;
+	int32 rootTracksCount;
+	int32 eventsCount;
+	int32 transitionsCount;
+	int32 timedTransitionsCount;
+};
+
+struct CookedTrack
+{
+	int32 name;
+	int32 parentState;
+	int32 defaultState;
+	uint32 independent;
+	uint32 history;
+};
+
+struct CookedState
+{
+	int32 name;
+	int32 parentTrack;
+};
+
+struct CookedEvent
+{
+	int32 name;
+	int32 transitionsCount; // Consecutive entries of the transitions table, events follow each other in id order
+	uint32 priority;
+};
+
+struct CookedTransition
+{
+	int32 sourceTrack;
+	int32 sourceState;
+	int32 targetState;
+	int32 commonTrack;
+};
+
+struct CookedTimedTransition
+{
+	int32 eventId;
+	int32 sourceState;
+	float delay;
+};
+
+struct CookedLayout
+{
+	explicit CookedLayout(const CookedHeader& _header)
+	{
+		tracksOffset = sizeof(CookedHeader);
+		statesOffset = tracksOffset + int64(_header.tracksCount) * sizeof(CookedTrack);
+		rootTracksOffset = statesOffset + int64(_header.statesCount) * sizeof(CookedState);
+		eventsOffset = rootTracksOffset + int64(_header.rootTracksCount) * sizeof(int32);
+		transitionsOffset = eventsOffset + int64(_header.eventsCount) * sizeof(CookedEvent);
+		timedTransitionsOffset = transitionsOffset + int64(_header.transitionsCount) * sizeof(CookedTransition);
+		namesOffset = timedTransitionsOffset + int64(_header.timedTransitionsCount) * sizeof(CookedTimedTransition);
+		size = namesOffset + _header.namesSize;
+	}
+
+	int64 tracksOffset;
+	int64 statesOffset;
+	int64 rootTracksOffset;
+	int64 eventsOffset;
+	int64 transitionsOffset;
+	int64 timedTransitionsOffset;
+	int64 namesOffset;
+	int64 size;
+};
+
+template<typename EntryType>
+static void WriteCookedEntry(TArray<uint8>& _data, const EntryType& _entry)
+{
+	_data.Append(reinterpret_cast<const uint8*>(&_entry), sizeof(EntryType));
+}
+
+// One copy per table, entries are not aligned in the data
+template<typename EntryType>
+static void ReadCookedTable(TArrayView<const uint8> _data, int64 _offset, int32 _count, TArray<EntryType>& _outEntries)
+{
+	_outEntries.SetNumUninitialized(_count);
+	FMemory::Memcpy(_outEntries.GetData(), _data.GetData() + _offset, _count * sizeof(EntryType));
+}
+
+static bool LogCookedLoadError(const TCHAR* _reason)
+{
+	UE_LOG(LogTemp, Error, TEXT("[StateMachine] Failed to load cooked definition: %s."), _reason);
+	return false;
+}
+
+void FHierarchicalStateMachineCookedDefinition::Cook(const FHierarchicalStateMachine& _definition, TArray<uint8>& _outData)
+{
+	typedef FHierarchicalStateMachine::Track Track;
+	typedef FHierarchicalStateMachine::State State;
+	typedef FHierarchicalStateMachine::EventTransition EventTransition;
+
+	TArray<FName> names;
+	TMap<FName, int32> nameIndices;
+	auto nameIndex = [&names, &nameIndices](FName _name)
+	{
+		if (const int32* index = nameIndices.Find(_name))
+			return *index;
+
+		nameIndices.Add(_name, names.Num());
+		return names.Add(_name);
+	};
+
+	// Tables follow the insertion order of the definition maps, which is what _AssignIndices walks: loaded states get the same indices
+	TMap<const Track*, int32> trackIndices;
+	for (auto& trackPair : _definition.m_tracks)
+	{
+		trackIndices.Add(trackPair.Value, trackIndices.Num());
+	}
+	TMap<const State*, int32> stateIndices;
+	for (auto& statePair : _definition.m_states)
+	{
+		stateIndices.Add(statePair.Value, stateIndices.Num());
+	}
+	auto trackIndex = [&trackIndices](const Track* _track) { return _track ? trackIndices.FindChecked(_track) : INDEX_NONE; };
+	auto stateIndex = [&stateIndices](const State* _state) { return _state ? stateIndices.FindChecked(_state) : INDEX_NONE; };
+
+	CookedHeader header;
+	FMemory::Memzero(header);
+	header.magic = STATEMACHINE_COOKED_MAGIC;
+	header.version = STATEMACHINE_COOKED_VERSION;
+	header.tracksCount = _definition.m_tracks.Num();
+	header.statesCount = _definition.m_states.Num();
+	header.rootTracksCount = _definition.m_rootTracks.Num();
+	header.eventsCount = _definition.m_events.Num();
+	header.timedTransitionsCount = _definition.m_timedTransitions.Num();
+	for (const FHierarchicalStateMachine::Event& evt : _definition.m_events)
+	{
+		header.transitionsCount += evt.transitions.Num();
+	}
+
+	_outData.Reset();
+	WriteCookedEntry(_outData, header); // Names are counted once every table is written
+
+	for (auto& trackPair : _definition.m_tracks)
+	{
+		const Track* track = trackPair.Value;
+		WriteCookedEntry(_outData, CookedTrack{ nameIndex(track->m_name), stateIndex(track->m_parent), stateIndex(track->m_defaultState), track->m_independent ? 1u : 0u, uint32(track->m_history) });
+	}
+
+	for (auto& statePair : _definition.m_states)
+	{
+		const State* state = statePair.Value;
+		WriteCookedEntry(_outData, CookedState{ nameIndex(state->m_name), trackIndex(state->m_parent) });
+	}
+
+	for (const Track* track : _definition.m_rootTracks)
+	{
+		WriteCookedEntry(_outData, trackIndex(track));
+	}
+
+	for (const FHierarchicalStateMachine::Event& evt : _definition.m_events)
+	{
+		WriteCookedEntry(_outData, CookedEvent{ nameIndex(evt.name), evt.transitions.Num(), evt.priority });
+	}
+
+	for (const FHierarchicalStateMachine::Event& evt : _definition.m_events)
+	{
+		for (const EventTransition* transition : evt.transitions)
+		{
+			const Track* commonTrack = transition->sourceTrack
+				? _definition._FindClosestCommonTrack(transition->sourceTrack, transition->targetState)
+				: _definition._FindClosestCommonTrack(transition->sourceState, transition->targetState);
+			WriteCookedEntry(_outData, CookedTransition{ trackIndex(transition->sourceTrack), stateIndex(transition->sourceState), stateIndex(transition->targetState), trackIndex(commonTrack) });
+		}
+	}
+
+	for (const FHierarchicalStateMachine::TimedTransition* transition : _definition.m_timedTransitions)
+	{
+		WriteCookedEntry(_outData, CookedTimedTransition{ transition->eventId, stateIndex(transition->sourceState), transition->delay });
+	}
+
+	const int32 namesOffset = _outData.Num();
+	for (const FName& name : names)
+	{
+		FTCHARToUTF8 utf8Name(*name.ToString());
+		_outData.Append(reinterpret_cast<const uint8*>(utf8Name.Get()), utf8Name.Length());
+		_outData.Add(0);
+	}
+
+	header.namesCount = names.Num();
+	header.namesSize = _outData.Num() - namesOffset;
+	FMemory::Memcpy(_outData.GetData(), &header, sizeof(CookedHeader));
+}
+
+bool FHierarchicalStateMachineCookedDefinition::Load(TArrayView<const uint8> _data, FHierarchicalStateMachine& _outDefinition)
+{
+	typedef FHierarchicalStateMachine::Track Track;
+	typedef FHierarchicalStateMachine::State State;
+	typedef FHierarchicalStateMachine::EventTransition EventTransition;
+	typedef FHierarchicalStateMachine::TimedTransition TimedTransition;
+
+	STATEMACHINE_ASSERT_MSG(!_outDefinition.IsStarted() && _outDefinition.m_tracks.Num() == 0 && _outDefinition.m_events.Num() == 0, TEXT("Cooked definitions can only be loaded into empty machines."));
+
+	if (_data.Num() < int32(sizeof(CookedHeader)))
+		return LogCookedLoadError(TEXT("truncated header"));
+
+	CookedHeader header;
+	FMemory::Memcpy(&header, _data.GetData(), sizeof(CookedHeader));
+	if (header.magic != STATEMACHINE_COOKED_MAGIC || header.version != STATEMACHINE_COOKED_VERSION)
+		return LogCookedLoadError(TEXT("unknown format or version"));
+
+	if (header.namesCount < 0 || header.namesSize < 0 || header.tracksCount < 0 || header.statesCount < 0 || header.rootTracksCount < 0
+		|| header.eventsCount < 0 || header.transitionsCount < 0 || header.timedTransitionsCount < 0 || header.statesCount > MAX_uint16)
+		return LogCookedLoadError(TEXT("invalid counts"));
+
+	const CookedLayout layout(header);
+	if (layout.size > _data.Num())
+		return LogCookedLoadError(TEXT("truncated tables"));
+
+	// Everything is checked before the machine is touched
+	TArray<FName> names;
+	names.Reserve(header.namesCount);
+	const ANSICHAR* name = reinterpret_cast<const ANSICHAR*>(_data.GetData() + layout.namesOffset);
+	const ANSICHAR* namesEnd = name + header.namesSize;
+	while (names.Num() < header.namesCount)
+	{
+		const ANSICHAR* nameEnd = name;
+		while (nameEnd < namesEnd && *nameEnd != 0)
+		{
+			++nameEnd;
+		}
+		if (nameEnd == namesEnd)
+			return LogCookedLoadError(TEXT("truncated names"));
+
+		names.Add(FName(UTF8_TO_TCHAR(name)));
+		name = nameEnd + 1;
+	}
+
+	TArray<CookedTrack> tracks;
+	TArray<CookedState> states;
+	TArray<int32> rootTracks;
+	TArray<CookedEvent> events;
+	TArray<CookedTransition> transitions;
+	TArray<CookedTimedTransition> timedTransitions;
+	ReadCookedTable(_data, layout.tracksOffset, header.tracksCount, tracks);
+	ReadCookedTable(_data, layout.statesOffset, header.statesCount, states);
+	ReadCookedTable(_data, layout.rootTracksOffset, header.rootTracksCount, rootTracks);
+	ReadCookedTable(_data, layout.eventsOffset, header.eventsCount, events);
+	ReadCookedTable(_data, layout.transitionsOffset, header.transitionsCount, transitions);
+	ReadCookedTable(_data, layout.timedTransitionsOffset, header.timedTransitionsCount, timedTransitions);
+
+	auto isValid = [](int32 _index, int32 _count) { return _index >= 0 && _index < _count; };
+	auto isValidOrNone = [&isValid](int32 _index, int32 _count) { return _index == INDEX_NONE || isValid(_index, _count); };
+
+	// Child counts, so that every map is sized once
+	TArray<int32> trackStatesCounts;
+	trackStatesCounts.SetNumZeroed(header.tracksCount);
+	TArray<int32> stateTracksCounts;
+	stateTracksCounts.SetNumZeroed(header.statesCount);
+
+	TBitArray<> usedStateNames(false, header.namesCount);
+	for (const CookedState& state : states)
+	{
+		if (!isValid(state.name, header.namesCount) || usedStateNames[state.name] || !isValid(state.parentTrack, header.tracksCount))
+			return LogCookedLoadError(TEXT("invalid state"));
+
+		usedStateNames[state.name] = true;
+		++trackStatesCounts[state.parentTrack];
+	}
+
+	TBitArray<> usedTrackNames(false, header.namesCount);
+	int32 parentlessTracksCount = 0;
+	for (int32 trackIndex = 0; trackIndex < header.tracksCount; ++trackIndex)
+	{
+		const CookedTrack& track = tracks[trackIndex];
+		if (!isValid(track.name, header.namesCount) || usedTrackNames[track.name] || !isValidOrNone(track.parentState, header.statesCount)
+			|| !isValidOrNone(track.defaultState, header.statesCount) || (track.defaultState != INDEX_NONE && states[track.defaultState].parentTrack != trackIndex) || track.history > FHierarchicalStateMachine::TrackHistory_Deep)
+			return LogCookedLoadError(TEXT("invalid track"));
+
+		usedTrackNames[track.name] = true;
+		if (track.parentState == INDEX_NONE)
+		{
+			++parentlessTracksCount;
+		}
+		else
+		{
+			++stateTracksCounts[track.parentState];
+		}
+	}
+
+	TBitArray<> rootTrackFlags(false, header.tracksCount);
+	for (int32 rootTrack : rootTracks)
+	{
+		if (!isValid(rootTrack, header.tracksCount) || rootTrackFlags[rootTrack] || tracks[rootTrack].parentState != INDEX_NONE)
+			return LogCookedLoadError(TEXT("invalid root track"));
+
+		rootTrackFlags[rootTrack] = true;
+	}
+	if (parentlessTracksCount != header.rootTracksCount)
+		return LogCookedLoadError(TEXT("orphan track"));
+
+	// Parent links must form a tree under the root tracks: a cycle would never end parent walks such as _FindClosestCommonTrack,
+	// and the nodes out of reach would never be destructed. Children are listed per parent, then walked once from the roots.
+	TArray<int32> trackStatesStarts;
+	trackStatesStarts.SetNumUninitialized(header.tracksCount + 1);
+	trackStatesStarts[0] = 0;
+	for (int32 trackIndex = 0; trackIndex < header.tracksCount; ++trackIndex)
+	{
+		trackStatesStarts[trackIndex + 1] = trackStatesStarts[trackIndex] + trackStatesCounts[trackIndex];
+	}
+	TArray<int32> stateTracksStarts;
+	stateTracksStarts.SetNumUninitialized(header.statesCount + 1);
+	stateTracksStarts[0] = 0;
+	for (int32 stateIndex = 0; stateIndex < header.statesCount; ++stateIndex)
+	{
+		stateTracksStarts[stateIndex + 1] = stateTracksStarts[stateIndex] + stateTracksCounts[stateIndex];
+	}
+
+	TArray<int32> trackStates;
+	trackStates.SetNumUninitialized(header.statesCount);
+	TArray<int32> trackStatesEnds(trackStatesStarts.GetData(), header.tracksCount);
+	for (int32 stateIndex = 0; stateIndex < header.statesCount; ++stateIndex)
+	{
+		trackStates[trackStatesEnds[states[stateIndex].parentTrack]++] = stateIndex;
+	}
+	TArray<int32> stateTracks;
+	stateTracks.SetNumUninitialized(header.tracksCount - header.rootTracksCount);
+	TArray<int32> stateTracksEnds(stateTracksStarts.GetData(), header.statesCount);
+	for (int32 trackIndex = 0; trackIndex < header.tracksCount; ++trackIndex)
+	{
+		if (tracks[trackIndex].parentState != INDEX_NONE)
+		{
+			stateTracks[stateTracksEnds[tracks[trackIndex].parentState]++] = trackIndex;
+		}
+	}
+
+	TBitArray<> visitedTracks(false, header.tracksCount);
+	TBitArray<> visitedStates(false, header.statesCount);
+	int32 visitedTracksCount = 0;
+	int32 visitedStatesCount = 0;
+	TArray<int32> pendingTracks(rootTracks);
+	while (pendingTracks.Num() != 0)
+	{
+		const int32 trackIndex = pendingTracks.Pop(false);
+		if (visitedTracks[trackIndex])
+			return LogCookedLoadError(TEXT("track reached twice"));
+
+		visitedTracks[trackIndex] = true;
+		++visitedTracksCount;
+		for (int32 i = trackStatesStarts[trackIndex]; i < trackStatesStarts[trackIndex + 1]; ++i)
+		{
+			const int32 stateIndex = trackStates[i];
+			if (visitedStates[stateIndex])
+				return LogCookedLoadError(TEXT("state reached twice"));
+
+			visitedStates[stateIndex] = true;
+			++visitedStatesCount;
+			pendingTracks.Append(stateTracks.GetData() + stateTracksStarts[stateIndex], stateTracksCounts[stateIndex]);
+		}
+	}
+	if (visitedTracksCount != header.tracksCount || visitedStatesCount != header.statesCount)
+		return LogCookedLoadError(TEXT("node out of the hierarchy"));
+
+	int64 eventTransitionsCount = 0;
+	for (const CookedEvent& evt : events)
+	{
+		if (!isValid(evt.name, header.namesCount) || evt.transitionsCount < 0 || evt.priority > MAX_uint8)
+			return LogCookedLoadError(TEXT("invalid event"));
+
+		eventTransitionsCount += evt.transitionsCount;
+	}
+	if (eventTransitionsCount != header.transitionsCount)
+		return LogCookedLoadError(TEXT("invalid event"));
+
+	for (const CookedTransition& transition : transitions)
+	{
+		if ((transition.sourceTrack == INDEX_NONE) == (transition.sourceState == INDEX_NONE) || !isValidOrNone(transition.sourceTrack, header.tracksCount)
+			|| !isValidOrNone(transition.sourceState, header.statesCount) || !isValid(transition.targetState, header.statesCount)
+			|| !isValidOrNone(transition.commonTrack, header.tracksCount))
+			return LogCookedLoadError(TEXT("invalid transition"));
+	}
+
+	for (const CookedTimedTransition& transition : timedTransitions)
+	{
+		if (!isValid(transition.eventId, header.eventsCount) || !isValid(transition.sourceState, header.statesCount))
+			return LogCookedLoadError(TEXT("invalid timed transition"));
+	}
+
+	// Every node is constructed in a single allocation owned by the machine, then linked by index
+	const SIZE_T statesOffset = Align(header.tracksCount * sizeof(Track), alignof(State));
+	const SIZE_T transitionsOffset = Align(statesOffset + header.statesCount * sizeof(State), alignof(EventTransition));
+	const SIZE_T timedTransitionsOffset = Align(transitionsOffset + header.transitionsCount * sizeof(EventTransition), alignof(TimedTransition));
+	const SIZE_T arenaSize = timedTransitionsOffset + header.timedTransitionsCount * sizeof(TimedTransition);
+
+	uint8* arena = arenaSize != 0 ? static_cast<uint8*>(FMemory::Malloc(arenaSize)) : nullptr;
+	Track* trackNodes = reinterpret_cast<Track*>(arena);
+	State* stateNodes = reinterpret_cast<State*>(arena + statesOffset);
+	EventTransition* transitionNodes = reinterpret_cast<EventTransition*>(arena + transitionsOffset);
+	TimedTransition* timedTransitionNodes = reinterpret_cast<TimedTransition*>(arena + timedTransitionsOffset);
+
+	for (int32 trackIndex = 0; trackIndex < header.tracksCount; ++trackIndex)
+	{
+		Track* track = new (trackNodes + trackIndex) Track(names[tracks[trackIndex].name], nullptr, &_outDefinition);
+		track->m_states.Reserve(trackStatesCounts[trackIndex]);
+		track->m_independent = tracks[trackIndex].independent != 0;
+		track->m_history = FHierarchicalStateMachine::TrackHistory(tracks[trackIndex].history);
+	}
+
+	for (int32 stateIndex = 0; stateIndex < header.statesCount; ++stateIndex)
+	{
+		State* state = new (stateNodes + stateIndex) State(names[states[stateIndex].name], trackNodes + states[stateIndex].parentTrack, &_outDefinition);
+		state->m_tracks.Reserve(stateTracksCounts[stateIndex]);
+	}
+
+	_outDefinition.m_tracks.Reserve(header.tracksCount);
+	for (int32 trackIndex = 0; trackIndex < header.tracksCount; ++trackIndex)
+	{
+		Track* track = trackNodes + trackIndex;
+		const CookedTrack& cookedTrack = tracks[trackIndex];
+		if (cookedTrack.parentState != INDEX_NONE)
+		{
+			track->m_parent = stateNodes + cookedTrack.parentState;
+			track->m_parent->m_tracks.Add(track->m_name, track);
+		}
+		if (cookedTrack.defaultState != INDEX_NONE)
+		{
+			track->m_defaultState = stateNodes + cookedTrack.defaultState;
+		}
+		_outDefinition.m_tracks.Add(track->m_name, track);
+	}
+
+	_outDefinition.m_states.Reserve(header.statesCount);
+	for (int32 stateIndex = 0; stateIndex < header.statesCount; ++stateIndex)
+	{
+		State* state = stateNodes + stateIndex;
+		state->m_parent->m_states.Add(state->m_name, state);
+		_outDefinition.m_states.Add(state->m_name, state);
+	}
+
+	_outDefinition.m_rootTracks.Reserve(header.rootTracksCount);
+	for (int32 rootTrack : rootTracks)
+	{
+		_outDefinition.m_rootTracks.Add(trackNodes + rootTrack);
+	}
+
+	_outDefinition.m_events.SetNum(header.eventsCount);
+	_outDefinition.m_eventIds.Reserve(header.eventsCount);
+	int32 transitionIndex = 0;
+	for (int32 eventId = 0; eventId < header.eventsCount; ++eventId)
+	{
+		FHierarchicalStateMachine::Event& evt = _outDefinition.m_events[eventId];
+		evt.name = names[events[eventId].name];
+		evt.transitions.Reserve(events[eventId].transitionsCount);
+		evt.priority = uint8(events[eventId].priority);
+		_outDefinition.m_eventIds.Add(evt.name, eventId);
+
+		for (int32 i = 0; i < events[eventId].transitionsCount; ++i, ++transitionIndex)
+		{
+			const CookedTransition& cookedTransition = transitions[transitionIndex];
+			EventTransition* transition = new (transitionNodes + transitionIndex) EventTransition();
+			transition->name = evt.name;
+			transition->sourceTrack = cookedTransition.sourceTrack != INDEX_NONE ? trackNodes + cookedTransition.sourceTrack : nullptr;
+			transition->sourceState = cookedTransition.sourceState != INDEX_NONE ? stateNodes + cookedTransition.sourceState : nullptr;
+			transition->targetState = stateNodes + cookedTransition.targetState;
+			transition->commonTrack = cookedTransition.commonTrack != INDEX_NONE ? trackNodes + cookedTransition.commonTrack : nullptr;
+			evt.transitions.Add(transition);
+		}
+	}
+
+	_outDefinition.m_timedTransitions.Reserve(header.timedTransitionsCount);
+	for (int32 i = 0; i < header.timedTransitionsCount; ++i)
+	{
+		TimedTransition* transition = new (timedTransitionNodes + i) TimedTransition();
+		transition->eventId = timedTransitions[i].eventId;
+		transition->sourceState = stateNodes + timedTransitions[i].sourceState;
+		transition->delay = timedTransitions[i].delay;
+		_outDefinition.m_events[transition->eventId].timed = true;
+		_outDefinition.m_timedTransitions.Add(transition);
+		transition->sourceState->m_timedTransitions.Add(transition);
+	}
+
+	_outDefinition.m_nodesArena = arena;
+	_outDefinition.m_nodesArenaSize = arenaSize;
+	_outDefinition.m_treeOrdersAssigned = false;
+	return true;
+}
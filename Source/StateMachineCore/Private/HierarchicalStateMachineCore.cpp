@@ -0,0 +1,2330 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineCore.h"
+#include "HierarchicalStateMachineBroadcaster.h"
+#include "HierarchicalStateMachineRecorder.h"
+#include "HierarchicalStateMachineStats.h"
+#include "HierarchicalStateMachineTrace.h"
+
+#include <Async/ParallelFor.h>
+#include <Async/TaskGraphInterfaces.h>
+#include <HAL/PlatformAtomics.h>
+
+#define STATEMACHINE_DEQUEUEEVENTS_DEFAULTLIMIT 5000
+
+// Events posted by the states ticked in a task of _TickStatesInParallel, merged once every task completed
+static thread_local const FHierarchicalStateMachine* s_parallelTickStateMachine = nullptr;
+static thread_local TArray<int32>* s_parallelPostedEvents = nullptr;
+
+#if STATEMACHINE_TRACE_ENABLED
+	#define STATEMACHINE_TRACE(type, name) if (FHierarchicalStateMachineTrace::IsEnabled()) { FHierarchicalStateMachineTrace::Write(_GetTraceId(), EHierarchicalStateMachineTraceType::type, name); }
+#else
+	#define STATEMACHINE_TRACE(type, name)
+#endif
+
+FHierarchicalStateMachine::Track::Track(FName _name, State* _parent, FHierarchicalStateMachine* _stateMachine)
+	: m_name(_name)
+	, m_parent(_parent)
+	, m_stateMachine(_stateMachine)
+{
+}
+
+
+FHierarchicalStateMachine::Track::~Track()
+{
+	for (auto& pair : m_states)
+	{
+		m_stateMachine->_DestroyNode(pair.Value);
+	}
+	m_states.Empty();
+}
+
+
+void FHierarchicalStateMachine::Track::_AssignIndices(uint16& _index)
+{
+	for (auto& statePair : m_states)
+	{
+		statePair.Value->m_index = _index;
+		++_index;
+
+		for (auto& trackPair : statePair.Value->m_tracks)
+		{
+			trackPair.Value->_AssignIndices(_index);
+		}
+	}
+}
+
+void FHierarchicalStateMachine::Track::_AssignTreeOrders(int32& _preOrder, int32& _postOrder)
+{
+	m_preOrder = _preOrder++;
+	for (auto& statePair : m_states)
+	{
+		statePair.Value->_AssignTreeOrders(_preOrder, _postOrder);
+	}
+	m_postOrder = _postOrder++;
+}
+
+FHierarchicalStateMachine::State* FHierarchicalStateMachine::Track::AddState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit)
+{
+	State* state = AddState(_name);
+
+	state->Enter = _enter;
+	state->Tick = _tick;
+	state->Exit = _exit;
+
+	return state;
+}
+
+
+FHierarchicalStateMachine::State* FHierarchicalStateMachine::Track::AddState(FName _name)
+{
+	STATEMACHINE_ASSERT_MSGF(m_stateMachine->m_states.Find(_name) == nullptr, TEXT("A State with the name \"%s\" already exists."), *_name.GetPlainNameString());
+
+	State* state = new State(_name, this, m_stateMachine);
+
+	m_states.Add(_name) = state;
+	m_stateMachine->m_states.Add(_name) = state;
+	m_stateMachine->m_treeOrdersAssigned = false;
+	return state;
+}
+
+FHierarchicalStateMachine::State* FHierarchicalStateMachine::Track::AddDefaultState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit)
+{
+	STATEMACHINE_ASSERT_MSGF(m_defaultState == nullptr, TEXT("A State with the name \"%s\" already exists."), *_name.GetPlainNameString());
+
+	State* state = AddState(_name, _enter, _tick, _exit);
+	m_defaultState = state;
+	return state;
+}
+
+
+FHierarchicalStateMachine::State* FHierarchicalStateMachine::Track::AddDefaultState(FName _name)
+{
+	State* state = AddState(_name);
+	m_defaultState = state;
+	return state;
+}
+
+FHierarchicalStateMachine::State::State(FName _name, Track* _parent, FHierarchicalStateMachine* _stateMachine)
+	: m_name(_name)
+	, m_parent(_parent)
+	, m_stateMachine(_stateMachine)
+{
+}
+
+
+FHierarchicalStateMachine::State::~State()
+{
+	for (auto& pair : m_tracks)
+	{
+		m_stateMachine->_DestroyNode(pair.Value);
+	}
+	m_tracks.Empty();
+}
+
+
+void FHierarchicalStateMachine::State::_AssignTreeOrders(int32& _preOrder, int32& _postOrder)
+{
+	m_preOrder = _preOrder++;
+	for (auto& trackPair : m_tracks)
+	{
+		trackPair.Value->_AssignTreeOrders(_preOrder, _postOrder);
+	}
+	m_postOrder = _postOrder++;
+}
+
+
+FHierarchicalStateMachine::Track* FHierarchicalStateMachine::State::AddTrack(FName _name)
+{
+	STATEMACHINE_ASSERT_MSGF(m_stateMachine->m_tracks.Find(_name) == nullptr, TEXT("A Track with the name \"%s\" already exists."), *_name.GetPlainNameString());
+
+	Track* track = new Track(_name, this, m_stateMachine);
+	m_tracks.Add(_name) = track;
+	m_stateMachine->m_tracks.Add(_name) = track;
+	m_stateMachine->m_treeOrdersAssigned = false;
+	return track;
+}
+
+
+void FHierarchicalStateMachine::State::BindBatchTick(void* _owner, StateBatchTickFunction _function)
+{
+	m_stateMachine->_SetCallbackOwner(_owner);
+	m_callbacks.batchTick = _function;
+}
+
+
+bool FHierarchicalStateMachine::State::IsInTrack(const Track* _track) const
+{
+	if (m_stateMachine->m_treeOrdersAssigned && _track->m_stateMachine == m_stateMachine)
+	{
+		return _track->m_preOrder < m_preOrder && m_postOrder < _track->m_postOrder;
+	}
+
+	Track* currentTrack = m_parent;
+	while (currentTrack != nullptr)
+	{
+		if (currentTrack == _track)
+			return true;
+
+		currentTrack = currentTrack->m_parent ? currentTrack->m_parent->m_parent : nullptr;
+	}
+	return false;
+}
+
+
+bool FHierarchicalStateMachine::State::IsInState(const State* _state) const
+{
+	if (m_stateMachine->m_treeOrdersAssigned && _state->m_stateMachine == m_stateMachine)
+	{
+		return _state->m_preOrder < m_preOrder && m_postOrder < _state->m_postOrder;
+	}
+
+	Track* currentTrack = m_parent;
+	while (currentTrack != nullptr)
+	{
+		if (currentTrack->GetParentState() == _state)
+			return true;
+
+		currentTrack = currentTrack->m_parent ? currentTrack->m_parent->m_parent : nullptr;
+	}
+	return false;
+}
+
+FHierarchicalStateMachine::FHierarchicalStateMachine()
+	: bImmediatelyDequeueEvents(true)
+	, bParallelTickTracks(false)
+	, bRejectUnhandledEvents(true)
+	, bOptimizeDefinition(false)
+#if STATEMACHINE_HISTORY_ENABLED
+	, bPrintHistoryInLog(false)
+#endif
+{
+	// Counted down from the top so that plain machines ids do not collide with the UObject unique ids used by UHierarchicalStateMachine
+	static volatile int32 s_instancesCount = 0;
+	m_traceId = MAX_uint32 - uint32(FPlatformAtomics::InterlockedIncrement(&s_instancesCount));
+
+	FHierarchicalStateMachineStats::RecordMachineCreated();
+}
+
+
+FHierarchicalStateMachine::~FHierarchicalStateMachine()
+{
+	FHierarchicalStateMachineStats::RecordMachineDestroyed();
+	for (int32 i = 0; i < m_currentStates.Num(); ++i)
+	{
+		FHierarchicalStateMachineStats::RecordStateExited();
+	}
+
+#if STATEMACHINE_TRACE_ENABLED
+	// Trace readers hold the machine until they read its Stopped event
+	if (m_started && FHierarchicalStateMachineTrace::IsEnabled())
+	{
+		FHierarchicalStateMachineTrace::Write(m_startedTraceId, EHierarchicalStateMachineTraceType::Stopped, NAME_None);
+	}
+#endif
+
+	if (m_recorder)
+	{
+		m_recorder->End();
+	}
+
+	// Before the events are destroyed, subscriptions are found by event name
+	UnregisterFromBroadcasters();
+
+	for (Event& evt : m_events)
+	{
+		for (EventTransition* transition : evt.transitions)
+		{
+			_DestroyNode(transition);
+		}
+	}
+	m_events.Empty();
+	m_eventIds.Empty();
+
+	for (TimedTransition* transition : m_timedTransitions)
+	{
+		_DestroyNode(transition);
+	}
+	m_timedTransitions.Empty();
+
+	for (Track* track : m_rootTracks)
+	{
+		_DestroyNode(track);
+	}
+	m_rootTracks.Empty();
+
+	m_tracks.Empty();
+	m_states.Empty();
+
+	FMemory::Free(m_nodesArena);
+	m_nodesArena = nullptr;
+	m_nodesArenaSize = 0;
+}
+
+
+FHierarchicalStateMachine::Track* FHierarchicalStateMachine::AddRootTrack(FName _name)
+{
+	Track* track = new Track(_name, nullptr, this);
+	return AddRootTrack(track);
+}
+
+FHierarchicalStateMachine::Track * FHierarchicalStateMachine::AddRootTrack(Track * _track)
+{
+#if DO_CHECK
+	_VisitTrack(_track, TrackVisitorDelegate::CreateRaw(this, &FHierarchicalStateMachine::_AssertIfTrackExists), StateVisitorDelegate::CreateRaw(this, &FHierarchicalStateMachine::_AssertIfStateExists));
+#endif
+
+	m_rootTracks.Add(_track);
+	m_tracks.Add(_track->m_name) = _track;
+	m_treeOrdersAssigned = false;
+	return _track;
+}
+
+
+void FHierarchicalStateMachine::AddEventTransition(FName _eventName, FName _sourceName, FName _targetStateName)
+{
+	EventTransition* eventTransition = new EventTransition();
+
+	Track** sourceTrackPtr = m_tracks.Find(_sourceName);
+	if (sourceTrackPtr)
+	{
+		eventTransition->sourceTrack = *sourceTrackPtr;
+	}
+	else
+	{
+		State** sourceStatePtr = m_states.Find(_sourceName);
+		STATEMACHINE_ASSERT_MSG(sourceStatePtr, TEXT("Source Name does not match any Track or State."));
+		eventTransition->sourceState = *sourceStatePtr;
+	}
+
+	State** targetStatePtr = m_states.Find(_targetStateName);
+	STATEMACHINE_ASSERT_MSG(targetStatePtr, TEXT("Target Name does not match any State."));
+	eventTransition->targetState = *targetStatePtr;
+
+	eventTransition->name = _eventName;
+
+	int32* eventIdPtr = m_eventIds.Find(_eventName);
+	int32 eventId = eventIdPtr ? *eventIdPtr : INDEX_NONE;
+	if (eventId == INDEX_NONE)
+	{
+		eventId = m_events.AddDefaulted();
+		m_events[eventId].name = _eventName;
+		m_eventIds.Add(_eventName, eventId);
+	}
+	STATEMACHINE_ASSERT_MSGF(!m_events[eventId].timed, TEXT("Event name \"%s\" is reserved for timed transitions."), *_eventName.ToString());
+	m_events[eventId].transitions.Add(eventTransition);
+}
+
+void FHierarchicalStateMachine::SetEventPriority(FName _eventName, uint8 _priority)
+{
+	STATEMACHINE_ASSERT_MSG(!IsStarted(), TEXT("Event priorities are part of the definition."));
+	const int32* eventIdPtr = m_eventIds.Find(_eventName);
+	STATEMACHINE_ASSERT_MSGF(eventIdPtr != nullptr, TEXT("Unknown event name \"%s\"."), *_eventName.GetPlainNameString());
+	if (!eventIdPtr)
+		return;
+
+	m_events[*eventIdPtr].priority = _priority;
+}
+
+uint8 FHierarchicalStateMachine::GetEventPriority(FName _eventName) const
+{
+	const int32* eventIdPtr = m_eventIds.Find(_eventName);
+	return eventIdPtr ? m_events[*eventIdPtr].priority : 0;
+}
+
+
+void FHierarchicalStateMachine::AddTimedTransition(FName _sourceStateName, FName _targetStateName, float _seconds)
+{
+	State** sourceStatePtr = m_states.Find(_sourceStateName);
+	STATEMACHINE_ASSERT_MSG(sourceStatePtr, TEXT("Source Name does not match any State."));
+	STATEMACHINE_ASSERT_MSG(_seconds >= 0.f, TEXT("Timed transition delay must not be negative."));
+
+	// A timed transition is an ordinary event transition whose event is posted by the machine itself when the timer expires.
+	FName eventName(TEXT("__TimedTransition"), m_timedTransitions.Num() + 1);
+	STATEMACHINE_ASSERT_MSGF(!m_eventIds.Contains(eventName), TEXT("Event name \"%s\" is reserved for timed transitions."), *eventName.ToString());
+	AddEventTransition(eventName, _sourceStateName, _targetStateName);
+
+	TimedTransition* timedTransition = new TimedTransition();
+	timedTransition->eventId = m_eventIds.FindChecked(eventName);
+	m_events[timedTransition->eventId].timed = true;
+	timedTransition->sourceState = *sourceStatePtr;
+	timedTransition->delay = _seconds;
+
+	m_timedTransitions.Add(timedTransition);
+	(*sourceStatePtr)->m_timedTransitions.Add(timedTransition);
+}
+
+
+void FHierarchicalStateMachine::Start()
+{
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_Start))
+		return;
+
+	STATEMACHINE_ASSERT(!IsStarted());
+	STATEMACHINE_ASSERT(m_currentStates.Num() == 0);
+
+	if (bOptimizeDefinition && !m_definitionOptimized)
+	{
+		DefinitionReport report;
+		OptimizeDefinition(report);
+		UE_LOG(LogTemp, Display, TEXT("[StateMachine][%s] Optimized definition: %s"), *_GetDebugName(), *report.ToString());
+	}
+
+#if STATEMACHINE_ASSERT_ENABLED
+	for (auto& trackPair : m_tracks)
+	{
+		STATEMACHINE_ASSERT_MSGF(trackPair.Value->m_defaultState, TEXT("Track \"%s\" does not have a default state set up."), *trackPair.Value->GetName().ToString());
+	}
+#endif
+
+#if STATEMACHINE_HISTORY_ENABLED
+	_LogStateMachineStarted();
+#endif
+#if STATEMACHINE_TRACE_ENABLED
+	m_startedTraceId = _GetTraceId();
+	if (FHierarchicalStateMachineTrace::IsEnabled())
+	{
+		FHierarchicalStateMachineTrace::Write(m_startedTraceId, EHierarchicalStateMachineTraceType::Started, FName(*_GetDebugName()), this);
+	}
+#endif
+
+	_AssignIndices();
+	_BuildCallbacksTable();
+	_ResetReachableEvents();
+	_ResetActiveStates();
+	_ValidateCallbackOwner();
+
+	TArray<Track*> waitingTracks;
+	for (Track* track : m_rootTracks)
+	{
+		waitingTracks.Add(track);
+	}
+
+	while (waitingTracks.Num() != 0)
+	{
+		Track* track = waitingTracks[0];
+		waitingTracks.RemoveAt(0);
+
+		// Insert state at right index
+		bool inserted = false;
+		for (int i = 0; i < m_currentStates.Num(); ++i)
+		{
+			if (track->m_defaultState->m_index < m_currentStates[i]->m_index)
+			{
+				m_currentStates.Insert(track->m_defaultState, i);
+				inserted = true;
+				break;
+			}
+		}
+		if (!inserted)
+		{
+			m_currentStates.Add(track->m_defaultState);
+		}
+		
+		for (auto& pair : track->m_defaultState->m_tracks)
+		{
+			waitingTracks.Insert(pair.Value, 0);
+		}
+	}
+
+	for (State* state : m_currentStates)
+	{
+		_EnterState(state);
+	}
+
+	m_started = true;
+
+	_DequeueEvents();
+	_OnConfigurationChanged();
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+
+void FHierarchicalStateMachine::Tick(float _dt)
+{
+	if (m_recorder && !m_recorder->_BeginTickInput(_dt))
+		return;
+
+	STATEMACHINE_ASSERT(IsStarted());
+	STATEMACHINE_ASSERT(!m_ticking);
+
+	if (!m_suspended)
+	{
+		_BeginTick(_dt);
+		_TickStates(_dt, nullptr);
+		_EndTick();
+	}
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+
+void FHierarchicalStateMachine::TickBatched(TArrayView<FHierarchicalStateMachine*> _stateMachines, float _dt)
+{
+	TArray<BatchTick> batches;
+
+	for (FHierarchicalStateMachine* stateMachine : _stateMachines)
+	{
+		STATEMACHINE_ASSERT(stateMachine->IsStarted());
+		STATEMACHINE_ASSERT(!stateMachine->m_ticking);
+
+		// Replayed as a plain Tick
+		if (stateMachine->m_recorder)
+		{
+			stateMachine->m_recorder->_BeginTickInput(_dt);
+		}
+		if (stateMachine->m_suspended)
+			continue;
+
+		stateMachine->_BeginTick(_dt);
+		stateMachine->_TickStates(_dt, &batches);
+	}
+
+	for (BatchTick& batch : batches)
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_BatchTickState);
+		batch.function(batch.owners, _dt);
+	}
+
+	for (FHierarchicalStateMachine* stateMachine : _stateMachines)
+	{
+		if (!stateMachine->m_suspended)
+		{
+			stateMachine->_EndTick();
+		}
+		if (stateMachine->m_recorder)
+		{
+			stateMachine->m_recorder->_EndInput();
+		}
+	}
+}
+
+
+void FHierarchicalStateMachine::_BeginTick(float _dt)
+{
+	m_time += _dt;
+	_PollLatentEnters();
+	_PostExpiredTimers();
+
+	_DequeueEvents();
+
+	m_ticking = true;
+}
+
+
+void FHierarchicalStateMachine::_TickStates(float _dt, TArray<BatchTick>* _batches)
+{
+	if (m_recorder)
+	{
+		m_recorder->_OnOutput(FHierarchicalStateMachineRecorder::RecordType_TickStates);
+	}
+
+	_ValidateCallbackOwner();
+
+	if (bParallelTickTracks && !_batches && _BuildTickGroups())
+	{
+		_TickStatesInParallel(_dt);
+		return;
+	}
+
+	for (State* state : m_currentStates)
+	{
+		_TickState(state, _dt, _batches);
+	}
+}
+
+void FHierarchicalStateMachine::_TickState(State* _state, float _dt, TArray<BatchTick>* _batches)
+{
+	if (m_latentEnters.Num() != 0 && IsStateEntering(_state))
+		return;
+
+	if (m_suspendedTracks.Num() != 0 && IsStateSuspended(_state))
+		return;
+
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_TickState);
+	_state->Tick.ExecuteIfBound(_dt);
+
+	if (!m_validCallbackOwner)
+		return;
+
+	const StateCallbacks& callbacks = m_callbacksTable[_state->m_index];
+	if (callbacks.tick)
+	{
+		callbacks.tick(m_validCallbackOwner, _dt);
+	}
+
+	if (callbacks.batchTick)
+	{
+		if (_batches)
+		{
+			BatchTick* batch = _batches->FindByPredicate([&callbacks](const BatchTick& _batch) { return _batch.function == callbacks.batchTick; });
+			if (!batch)
+			{
+				batch = &(*_batches)[_batches->AddDefaulted()];
+				batch->function = callbacks.batchTick;
+			}
+			batch->owners.Add(m_validCallbackOwner);
+		}
+		else
+		{
+			void* owner = m_validCallbackOwner;
+			callbacks.batchTick(TArrayView<void*>(&owner, 1), _dt);
+		}
+	}
+}
+
+bool FHierarchicalStateMachine::_BuildTickGroups()
+{
+	if (!FTaskGraphInterface::IsRunning())
+		return false;
+
+	for (TickGroup& group : m_tickGroups)
+	{
+		group.states.Reset();
+	}
+	if (m_tickGroups.Num() == 0)
+	{
+		m_tickGroups.AddDefaulted();
+	}
+
+	// Groups follow the order of their first current state, so that merged events do not depend on the previous ticks
+	int32 groupsCount = 1;
+	for (State* state : m_currentStates)
+	{
+		int32 groupIndex = 0;
+		if (state->m_independentTrack)
+		{
+			groupIndex = 1;
+			while (groupIndex < groupsCount && m_tickGroups[groupIndex].track != state->m_independentTrack)
+			{
+				++groupIndex;
+			}
+
+			if (groupIndex == groupsCount)
+			{
+				if (groupsCount == m_tickGroups.Num())
+				{
+					m_tickGroups.AddDefaulted();
+				}
+				m_tickGroups[groupIndex].track = state->m_independentTrack;
+				++groupsCount;
+			}
+		}
+		m_tickGroups[groupIndex].states.Add(state);
+	}
+
+	for (int32 i = groupsCount; i < m_tickGroups.Num(); ++i)
+	{
+		m_tickGroups[i].track = nullptr;
+	}
+	m_tickGroups.SetNum(groupsCount, false);
+	return groupsCount > 2;
+}
+
+void FHierarchicalStateMachine::_TickStatesInParallel(float _dt)
+{
+	// States outside of independent tracks may touch anything, they tick alone first
+	for (State* state : m_tickGroups[0].states)
+	{
+		_TickState(state, _dt, nullptr);
+	}
+
+	m_parallelTicking = true;
+	ParallelFor(m_tickGroups.Num() - 1, [this, _dt](int32 _index)
+	{
+		TickGroup& group = m_tickGroups[_index + 1];
+		s_parallelTickStateMachine = this;
+		s_parallelPostedEvents = &group.postedEvents;
+
+		for (State* state : group.states)
+		{
+			_TickState(state, _dt, nullptr);
+		}
+
+		s_parallelTickStateMachine = nullptr;
+		s_parallelPostedEvents = nullptr;
+	});
+	m_parallelTicking = false;
+
+	for (int32 i = 1; i < m_tickGroups.Num(); ++i)
+	{
+		for (int32 eventId : m_tickGroups[i].postedEvents)
+		{
+			_EnqueuePostedEvent(eventId);
+		}
+		m_tickGroups[i].postedEvents.Reset();
+	}
+}
+
+void FHierarchicalStateMachine::_EndTick()
+{
+	m_ticking = false;
+
+	_DequeueEvents();
+
+	if (!m_started)
+	{
+		_Stop();
+	}
+}
+
+
+void FHierarchicalStateMachine::Stop()
+{
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_Stop))
+		return;
+
+	_Stop();
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::_Stop()
+{
+	STATEMACHINE_ASSERT(IsStarted());
+	m_started = false;
+	if (!m_ticking)
+	{
+		_ValidateCallbackOwner();
+
+		for (int i = m_currentStates.Num() - 1; i >= 0; --i)
+		{
+			_ExitState(m_currentStates[i]);
+		}
+		m_currentStates.Empty();
+		m_deferredEvents.Empty();
+		m_suspended = false;
+		m_suspendedTracks.Reset();
+		_OnConfigurationChanged();
+	}
+
+#if STATEMACHINE_HISTORY_ENABLED
+	_LogStateMachineStopped();
+#endif
+	STATEMACHINE_TRACE(Stopped, NAME_None);
+}
+
+
+void FHierarchicalStateMachine::PostEvent(FName _eventName)
+{
+	const int32 eventId = _FindPublicEvent(_eventName);
+	STATEMACHINE_ASSERT_MSGF(eventId != INDEX_NONE, TEXT("Unknown event name \"%s\"."), *_eventName.GetPlainNameString());
+	if (eventId == INDEX_NONE)
+		return;
+
+	if (m_parallelTicking && s_parallelTickStateMachine == this)
+	{
+		s_parallelPostedEvents->Add(eventId);
+		return;
+	}
+
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_PostEvent, uint16(eventId)))
+		return;
+
+	if (_EnqueueEvent(eventId) && _ShouldDequeueImmediately())
+	{
+		_DequeueEvents();
+	}
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+bool FHierarchicalStateMachine::_EnqueuePostedEvent(int32 _eventId)
+{
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_PostEvent, uint16(_eventId)))
+		return false;
+
+	const bool queued = _EnqueueEvent(_eventId);
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+	return queued;
+}
+
+bool FHierarchicalStateMachine::_EnqueueEvent(int32 _eventId)
+{
+	// Nothing pending can change the configuration before this event is dequeued, so it can be rejected right away.
+	// Events left in the queue outside of a tick may outlive a restart, so those are kept.
+	if (bRejectUnhandledEvents && IsStarted() && !m_isDequeuingEvents && m_queuedEventsCount == 0 && (bImmediatelyDequeueEvents || m_ticking) && !m_reachableEvents[_eventId])
+	{
+		FHierarchicalStateMachineStats::RecordEventPosted(0);
+		FHierarchicalStateMachineStats::RecordEventRejected();
+		return false;
+	}
+
+	_PushEvent(_eventId, m_time);
+	FHierarchicalStateMachineStats::RecordEventPosted(m_queuedEventsCount);
+#if STATEMACHINE_HISTORY_ENABLED 
+	_LogEventPushed(m_events[_eventId].name);
+#endif
+	return true;
+}
+
+void FHierarchicalStateMachine::_PushEvent(int32 _eventId, double _postTime, bool _front, uint32 _enterStamp)
+{
+	// Few priorities are used per definition, a linear search beats any lookup
+	const uint8 priority = m_events[_eventId].priority;
+	int32 queueIndex = 0;
+	while (queueIndex < m_eventsQueues.Num() && m_eventsQueues[queueIndex].priority > priority)
+	{
+		++queueIndex;
+	}
+	if (queueIndex == m_eventsQueues.Num() || m_eventsQueues[queueIndex].priority != priority)
+	{
+		m_eventsQueues.InsertDefaulted(queueIndex);
+		m_eventsQueues[queueIndex].priority = priority;
+	}
+
+	TArray<QueuedEvent>& events = m_eventsQueues[queueIndex].events;
+	if (_front)
+	{
+		events.Insert(QueuedEvent{ _eventId, _enterStamp, _postTime }, 0);
+	}
+	else
+	{
+		events.Add(QueuedEvent{ _eventId, _enterStamp, _postTime });
+	}
+	++m_queuedEventsCount;
+}
+
+FHierarchicalStateMachine::QueuedEvent FHierarchicalStateMachine::_PopEvent()
+{
+	STATEMACHINE_ASSERT(m_queuedEventsCount != 0);
+	for (EventsQueue& queue : m_eventsQueues)
+	{
+		if (queue.events.Num() != 0)
+		{
+			const QueuedEvent queuedEvent = queue.events[0];
+			queue.events.RemoveAt(0, 1, false);
+			--m_queuedEventsCount;
+			return queuedEvent;
+		}
+	}
+	return QueuedEvent{ INDEX_NONE, 0, 0.0 };
+}
+
+bool FHierarchicalStateMachine::_CanReactToEvent(int32 _eventId) const
+{
+	// Pending events may change the configuration first
+	if (m_queuedEventsCount != 0 || m_isDequeuingEvents)
+		return true;
+
+	return IsStarted() && m_reachableEvents[_eventId];
+}
+
+int32 FHierarchicalStateMachine::_FindPublicEvent(FName _eventName) const
+{
+	const int32* eventIdPtr = m_eventIds.Find(_eventName);
+	return eventIdPtr && !m_events[*eventIdPtr].timed ? *eventIdPtr : INDEX_NONE;
+}
+
+
+void FHierarchicalStateMachine::GetReachableStates(int32 _transitionsCount, TArray<State*>& _outStates) const
+{
+	// Bounds the simulation on definitions where many configurations are reachable in few events
+	static const int32 s_maxConfigurations = 256;
+
+	_outStates.Reset();
+	if (!IsStarted())
+		return;
+
+	auto hashConfiguration = [](const TArray<State*>& _configuration)
+	{
+		return FCrc::MemCrc32(_configuration.GetData(), _configuration.Num() * sizeof(State*));
+	};
+
+	TArray<TArray<State*>> configurations;
+	configurations.Add(m_currentStates);
+	TMultiMap<uint32, int32> configurationIndices; // By hash of the sorted states
+	configurationIndices.Add(hashConfiguration(m_currentStates), 0);
+
+	TBitArray<> reachedStates(false, m_statesByIndex.Num());
+	TBitArray<> resolvedEvents(false, m_events.Num());
+	TArray<int32> eventIds;
+	TArray<State*> exitingStates;
+	TArray<State*> enteringStates;
+	TArray<int32, TInlineAllocator<4>> sameHashIndices;
+	int32 frontierStart = 0;
+	for (int32 depth = 0; depth < _transitionsCount; ++depth)
+	{
+		const int32 frontierEnd = configurations.Num();
+		for (int32 i = frontierStart; i < frontierEnd; ++i)
+		{
+			// Only the events indexed on the states of the configuration can fire from it, see _BuildEventIndex
+			eventIds.Reset();
+			resolvedEvents.Init(false, m_events.Num());
+			auto addEvents = [&eventIds, &resolvedEvents](const TArray<int32>& _eventIds)
+			{
+				for (int32 eventId : _eventIds)
+				{
+					if (!resolvedEvents[eventId])
+					{
+						resolvedEvents[eventId] = true;
+						eventIds.Add(eventId);
+					}
+				}
+			};
+			addEvents(m_rootReachableEventIds);
+			for (const State* state : configurations[i])
+			{
+				addEvents(state->m_reachableEventIds);
+			}
+
+			for (int32 eventId : eventIds)
+			{
+				exitingStates.Reset();
+				enteringStates.Reset();
+				_ResolveEvent(configurations[i], eventId, exitingStates, enteringStates);
+				if (enteringStates.Num() == 0)
+					continue;
+
+				for (State* state : enteringStates)
+				{
+					if (!reachedStates[state->GetIndex()])
+					{
+						reachedStates[state->GetIndex()] = true;
+						_outStates.Add(state);
+					}
+				}
+
+				if (depth + 1 == _transitionsCount || configurations.Num() >= s_maxConfigurations)
+					continue;
+
+				TArray<State*> nextConfiguration = configurations[i];
+				for (State* state : exitingStates)
+				{
+					nextConfiguration.Remove(state);
+				}
+				nextConfiguration.Append(enteringStates);
+				nextConfiguration.Sort([](const State& _stateA, const State& _stateB) { return _stateA.GetIndex() < _stateB.GetIndex(); });
+
+				const uint32 hash = hashConfiguration(nextConfiguration);
+				sameHashIndices.Reset();
+				configurationIndices.MultiFind(hash, sameHashIndices);
+				if (sameHashIndices.ContainsByPredicate([&configurations, &nextConfiguration](int32 _index) { return configurations[_index] == nextConfiguration; }))
+					continue;
+
+				configurationIndices.Add(hash, configurations.Num());
+				configurations.Add(MoveTemp(nextConfiguration));
+			}
+		}
+		frontierStart = frontierEnd;
+	}
+}
+
+FString FHierarchicalStateMachine::DefinitionReport::ToString() const
+{
+	auto joinNames = [](const TArray<FName>& _names)
+	{
+		FString string;
+		for (const FName& name : _names)
+		{
+			string += string.IsEmpty() ? TEXT("") : TEXT(", ");
+			string += name.ToString();
+		}
+		return string;
+	};
+
+	FString string = FString::Printf(TEXT("%d unreachable states, %d dead events, %d grouping tracks."), unreachableStates.Num(), deadEvents.Num(), groupingTracks.Num());
+	if (unreachableStates.Num() != 0)
+	{
+		string += TEXT("\nUnreachable states: ") + joinNames(unreachableStates);
+	}
+	if (deadEvents.Num() != 0)
+	{
+		string += TEXT("\nDead events: ") + joinNames(deadEvents);
+	}
+	if (groupingTracks.Num() != 0)
+	{
+		string += TEXT("\nGrouping tracks: ") + joinNames(groupingTracks);
+	}
+	if (definitionSizeBefore != 0)
+	{
+		string += FString::Printf(TEXT("\nRemoved %d states, %d tracks and %d transitions. Default configuration: %d -> %d states. Definition: %llu -> %llu bytes."),
+			removedStatesCount, removedTracksCount, removedTransitionsCount, defaultStatesCountBefore, defaultStatesCountAfter, uint64(definitionSizeBefore), uint64(definitionSizeAfter));
+	}
+	return string;
+}
+
+void FHierarchicalStateMachine::AnalyzeDefinition(DefinitionReport& _outReport) const
+{
+	_outReport = DefinitionReport();
+
+	TSet<const State*> enterableStates;
+	_CollectEnterableStates(enterableStates);
+
+	for (auto& statePair : m_states)
+	{
+		if (!enterableStates.Contains(statePair.Value))
+		{
+			_outReport.unreachableStates.Add(statePair.Key);
+		}
+	}
+
+	// Sources and targets of every transition, timed ones included
+	TSet<const Track*> transitionTracks;
+	TSet<const State*> transitionStates;
+	for (const Event& evt : m_events)
+	{
+		bool canFire = false;
+		for (const EventTransition* transition : evt.transitions)
+		{
+			canFire |= _CanTransitionFire(transition, enterableStates);
+			transitionTracks.Add(transition->sourceTrack);
+			transitionStates.Add(transition->sourceState);
+			transitionStates.Add(transition->targetState);
+		}
+		if (!canFire)
+		{
+			_outReport.deadEvents.Add(evt.name);
+		}
+	}
+
+	for (auto& trackPair : m_tracks)
+	{
+		const Track* track = trackPair.Value;
+		const State* state = track->m_defaultState;
+		// Flattening a deep history track would leave its sub tracks without history
+		if (track->m_states.Num() != 1 || !state || transitionTracks.Contains(track) || track->m_history == TrackHistory_Deep)
+			continue;
+
+		if (!enterableStates.Contains(state) || transitionStates.Contains(state) || _HasCallbacks(state) || !_CanRemoveState(state))
+			continue;
+
+		_outReport.groupingTracks.Add(trackPair.Key);
+	}
+}
+
+void FHierarchicalStateMachine::OptimizeDefinition(DefinitionReport& _outReport)
+{
+	STATEMACHINE_ASSERT_MSG(!IsStarted() && m_currentStates.Num() == 0, TEXT("The definition can only be optimized while the machine is stopped."));
+
+	AnalyzeDefinition(_outReport);
+
+	SIZE_T runtimeSize = 0;
+	GetAllocatedSize(_outReport.definitionSizeBefore, runtimeSize);
+	_outReport.defaultStatesCountBefore = _CountDefaultStates();
+
+	// Unreachable states are removed with their whole sub tree, which is unreachable as well
+	TArray<State*> removedStates;
+	TSet<const State*> removedSubStates;
+	TSet<const Track*> removedSubTracks;
+	for (const FName& stateName : _outReport.unreachableStates)
+	{
+		State* state = m_states.FindChecked(stateName);
+		if (removedSubStates.Contains(state))
+			continue;
+
+		bool canRemove = true;
+		_VisitState(state, TrackVisitorDelegate::CreateLambda([](Track*) { return true; }), StateVisitorDelegate::CreateLambda([this, &canRemove](State* _state)
+		{
+			canRemove = _CanRemoveState(_state);
+			return canRemove;
+		}));
+		if (!canRemove)
+			continue;
+
+		_VisitState(state, TrackVisitorDelegate::CreateLambda([&removedSubTracks](Track* _track) { removedSubTracks.Add(_track); return true; }),
+			StateVisitorDelegate::CreateLambda([&removedSubStates](State* _state) { removedSubStates.Add(_state); return true; }));
+		removedStates.Add(state);
+	}
+
+	// Keeps only the roots of the removed sub trees, in case a state was listed before its parent
+	removedStates.RemoveAll([&removedSubStates](const State* _state) { return _state->m_parent->m_parent && removedSubStates.Contains(_state->m_parent->m_parent); });
+
+	for (Event& evt : m_events)
+	{
+		for (int32 i = evt.transitions.Num() - 1; i >= 0; --i)
+		{
+			EventTransition* transition = evt.transitions[i];
+			if (removedSubTracks.Contains(transition->sourceTrack) || removedSubStates.Contains(transition->sourceState) || removedSubStates.Contains(transition->targetState))
+			{
+				_DestroyNode(transition);
+				evt.transitions.RemoveAt(i);
+				++_outReport.removedTransitionsCount;
+			}
+		}
+	}
+
+	for (int32 i = m_timedTransitions.Num() - 1; i >= 0; --i)
+	{
+		if (removedSubStates.Contains(m_timedTransitions[i]->sourceState))
+		{
+			_DestroyNode(m_timedTransitions[i]);
+			m_timedTransitions.RemoveAt(i);
+		}
+	}
+
+	for (const State* state : removedSubStates)
+	{
+		m_states.Remove(state->m_name);
+	}
+	for (const Track* track : removedSubTracks)
+	{
+		m_tracks.Remove(track->m_name);
+	}
+	_outReport.removedStatesCount += removedSubStates.Num();
+	_outReport.removedTracksCount += removedSubTracks.Num();
+
+	for (State* state : removedStates)
+	{
+		Track* track = state->m_parent;
+		track->m_states.Remove(state->m_name);
+		if (track->m_defaultState == state)
+		{
+			track->m_defaultState = nullptr;
+		}
+		_DestroyNode(state);
+	}
+
+	for (const FName& trackName : _outReport.groupingTracks)
+	{
+		_FlattenTrack(m_tracks.FindChecked(trackName));
+		++_outReport.removedTracksCount;
+		++_outReport.removedStatesCount;
+	}
+
+	// Closest common tracks may have been flattened, they are resolved again at Start
+	for (Event& evt : m_events)
+	{
+		for (EventTransition* transition : evt.transitions)
+		{
+			transition->commonTrack = nullptr;
+		}
+	}
+
+	GetAllocatedSize(_outReport.definitionSizeAfter, runtimeSize);
+	_outReport.defaultStatesCountAfter = _CountDefaultStates();
+
+	m_treeOrdersAssigned = false;
+	m_definitionOptimized = true;
+}
+
+bool FHierarchicalStateMachine::_HasCallbacks(const State* _state)
+{
+	const StateCallbacks& callbacks = _state->m_callbacks;
+	if (callbacks.enter || callbacks.tick || callbacks.exit || callbacks.batchTick)
+		return true;
+
+	return _state->Enter.IsBound() || _state->Tick.IsBound() || _state->Exit.IsBound() || _state->LatentEnter.IsBound() || _state->m_timedTransitions.Num() != 0;
+}
+
+bool FHierarchicalStateMachine::_CanTransitionFire(const EventTransition* _transition, const TSet<const State*>& _enterableStates) const
+{
+	const Track* commonTrack = _transition->sourceTrack
+		? _FindClosestCommonTrack(_transition->sourceTrack, _transition->targetState)
+		: _FindClosestCommonTrack(_transition->sourceState, _transition->targetState);
+	if (!commonTrack)
+		return false;
+
+	// Same owner as in _BuildEventIndex
+	const State* owner = _transition->sourceState ? _transition->sourceState : commonTrack->GetParentState();
+	return !owner || _enterableStates.Contains(owner);
+}
+
+void FHierarchicalStateMachine::_CollectEnterableStates(TSet<const State*>& _outStates) const
+{
+	TArray<const State*> pendingStates;
+	for (const Track* track : m_rootTracks)
+	{
+		pendingStates.Add(track->m_defaultState);
+	}
+
+	bool addedStates = true;
+	while (addedStates)
+	{
+		// Entering a state enters the default states of its tracks
+		addedStates = false;
+		while (pendingStates.Num() != 0)
+		{
+			const State* state = pendingStates.Pop(false);
+			if (!state || _outStates.Contains(state))
+				continue;
+
+			_outStates.Add(state);
+			addedStates = true;
+			for (auto& trackPair : state->m_tracks)
+			{
+				pendingStates.Add(trackPair.Value->m_defaultState);
+			}
+		}
+
+		// Entering a target enters its inactive parents too. Those are treated as entered from their defaults, which may mark a default
+		// state that the transition actually skips: the analysis can only miss unreachable states, never report a reachable one.
+		for (const Event& evt : m_events)
+		{
+			for (const EventTransition* transition : evt.transitions)
+			{
+				if (!_CanTransitionFire(transition, _outStates))
+					continue;
+
+				for (const State* state = transition->targetState; state; state = state->m_parent->m_parent)
+				{
+					if (!_outStates.Contains(state))
+					{
+						pendingStates.Add(state);
+					}
+				}
+			}
+		}
+	}
+}
+
+int32 FHierarchicalStateMachine::_CountDefaultStates() const
+{
+	int32 count = 0;
+	TArray<const Track*> waitingTracks(m_rootTracks);
+	while (waitingTracks.Num() != 0)
+	{
+		const State* state = waitingTracks.Pop(false)->m_defaultState;
+		if (!state)
+			continue;
+
+		++count;
+		for (auto& trackPair : state->m_tracks)
+		{
+			waitingTracks.Add(trackPair.Value);
+		}
+	}
+	return count;
+}
+
+void FHierarchicalStateMachine::_FlattenTrack(Track* _track)
+{
+	State* state = _track->m_defaultState;
+	State* parentState = _track->m_parent;
+
+	// Sub tracks keep their place in m_tracks, which is what _AssignIndices walks: the other states keep their relative order
+	if (parentState)
+	{
+		parentState->m_tracks.Remove(_track->m_name);
+		for (auto& trackPair : state->m_tracks)
+		{
+			trackPair.Value->m_parent = parentState;
+			parentState->m_tracks.Add(trackPair.Key, trackPair.Value);
+		}
+	}
+	else
+	{
+		int32 rootIndex = m_rootTracks.Find(_track);
+		m_rootTracks.RemoveAt(rootIndex);
+		for (auto& trackPair : state->m_tracks)
+		{
+			trackPair.Value->m_parent = nullptr;
+			m_rootTracks.Insert(trackPair.Value, rootIndex++);
+		}
+	}
+	state->m_tracks.Empty();
+
+	m_tracks.Remove(_track->m_name);
+	m_states.Remove(state->m_name);
+	_DestroyNode(_track);
+}
+
+FHierarchicalStateMachine::TrackHandle FHierarchicalStateMachine::FindTrack(FName _name) const
+{
+	return TrackHandle(m_tracks.FindRef(_name));
+}
+
+FHierarchicalStateMachine::StateHandle FHierarchicalStateMachine::FindState(FName _name) const
+{
+	return StateHandle(m_states.FindRef(_name));
+}
+
+bool FHierarchicalStateMachine::IsStateActive(StateHandle _state) const
+{
+	STATEMACHINE_ASSERT(_state.IsValid());
+	const int32 index = _state->m_index;
+	return m_activeStates.IsValidIndex(index) && m_activeStates[index];
+}
+
+float FHierarchicalStateMachine::GetTimeInState(StateHandle _state) const
+{
+	return IsStateActive(_state) ? float(m_time - m_stateEnterTimes[_state->m_index]) : 0.f;
+}
+
+bool FHierarchicalStateMachine::IsStateEntering(const State* _state) const
+{
+	for (const PendingLatentEnter& latentEnter : m_latentEnters)
+	{
+		if (latentEnter.state == _state || _state->IsInState(latentEnter.state))
+			return true;
+	}
+	return false;
+}
+
+bool FHierarchicalStateMachine::_ExitsEnteringState(const TArray<State*>& _exitingStates) const
+{
+	for (const State* state : _exitingStates)
+	{
+		if (IsStateEntering(state))
+			return true;
+	}
+	return false;
+}
+
+void FHierarchicalStateMachine::Suspend()
+{
+	STATEMACHINE_ASSERT(IsStarted());
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_Suspend))
+		return;
+
+	m_suspended = true;
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::Resume()
+{
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_Resume))
+		return;
+
+	m_suspended = false;
+	if (_ShouldDequeueImmediately() && m_queuedEventsCount != 0)
+	{
+		_DequeueEvents();
+	}
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::SuspendTrack(TrackHandle _track)
+{
+	STATEMACHINE_ASSERT(IsStarted() && _track.IsValid());
+	if (m_recorder && !m_recorder->_BeginTrackInput(FHierarchicalStateMachineRecorder::RecordType_SuspendTrack, _track.Get()))
+		return;
+
+	m_suspendedTracks.AddUnique(_track.Get());
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::ResumeTrack(TrackHandle _track)
+{
+	STATEMACHINE_ASSERT(_track.IsValid());
+	if (m_recorder && !m_recorder->_BeginTrackInput(FHierarchicalStateMachineRecorder::RecordType_ResumeTrack, _track.Get()))
+		return;
+
+	if (m_suspendedTracks.RemoveSingleSwap(_track.Get(), false) != 0)
+	{
+		_RequeueDeferredEvents();
+		if (_ShouldDequeueImmediately() && m_queuedEventsCount != 0)
+		{
+			_DequeueEvents();
+		}
+	}
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+bool FHierarchicalStateMachine::IsTrackSuspended(TrackHandle _track) const
+{
+	return m_suspendedTracks.Contains(_track.Get());
+}
+
+bool FHierarchicalStateMachine::IsStateSuspended(const State* _state) const
+{
+	// Few tracks are suspended at once, and IsInTrack is O(1) once started
+	for (const Track* track : m_suspendedTracks)
+	{
+		if (_state->IsInTrack(track))
+			return true;
+	}
+	return false;
+}
+
+bool FHierarchicalStateMachine::_HasSuspendedState(const TArray<State*>& _states) const
+{
+	for (const State* state : _states)
+	{
+		if (IsStateSuspended(state))
+			return true;
+	}
+	return false;
+}
+
+void FHierarchicalStateMachine::_PollLatentEnters()
+{
+	if (m_latentEnters.Num() == 0)
+		return;
+
+	if (m_recorder)
+	{
+		m_recorder->_OnPollLatentEnters();
+	}
+
+	int32 completedCount = m_latentEnters.RemoveAll([this](const PendingLatentEnter& _latentEnter)
+	{
+		if (!_latentEnter.task->IsComplete())
+			return false;
+
+		if (m_recorder)
+		{
+			m_recorder->_OnLatentEnterCompleted(_latentEnter.state);
+		}
+		return true;
+	});
+	if (completedCount != 0)
+	{
+		_RequeueDeferredEvents();
+	}
+}
+
+void FHierarchicalStateMachine::_RequeueDeferredEvents()
+{
+	// Deferred events go first within their priority, in their original order. Those still blocked are deferred again.
+	for (int32 i = m_deferredEvents.Num() - 1; i >= 0; --i)
+	{
+		_PushEvent(m_deferredEvents[i].eventId, m_deferredEvents[i].postTime, true, m_deferredEvents[i].enterStamp);
+	}
+	m_deferredEvents.Reset();
+}
+
+
+bool FHierarchicalStateMachine::CanHandleEvent(FName _eventName) const
+{
+	if (!IsStarted())
+		return false;
+
+	const int32 eventId = _FindPublicEvent(_eventName);
+	return eventId != INDEX_NONE && m_reachableEvents[eventId];
+}
+
+
+void FHierarchicalStateMachine::SerializeCurrentStates(TArray<FString>& _outStates)
+{
+	STATEMACHINE_ASSERT(!m_ticking);
+
+	for (State* state : m_currentStates)
+	{
+		_outStates.Add(state->GetName().ToString());
+	}
+}
+
+void FHierarchicalStateMachine::DeserializeCurrentStates(const TArray<FString>& _states)
+{
+	STATEMACHINE_ASSERT(!m_ticking);
+
+	TArray<State*> states;
+	for (const FString& state : _states)
+	{
+		State** statePtr = m_states.Find(FName(*state));
+		if (!statePtr)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Deserializing unknown State, aborting."));
+			return;
+		}
+		states.Add(*statePtr);
+	}
+
+	if (m_recorder && !m_recorder->_BeginDeserializeInput(_states))
+		return;
+
+	if (m_currentStates.Num() == 0)
+	{
+		_BuildCallbacksTable();
+		_ResetReachableEvents();
+		_ResetActiveStates();
+	}
+
+	_ValidateCallbackOwner();
+
+	for (int i = m_currentStates.Num() - 1; i >= 0; --i)
+	{
+		_ExitState(m_currentStates[i]);
+	}
+
+	m_currentStates = states;
+	for (auto state : m_currentStates)
+	{
+		_EnterState(state);
+	}
+	_OnConfigurationChanged();
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::_EnterState(State* _state)
+{
+	++m_configurationVersion;
+	m_activeStates[_state->m_index] = true;
+	m_stateEnterTimes[_state->m_index] = m_time;
+	m_stateEnterStamps[_state->m_index] = ++m_lastEnterStamp;
+	FHierarchicalStateMachineStats::RecordStateEntered();
+	_AddReachableEvents(_state->m_reachableEventIds);
+	if (m_recorder)
+	{
+		m_recorder->_OnOutput(FHierarchicalStateMachineRecorder::RecordType_StateEntered, _state->m_index);
+	}
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_EnterState);
+		_state->Enter.ExecuteIfBound();
+		const StateEnterFunction enter = m_callbacksTable[_state->m_index].enter;
+		if (m_validCallbackOwner && enter)
+		{
+			enter(m_validCallbackOwner);
+		}
+	}
+#if STATEMACHINE_HISTORY_ENABLED 
+	_LogStateEntered(_state);
+#endif
+	STATEMACHINE_TRACE(StateEntered, _state->m_name);
+	_ScheduleTimers(_state);
+
+	LatentTaskHandle task;
+	if (_state->LatentEnter.IsBound())
+	{
+		task = _state->LatentEnter.Execute();
+	}
+	if (m_recorder)
+	{
+		// Replays wait for the recorded completion instead
+		task = m_recorder->_OnLatentEnter(_state, task);
+	}
+	if (task.IsValid() && !task->IsComplete())
+	{
+		m_latentEnters.Add(PendingLatentEnter{ _state, task });
+	}
+}
+
+void FHierarchicalStateMachine::_ExitState(State* _state)
+{
+	++m_configurationVersion;
+	m_activeStates[_state->m_index] = false;
+	FHierarchicalStateMachineStats::RecordStateExited();
+	if (m_latentEnters.Num() != 0)
+	{
+		m_latentEnters.RemoveAll([_state](const PendingLatentEnter& _latentEnter) { return _latentEnter.state == _state; });
+	}
+	if (_state->m_parent->m_resumesHistory)
+	{
+		m_trackHistory[_state->m_parent->m_index] = _state->m_index;
+	}
+	if (m_recorder)
+	{
+		m_recorder->_OnOutput(FHierarchicalStateMachineRecorder::RecordType_StateExited, _state->m_index);
+	}
+	{
+		QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ExitState);
+		_state->Exit.ExecuteIfBound();
+		const StateExitFunction exit = m_callbacksTable[_state->m_index].exit;
+		if (m_validCallbackOwner && exit)
+		{
+			exit(m_validCallbackOwner);
+		}
+	}
+#if STATEMACHINE_HISTORY_ENABLED 
+	_LogStateExited(_state);
+#endif
+	STATEMACHINE_TRACE(StateExited, _state->m_name);
+	_RemoveReachableEvents(_state->m_reachableEventIds);
+}
+
+void FHierarchicalStateMachine::_AddReachableEvents(const TArray<int32>& _eventIds)
+{
+	for (int32 eventId : _eventIds)
+	{
+		if (m_reachableEventCounts[eventId]++ == 0)
+		{
+			m_reachableEvents[eventId] = true;
+		}
+	}
+}
+
+void FHierarchicalStateMachine::_RemoveReachableEvents(const TArray<int32>& _eventIds)
+{
+	for (int32 eventId : _eventIds)
+	{
+		STATEMACHINE_ASSERT(m_reachableEventCounts[eventId] > 0);
+		if (--m_reachableEventCounts[eventId] == 0)
+		{
+			m_reachableEvents[eventId] = false;
+		}
+	}
+}
+
+void FHierarchicalStateMachine::RebindCallbackOwner(void* _owner)
+{
+	STATEMACHINE_ASSERT_MSG(!IsStarted(), TEXT("Raw callbacks can only be rebound while the State Machine is stopped."));
+	m_callbackOwner = _owner;
+}
+
+void FHierarchicalStateMachine::ResetRuntimeState()
+{
+	STATEMACHINE_ASSERT_MSG(!IsStarted() && !m_ticking && !m_isDequeuingEvents, TEXT("Only stopped State Machines can be reset."));
+
+	// Allocations are kept for the next use
+	for (EventsQueue& queue : m_eventsQueues)
+	{
+		queue.events.Reset();
+	}
+	m_queuedEventsCount = 0;
+	m_deferredEvents.Reset();
+	m_activeTimers.Reset();
+	m_latentEnters.Reset();
+	m_time = 0.0;
+	m_eventQueueMetrics = EventQueueMetrics();
+#if STATEMACHINE_HISTORY_ENABLED
+	m_history.Reset();
+#endif
+}
+
+void FHierarchicalStateMachine::UnregisterFromBroadcasters()
+{
+	while (m_broadcasters.Num() != 0)
+	{
+		m_broadcasters.Last()->Unregister(this);
+	}
+}
+
+void FHierarchicalStateMachine::_SetCallbackOwner(void* _owner)
+{
+	STATEMACHINE_ASSERT_MSG(!m_callbackOwner || m_callbackOwner == _owner, TEXT("All raw callbacks of a State Machine must be bound to the same object."));
+	m_callbackOwner = _owner;
+}
+
+void FHierarchicalStateMachine::_ValidateCallbackOwner()
+{
+	m_validCallbackOwner = m_callbackOwner;
+}
+
+FString FHierarchicalStateMachine::_GetDebugName() const
+{
+	return FString::Printf(TEXT("HierarchicalStateMachine_%u"), m_traceId);
+}
+
+uint32 FHierarchicalStateMachine::_GetTraceId() const
+{
+	return m_traceId;
+}
+
+void FHierarchicalStateMachine::_BuildCallbacksTable()
+{
+	int32 tableSize = 0;
+	for (auto& statePair : m_states)
+	{
+		tableSize = FMath::Max(tableSize, statePair.Value->m_index + 1);
+	}
+
+	m_callbacksTable.SetNum(tableSize);
+	for (auto& statePair : m_states)
+	{
+		m_callbacksTable[statePair.Value->m_index] = statePair.Value->m_callbacks;
+	}
+}
+
+void FHierarchicalStateMachine::_ScheduleTimers(State* _state)
+{
+	if (_state->m_timedTransitions.Num() == 0)
+		return;
+
+	// Exiting a state leaves its timers in the heap. Dropping the stale ones whenever the heap doubled keeps exits O(1) and the heap bounded.
+	if (m_activeTimers.Num() >= m_activeTimersCompactionSize)
+	{
+		m_activeTimers.RemoveAllSwap([this](const ActiveTimer& _timer) { return _IsTimerStale(_timer); }, false);
+		m_activeTimers.Heapify();
+		m_activeTimersCompactionSize = FMath::Max(32, m_activeTimers.Num() * 2);
+	}
+
+	const uint32 enterStamp = m_stateEnterStamps[_state->m_index];
+	for (TimedTransition* transition : _state->m_timedTransitions)
+	{
+		m_activeTimers.HeapPush(ActiveTimer{ m_time + transition->delay, transition, enterStamp });
+	}
+}
+
+bool FHierarchicalStateMachine::_IsTimerStale(const ActiveTimer& _timer) const
+{
+	const uint16 stateIndex = _timer.transition->sourceState->m_index;
+	return !m_activeStates[stateIndex] || m_stateEnterStamps[stateIndex] != _timer.enterStamp;
+}
+
+void FHierarchicalStateMachine::_PostExpiredTimers()
+{
+	while (m_activeTimers.Num() != 0 && m_activeTimers.HeapTop().deadline <= m_time)
+	{
+		ActiveTimer timer;
+		m_activeTimers.HeapPop(timer, false);
+		if (_IsTimerStale(timer))
+			continue;
+
+		// Tagged so that the event is dropped if the state is exited before it is dequeued
+		_PushEvent(timer.transition->eventId, m_time, false, timer.enterStamp);
+#if STATEMACHINE_HISTORY_ENABLED 
+		_LogEventPushed(m_events[timer.transition->eventId].name);
+#endif
+	}
+}
+
+void FHierarchicalStateMachine::GetAllocatedSize(SIZE_T& _outDefinitionSize, SIZE_T& _outRuntimeSize) const
+{
+	SIZE_T definitionSize = 0;
+
+	for (auto& trackPair : m_tracks)
+	{
+		const Track* track = trackPair.Value;
+		definitionSize += sizeof(Track);
+		definitionSize += track->m_states.GetAllocatedSize();
+	}
+
+	for (auto& statePair : m_states)
+	{
+		const State* state = statePair.Value;
+		definitionSize += sizeof(State);
+		definitionSize += state->m_tracks.GetAllocatedSize();
+		definitionSize += state->m_timedTransitions.GetAllocatedSize();
+		definitionSize += state->m_reachableEventIds.GetAllocatedSize();
+		definitionSize += state->Enter.GetAllocatedSize();
+		definitionSize += state->Tick.GetAllocatedSize();
+		definitionSize += state->Exit.GetAllocatedSize();
+		definitionSize += state->LatentEnter.GetAllocatedSize();
+	}
+
+	for (const Event& evt : m_events)
+	{
+		definitionSize += evt.transitions.Num() * sizeof(EventTransition);
+		definitionSize += evt.transitions.GetAllocatedSize();
+	}
+
+	definitionSize += m_timedTransitions.Num() * sizeof(TimedTransition);
+	definitionSize += m_timedTransitions.GetAllocatedSize();
+	definitionSize += m_rootTracks.GetAllocatedSize();
+	definitionSize += m_tracks.GetAllocatedSize();
+	definitionSize += m_states.GetAllocatedSize();
+	definitionSize += m_eventIds.GetAllocatedSize();
+	definitionSize += m_events.GetAllocatedSize();
+	definitionSize += m_rootReachableEventIds.GetAllocatedSize();
+	definitionSize += m_callbacksTable.GetAllocatedSize();
+	definitionSize += m_statesByIndex.GetAllocatedSize();
+
+	SIZE_T runtimeSize = 0;
+	runtimeSize += m_currentStates.GetAllocatedSize();
+	runtimeSize += m_activeStates.GetAllocatedSize();
+	runtimeSize += m_stateEnterTimes.GetAllocatedSize();
+	runtimeSize += m_stateEnterStamps.GetAllocatedSize();
+	runtimeSize += m_trackHistory.GetAllocatedSize();
+	runtimeSize += m_eventsQueues.GetAllocatedSize();
+	for (const EventsQueue& queue : m_eventsQueues)
+	{
+		runtimeSize += queue.events.GetAllocatedSize();
+	}
+	runtimeSize += m_reachableEventCounts.GetAllocatedSize();
+	runtimeSize += m_reachableEvents.GetAllocatedSize();
+	runtimeSize += m_activeTimers.GetAllocatedSize();
+	runtimeSize += m_latentEnters.GetAllocatedSize();
+	runtimeSize += m_tickGroups.GetAllocatedSize();
+	for (const TickGroup& group : m_tickGroups)
+	{
+		runtimeSize += group.states.GetAllocatedSize();
+		runtimeSize += group.postedEvents.GetAllocatedSize();
+	}
+	runtimeSize += m_deferredEvents.GetAllocatedSize();
+	runtimeSize += m_currentStatesString.GetAllocatedSize();
+#if STATEMACHINE_HISTORY_ENABLED
+	runtimeSize += m_history.GetAllocatedSize();
+#endif
+
+	_outDefinitionSize = definitionSize;
+	_outRuntimeSize = runtimeSize;
+}
+
+const FString& FHierarchicalStateMachine::GetCurrentStatesString() const
+{
+	if (m_currentStatesStringVersion != m_configurationVersion)
+	{
+		m_currentStatesString = _StringifyCurrentStates();
+		m_currentStatesStringVersion = m_configurationVersion;
+	}
+	return m_currentStatesString;
+}
+
+FString FHierarchicalStateMachine::_StringifyCurrentStates() const
+{
+	FString states;
+	states.Reserve(m_currentStates.Num() * 32);
+	for (State* state : m_currentStates)
+	{
+		State* s = state;
+		while (s->GetParentTrack()->GetParentState())
+		{
+			states += TEXT("  ");
+			s = s->GetParentTrack()->GetParentState();
+		}
+
+		states += state->GetParentTrack()->GetName().GetPlainNameString();
+		states += TEXT(": ");
+		states += state->GetName().GetPlainNameString();
+		states += TEXT("\n");
+	}
+	return states;
+}
+
+bool FHierarchicalStateMachine::_VisitTrack(Track* _track, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor)
+{
+	if (!_trackVisitor.Execute(_track))
+	{
+		return false;
+	}
+
+	for (auto& pair : _track->m_states)
+	{
+		if (!_VisitState(pair.Value, _trackVisitor, _stateVisitor))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool FHierarchicalStateMachine::_VisitState(State* _state, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor)
+{
+	if (!_stateVisitor.Execute(_state))
+	{
+		return false;
+	}
+
+	for (auto& pair : _state->m_tracks)
+	{
+		if (!_VisitTrack(pair.Value, _trackVisitor, _stateVisitor))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FHierarchicalStateMachine::_AssertIfTrackExists(Track* _track)
+{
+	STATEMACHINE_ASSERT_MSGF(m_tracks.Find(_track->m_name) == nullptr, TEXT("A Track with the name \"%s\" already exists."), *_track->m_name.GetPlainNameString());
+	return true;
+}
+
+bool FHierarchicalStateMachine::_AssertIfStateExists(State * _state)
+{
+	STATEMACHINE_ASSERT_MSGF(m_states.Find(_state->m_name) == nullptr, TEXT("A State with the name \"%s\" already exists."), *_state->m_name.GetPlainNameString());
+	return true;
+}
+
+
+void FHierarchicalStateMachine::_AssignIndices()
+{
+	uint16 index = 0;
+
+	for (auto& trackPair : m_tracks)
+	{
+		trackPair.Value->_AssignIndices(index);
+	}
+
+	int32 preOrder = 0;
+	int32 postOrder = 0;
+	for (Track* track : m_rootTracks)
+	{
+		track->_AssignTreeOrders(preOrder, postOrder);
+	}
+	m_treeOrdersAssigned = true;
+
+	uint16 trackIndex = 0;
+	for (auto& trackPair : m_tracks)
+	{
+		Track* track = trackPair.Value;
+		track->m_index = trackIndex++;
+		track->m_resumesHistory = track->m_history != TrackHistory_None;
+		for (const Track* parentTrack = track->m_parent ? track->m_parent->m_parent : nullptr; parentTrack && !track->m_resumesHistory; parentTrack = parentTrack->m_parent ? parentTrack->m_parent->m_parent : nullptr)
+		{
+			track->m_resumesHistory = parentTrack->m_history == TrackHistory_Deep;
+		}
+	}
+
+	for (auto& statePair : m_states)
+	{
+		State* state = statePair.Value;
+		state->m_independentTrack = nullptr;
+		for (const Track* track = state->m_parent; track; track = track->m_parent ? track->m_parent->m_parent : nullptr)
+		{
+			if (track->m_independent)
+			{
+				state->m_independentTrack = track;
+			}
+		}
+	}
+}
+
+void FHierarchicalStateMachine::_ResetActiveStates()
+{
+	int32 indicesCount = 0;
+	for (auto& statePair : m_states)
+	{
+		indicesCount = FMath::Max(indicesCount, statePair.Value->m_index + 1);
+	}
+
+	m_activeStates.Init(false, indicesCount);
+	m_stateEnterTimes.SetNumZeroed(indicesCount);
+	m_stateEnterStamps.SetNumZeroed(indicesCount);
+
+	m_statesByIndex.SetNumZeroed(indicesCount);
+	for (auto& statePair : m_states)
+	{
+		m_statesByIndex[statePair.Value->m_index] = statePair.Value;
+	}
+	m_trackHistory.Init(MAX_uint16, m_tracks.Num());
+}
+
+void FHierarchicalStateMachine::_BuildEventIndex()
+{
+	m_rootReachableEventIds.Empty();
+	for (auto& statePair : m_states)
+	{
+		statePair.Value->m_reachableEventIds.Empty();
+	}
+
+	for (int32 eventId = 0; eventId < m_events.Num(); ++eventId)
+	{
+		for (EventTransition* transition : m_events[eventId].transitions)
+		{
+			// Cooked definitions come with their routes already resolved
+			if (!transition->commonTrack)
+			{
+				transition->commonTrack = transition->sourceTrack
+					? _FindClosestCommonTrack(transition->sourceTrack, transition->targetState)
+					: _FindClosestCommonTrack(transition->sourceState, transition->targetState);
+			}
+
+			if (!transition->commonTrack)
+				continue;
+
+			// A state sourced transition needs its source to be active. A track sourced one needs at least one active state in the common track,
+			// which means the state owning that track is active.
+			State* owner = transition->sourceState ? transition->sourceState : transition->commonTrack->GetParentState();
+			TArray<int32>& reachableEventIds = owner ? owner->m_reachableEventIds : m_rootReachableEventIds;
+			reachableEventIds.AddUnique(eventId);
+		}
+	}
+}
+
+void FHierarchicalStateMachine::_ResetReachableEvents()
+{
+	STATEMACHINE_ASSERT(m_currentStates.Num() == 0);
+
+	_BuildEventIndex();
+
+	m_reachableEventCounts.Init(0, m_events.Num());
+	m_reachableEvents.Init(false, m_events.Num());
+	_AddReachableEvents(m_rootReachableEventIds);
+}
+
+FHierarchicalStateMachine::Track* FHierarchicalStateMachine::_FindClosestCommonTrack(const State* _stateA, const State* _stateB) const
+{
+	if (!_stateA || !_stateB)
+		return nullptr; // Root track source, nothing above it
+
+	if (_stateA->m_stateMachine != _stateB->m_stateMachine)
+		return nullptr;
+
+	if (_stateA->m_parent == _stateB->m_parent)
+		return _stateA->m_parent; // Easy skip
+
+	TArray<Track*> ATracks;
+	for (auto& pair : _stateA->m_tracks)
+	{
+		ATracks.Add(pair.Value);
+	}
+	Track* currentTrack = _stateA->m_parent;
+	while (currentTrack != nullptr)
+	{
+		ATracks.Add(currentTrack);
+		currentTrack = currentTrack->m_parent ? currentTrack->m_parent->m_parent : nullptr;
+	}
+
+	for (auto& pair : _stateB->m_tracks)
+	{
+		int32 i = ATracks.Find(pair.Value);
+		if (i != INDEX_NONE)
+		{
+			return ATracks[i];
+		}
+	}
+	currentTrack = _stateB->m_parent;
+	while (currentTrack != nullptr)
+	{
+		int32 i = ATracks.Find(currentTrack);
+		if (i != INDEX_NONE)
+		{
+			return ATracks[i];
+		}
+		currentTrack = currentTrack->m_parent ? currentTrack->m_parent->m_parent : nullptr;
+	}
+
+	return nullptr;
+}
+
+FHierarchicalStateMachine::Track* FHierarchicalStateMachine::_FindClosestCommonTrack(const Track* _trackA, const State* _stateB) const
+{
+	const State* s = _stateB;
+	while (s && s->GetParentTrack())
+	{
+		if (s->GetParentTrack() == _trackA)
+		{
+			return const_cast<FHierarchicalStateMachine::Track*>(_trackA);
+		}
+		s = s->GetParentTrack()->GetParentState();
+	}
+
+	return _FindClosestCommonTrack(_trackA->GetParentState(), _stateB);
+}
+
+bool FHierarchicalStateMachine::_AreStatesConcurrent(const State* _stateA, const State* _stateB) const
+{
+	if (_stateA == _stateB)
+		return true;
+
+	if (_stateA->m_parent == _stateB->m_parent)
+		return true; // Easy skip
+
+	TArray<const Track*> ATracks;
+	TArray<const State*> AStates;
+	{
+		const State* s = _stateA;
+		while (s)
+		{
+			AStates.Add(s);
+			ATracks.Add(s->m_parent);
+			s = s->m_parent->m_parent;
+		}
+	}
+
+	{
+		const State* s = _stateB;
+		while (s)
+		{
+			for (uint16 i = 0u; i < ATracks.Num(); ++i)
+			{
+				// NOTE(Remi|2019/08/07): If the first thing we have in common is a State, we are not concurrent. If it is a Track, we are.
+				if (AStates[i] == s) return false;
+				if (ATracks[i] == s->m_parent) return true;
+			}
+			s = s->m_parent->m_parent;
+		}
+	}
+	
+	return false;
+}
+
+void FHierarchicalStateMachine::_ResolveEvent(TArrayView<State* const> _currentStates, int32 _eventId, TArray<State*>& _outExitingStates, TArray<State*>& _outEnteringStates) const
+{
+	const TArray<EventTransition*>& transitions = m_events[_eventId].transitions;
+	for (const EventTransition* transition : transitions)
+	{
+		if (transition->sourceState && !_currentStates.Contains(transition->sourceState))
+			continue;
+
+		Track* commonTrack = transition->commonTrack;
+		if (!commonTrack)
+			continue;
+
+		for (State* state : _currentStates)
+		{
+			if (!state->IsInTrack(commonTrack))
+				continue;
+
+			if (!_AreStatesConcurrent(state, transition->targetState))
+				continue;
+
+			_outExitingStates.Add(state);
+		}
+
+		// No exiting states means transition is irrelevant
+		if (_outExitingStates.Num() == 0)
+			continue;
+
+		_outEnteringStates.Add(transition->targetState);
+		{
+			State* ascendingState = transition->targetState;
+			while (ascendingState->GetParentTrack() && ascendingState->GetParentTrack()->GetParentState() && !_currentStates.Contains(ascendingState->GetParentTrack()->GetParentState()))
+			{
+				ascendingState = ascendingState->GetParentTrack()->GetParentState();
+				_outEnteringStates.Add(ascendingState);
+			}
+		}
+
+		for (int i = 0; i < _outEnteringStates.Num(); ++i)
+		{
+			for (auto& trackPair : _outEnteringStates[i]->m_tracks)
+			{
+				bool relevant = true;
+				for (int j = 0; j < _outEnteringStates.Num(); ++j)
+				{
+					if (trackPair.Value == _outEnteringStates[j]->m_parent)
+					{
+						relevant = false;
+						break;
+					}
+				}
+
+				if (relevant)
+					_outEnteringStates.Add(_GetEntryState(trackPair.Value, _currentStates));
+			}
+		}
+	}
+
+	auto removeDuplicates = [](TArray<State*>& _array)
+	{
+		for (int i = 0; i < _array.Num(); ++i)
+		{
+			for (int j = i + 1; j < _array.Num(); ++j)
+			{
+				if (_array[i] == _array[j])
+				{
+					_array.RemoveAt(j);
+				}
+			}
+		}
+	};
+	
+	removeDuplicates(_outExitingStates);
+	removeDuplicates(_outEnteringStates);
+
+	_outExitingStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.GetIndex() > _stateB.GetIndex(); });
+	_outEnteringStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.GetIndex() < _stateB.GetIndex(); });
+}
+
+FHierarchicalStateMachine::State* FHierarchicalStateMachine::_GetEntryState(const Track* _track, TArrayView<State* const> _currentStates) const
+{
+	// Empty until Start, hence for processors too
+	if (!_track->m_resumesHistory || m_trackHistory.Num() == 0)
+		return _track->m_defaultState;
+
+	// Re-entered by the transition exiting it, before the exit updates the history
+	for (State* state : _currentStates)
+	{
+		if (state->m_parent == _track)
+			return state;
+	}
+
+	const uint16 stateIndex = m_trackHistory[_track->m_index];
+	return stateIndex != MAX_uint16 ? m_statesByIndex[stateIndex] : _track->m_defaultState;
+}
+
+void FHierarchicalStateMachine::DequeueEvents(uint16 _dequeuedEventsLimit)
+{
+	if (m_recorder && !m_recorder->_BeginInput(FHierarchicalStateMachineRecorder::RecordType_DequeueEvents, _dequeuedEventsLimit))
+		return;
+
+	_DequeueEvents(_dequeuedEventsLimit);
+
+	if (m_recorder)
+	{
+		m_recorder->_EndInput();
+	}
+}
+
+void FHierarchicalStateMachine::_DequeueEvents(uint16 _dequeuedEventsLimit)
+{
+	// Posted events wait for Resume
+	if (m_suspended)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_HSM_DequeueEvents);
+	CSV_SCOPED_TIMING_STAT(HierarchicalStateMachine, DequeueEvents);
+
+	m_isDequeuingEvents = true;
+	const uint32 configurationVersion = m_configurationVersion;
+	_ValidateCallbackOwner();
+
+	if (_dequeuedEventsLimit == -1)
+		_dequeuedEventsLimit = STATEMACHINE_DEQUEUEEVENTS_DEFAULTLIMIT;
+
+	// OPTIM: could be member arrays in order to limit allocations
+	TArray<State*> exitingStates;
+	TArray<State*> enteringStates;
+
+	const uint64 budgetEndCycles = DequeueMicrosecondsBudget > 0.f ? FPlatformTime::Cycles64() + uint64(DequeueMicrosecondsBudget / (FPlatformTime::GetSecondsPerCycle64() * 1000000.0)) : 0;
+
+	uint16 dequeuedEventsCount = 0;
+	while ((dequeuedEventsCount < _dequeuedEventsLimit) && m_queuedEventsCount != 0)
+	{
+		// Checked before each event but the first, so that every dequeue makes progress
+		if (dequeuedEventsCount != 0 && ((DequeueEventsBudget != 0 && dequeuedEventsCount >= DequeueEventsBudget) || (budgetEndCycles != 0 && FPlatformTime::Cycles64() >= budgetEndCycles)))
+		{
+			++m_eventQueueMetrics.spentBudgetsCount;
+			m_eventQueueMetrics.carriedOverEventsCount += m_queuedEventsCount;
+			FHierarchicalStateMachineStats::RecordEventsCarriedOver(m_queuedEventsCount);
+			break;
+		}
+
+		exitingStates.Empty();
+		enteringStates.Empty();
+
+		++dequeuedEventsCount;
+		const QueuedEvent queuedEvent = _PopEvent();
+		const int32 evt = queuedEvent.eventId;
+
+		const double latency = m_time - queuedEvent.postTime;
+		++m_eventQueueMetrics.dequeuedEventsCount;
+		m_eventQueueMetrics.totalLatency += latency;
+		m_eventQueueMetrics.maxLatency = FMath::Max(m_eventQueueMetrics.maxLatency, latency);
+		FHierarchicalStateMachineStats::RecordEventLatency(latency);
+#if STATEMACHINE_HISTORY_ENABLED
+		_LogEventPopped(m_events[evt].name);
+#endif
+		STATEMACHINE_TRACE(EventPopped, m_events[evt].name);
+		FHierarchicalStateMachineStats::RecordEventDequeued();
+		// No transition of this event can fire from the current configuration
+		if (!m_reachableEvents[evt])
+			continue;
+
+		// Timeout of a state exited and entered again since its timer expired. Timed transition events have a single transition.
+		if (queuedEvent.enterStamp != 0 && m_stateEnterStamps[m_events[evt].transitions[0]->sourceState->m_index] != queuedEvent.enterStamp)
+			continue;
+
+		_ResolveEvent(m_currentStates, evt, exitingStates, enteringStates);
+
+		if (m_latentEnters.Num() != 0 && _ExitsEnteringState(exitingStates))
+		{
+			m_deferredEvents.Add(queuedEvent);
+			continue;
+		}
+
+		if (m_suspendedTracks.Num() != 0 && (_HasSuspendedState(exitingStates) || _HasSuspendedState(enteringStates)))
+		{
+			m_deferredEvents.Add(queuedEvent);
+			continue;
+		}
+
+		if (exitingStates.Num() != 0 || enteringStates.Num() != 0)
+		{
+			FHierarchicalStateMachineStats::RecordTransition(exitingStates.Num(), enteringStates.Num());
+		}
+
+		// Exiting states
+		for (State* state : exitingStates)
+		{
+			_ExitState(state);
+			m_currentStates.Remove(state);
+		}
+
+		// Entering states
+		for (State* state : enteringStates)
+		{
+			_EnterState(state);
+			m_currentStates.Add(state);
+		}
+
+		m_currentStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.GetIndex() < _stateB.GetIndex(); });
+	}
+
+	if (dequeuedEventsCount >= STATEMACHINE_DEQUEUEEVENTS_DEFAULTLIMIT)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[StateMachine] Stopped events dequeuing after having dequeued more than %d events. There may be an infinite events loop somewhere."), STATEMACHINE_DEQUEUEEVENTS_DEFAULTLIMIT);
+	}
+
+	m_isDequeuingEvents = false;
+
+	if (configurationVersion != m_configurationVersion)
+	{
+		_OnConfigurationChanged();
+	}
+}
+
+#if STATEMACHINE_HISTORY_ENABLED 
+
+void FHierarchicalStateMachine::_LogStateMachineStarted()
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_StateMachineStarted;
+	entry.time = FDateTime::Now();
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Started State Machine."), GFrameNumber, *_GetDebugName());
+}
+
+void FHierarchicalStateMachine::_LogStateMachineStopped()
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_StateMachineStopped;
+	entry.time = FDateTime::Now();
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Stopped State Machine."), GFrameNumber, *_GetDebugName());
+}
+
+void FHierarchicalStateMachine::_LogStateEntered(State* _state)
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_StateEntered;
+	entry.time = FDateTime::Now();
+	entry.state = _state;
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Entered state \"%s\"."), GFrameNumber, *_GetDebugName(), *_state->m_name.GetPlainNameString());
+}
+
+void FHierarchicalStateMachine::_LogStateExited(State* _state)
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_StateExited;
+	entry.time = FDateTime::Now();
+	entry.state = _state;
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Exited state \"%s\"."), GFrameNumber, *_GetDebugName(), *_state->m_name.GetPlainNameString());
+}
+
+void FHierarchicalStateMachine::_LogEventPushed(FName _name)
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_EventPushed;
+	entry.time = FDateTime::Now();
+	entry.eventName = _name;
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Pushed event \"%s\"."), GFrameNumber, *_GetDebugName(), *_name.GetPlainNameString());
+}
+
+void FHierarchicalStateMachine::_LogEventPopped(FName _name)
+{
+	HistoryEntry entry;
+	entry.type = HistoryEntryType_EventPopped;
+	entry.time = FDateTime::Now();
+	entry.eventName = _name;
+	m_history.Add(entry);
+
+	if (bPrintHistoryInLog)
+		UE_LOG(LogTemp, Display, TEXT("[%d][%s] Popped event \"%s\"."), GFrameNumber, *_GetDebugName(), *_name.GetPlainNameString());
+}
+#endif
@@ -0,0 +1,411 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineFragment.h"
+
+#define STATEMACHINE_FRAGMENT_DEQUEUEROUNDSLIMIT 5000
+
+typedef FHierarchicalStateMachine::State FState;
+typedef FHierarchicalStateMachine::Track FTrack;
+
+FHierarchicalStateMachineProcessor::FHierarchicalStateMachineProcessor(FHierarchicalStateMachine& _definition)
+	: m_definition(&_definition)
+{
+	STATEMACHINE_ASSERT_MSG(!_definition.IsStarted(), TEXT("A started State Machine cannot be used as a shared definition."));
+	_CheckSupportedFeatures(_definition);
+
+	_definition._AssignIndices();
+	_definition._BuildEventIndex();
+
+	int32 tableSize = 0;
+	for (auto& statePair : _definition.m_states)
+	{
+		tableSize = FMath::Max(tableSize, statePair.Value->GetIndex() + 1);
+	}
+	m_callbacks.SetNum(tableSize);
+	m_exitingEntities.SetNum(tableSize);
+	m_enteringEntities.SetNum(tableSize);
+	m_tickingEntities.SetNum(tableSize);
+
+	TArray<FState*> defaultStates;
+	TArray<FTrack*> waitingTracks = _definition.m_rootTracks;
+	while (waitingTracks.Num() != 0)
+	{
+		FTrack* track = waitingTracks.Pop(false);
+		STATEMACHINE_ASSERT_MSGF(track->GetDefaultState(), TEXT("Track \"%s\" does not have a default state set up."), *track->GetName().ToString());
+		if (!track->GetDefaultState())
+			continue;
+
+		defaultStates.Add(track->GetDefaultState());
+		for (auto& pair : track->GetDefaultState()->GetTracks())
+		{
+			waitingTracks.Add(pair.Value);
+		}
+	}
+	defaultStates.Sort([](const FState& _stateA, const FState& _stateB) { return _stateA.GetIndex() < _stateB.GetIndex(); });
+	m_defaultConfigurationId = _InternConfiguration(defaultStates);
+}
+
+const TArray<FState*>& FHierarchicalStateMachineProcessor::GetCurrentStates(const FHierarchicalStateMachineFragment& _fragment) const
+{
+	static const TArray<FState*> s_noStates;
+	return _fragment.IsStarted() ? m_configurations[_fragment.configurationId].states : s_noStates;
+}
+
+int32 FHierarchicalStateMachineProcessor::_InternConfiguration(TArray<FState*>& _states)
+{
+	uint32 hash = 0;
+	for (const FState* state : _states)
+	{
+		hash = HashCombine(hash, GetTypeHash(state->GetIndex()));
+	}
+
+	TArray<int32, TInlineAllocator<4>> candidates;
+	m_configurationIds.MultiFind(hash, candidates);
+	for (int32 candidate : candidates)
+	{
+		if (m_configurations[candidate].states == _states)
+			return candidate;
+	}
+
+	int32 configurationId = m_configurations.AddDefaulted();
+	Configuration& configuration = m_configurations[configurationId];
+	configuration.states = MoveTemp(_states);
+	configuration.hash = hash;
+	m_configurationIds.Add(hash, configurationId);
+	m_cacheStats.configurationsCount = m_configurations.Num();
+	return configurationId;
+}
+
+const FHierarchicalStateMachineProcessor::CachedTransition& FHierarchicalStateMachineProcessor::_ResolveEvent(int32 _configurationId, int32 _eventId)
+{
+	const uint64 key = (uint64(_configurationId) << 32) | uint32(_eventId);
+	if (const int32* cachedTransitionId = m_cachedTransitionIds.Find(key))
+	{
+		++m_cacheStats.hits;
+		return m_cachedTransitions[*cachedTransitionId];
+	}
+	++m_cacheStats.misses;
+
+	CachedTransition transition;
+	m_definition->_ResolveEvent(m_configurations[_configurationId].states, _eventId, transition.exitingStates, transition.enteringStates);
+
+	if (transition.exitingStates.Num() == 0 && transition.enteringStates.Num() == 0)
+	{
+		transition.nextConfigurationId = _configurationId;
+	}
+	else
+	{
+		TArray<FState*> nextStates = m_configurations[_configurationId].states;
+		for (FState* state : transition.exitingStates)
+		{
+			nextStates.Remove(state);
+		}
+		nextStates.Append(transition.enteringStates);
+		nextStates.Sort([](const FState& _stateA, const FState& _stateB) { return _stateA.GetIndex() < _stateB.GetIndex(); });
+		transition.nextConfigurationId = _InternConfiguration(nextStates);
+	}
+
+	if (m_cachedTransitions.Num() >= TransitionCacheCapacity)
+	{
+		++m_cacheStats.uncached;
+		m_uncachedTransition = MoveTemp(transition);
+		return m_uncachedTransition;
+	}
+
+	int32 cachedTransitionId = m_cachedTransitions.Add(MoveTemp(transition));
+	m_cachedTransitionIds.Add(key, cachedTransitionId);
+	m_cacheStats.cachedTransitionsCount = m_cachedTransitions.Num();
+	return m_cachedTransitions[cachedTransitionId];
+}
+
+FHierarchicalStateMachineProcessor::StateCallbacks* FHierarchicalStateMachineProcessor::_FindCallbacks(FName _stateName)
+{
+	FState** statePtr = m_definition->m_states.Find(_stateName);
+	STATEMACHINE_ASSERT_MSGF(statePtr != nullptr, TEXT("Unknown state name \"%s\"."), *_stateName.GetPlainNameString());
+	return statePtr ? &m_callbacks[(*statePtr)->GetIndex()] : nullptr;
+}
+
+void FHierarchicalStateMachineProcessor::BindEnter(FName _stateName, StateEntitiesFunction _function)
+{
+	if (StateCallbacks* callbacks = _FindCallbacks(_stateName))
+	{
+		callbacks->enter = _function;
+	}
+}
+
+void FHierarchicalStateMachineProcessor::BindTick(FName _stateName, StateEntitiesTickFunction _function)
+{
+	if (StateCallbacks* callbacks = _FindCallbacks(_stateName))
+	{
+		callbacks->tick = _function;
+	}
+}
+
+void FHierarchicalStateMachineProcessor::BindExit(FName _stateName, StateEntitiesFunction _function)
+{
+	if (StateCallbacks* callbacks = _FindCallbacks(_stateName))
+	{
+		callbacks->exit = _function;
+	}
+}
+
+void FHierarchicalStateMachineProcessor::_CheckSupportedFeatures(const FHierarchicalStateMachine& _definition)
+{
+#if STATEMACHINE_ASSERT_ENABLED
+	// Fragments would silently run these differently from a machine, so the definition must not use them
+	STATEMACHINE_ASSERT_MSG(_definition.m_timedTransitions.Num() == 0, TEXT("Timed transitions are not supported by processors."));
+	STATEMACHINE_ASSERT_MSG(_definition.DequeueEventsBudget == 0 && _definition.DequeueMicrosecondsBudget <= 0.f, TEXT("Dequeue budgets are not supported by processors."));
+
+	for (auto& trackPair : _definition.m_tracks)
+	{
+		const FTrack* track = trackPair.Value;
+		STATEMACHINE_ASSERT_MSGF(track->GetHistory() == FHierarchicalStateMachine::TrackHistory_None, TEXT("Track \"%s\" has a history, which is not supported by processors."), *track->GetName().ToString());
+		STATEMACHINE_ASSERT_MSGF(!track->IsIndependent(), TEXT("Track \"%s\" is independent, which is not supported by processors."), *track->GetName().ToString());
+	}
+	for (auto& statePair : _definition.m_states)
+	{
+		STATEMACHINE_ASSERT_MSGF(!statePair.Value->LatentEnter.IsBound(), TEXT("State \"%s\" has a latent enter, which is not supported by processors."), *statePair.Key.ToString());
+	}
+	for (const FHierarchicalStateMachine::Event& evt : _definition.m_events)
+	{
+		STATEMACHINE_ASSERT_MSGF(evt.priority == 0, TEXT("Event \"%s\" has a priority, which is not supported by processors."), *evt.name.GetPlainNameString());
+	}
+#endif
+}
+
+int32 FHierarchicalStateMachineProcessor::FindEvent(FName _eventName) const
+{
+	const int32 eventId = m_definition->_FindPublicEvent(_eventName);
+	STATEMACHINE_ASSERT_MSGF(eventId != INDEX_NONE, TEXT("Unknown event name \"%s\"."), *_eventName.GetPlainNameString());
+	return eventId;
+}
+
+void FHierarchicalStateMachineProcessor::PostEvent(FHierarchicalStateMachineFragment& _fragment, int32 _eventId)
+{
+	if (_eventId != INDEX_NONE)
+	{
+		_fragment.eventsQueue.Add(_eventId);
+	}
+}
+
+void FHierarchicalStateMachineProcessor::Start(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ProcessorStart);
+	TGuardValue<bool> runningGuard(m_running, true);
+	STATEMACHINE_ASSERT(_fragments.Num() == _entities.Num());
+
+	for (int32 i = 0; i < _fragments.Num(); ++i)
+	{
+		FHierarchicalStateMachineFragment& fragment = _fragments[i];
+		STATEMACHINE_ASSERT(!fragment.IsStarted());
+
+		fragment.configurationId = m_defaultConfigurationId;
+		for (FState* state : m_configurations[m_defaultConfigurationId].states)
+		{
+			m_enteringEntities[state->GetIndex()].Add(_entities[i]);
+		}
+	}
+	_FlushEnters();
+
+	DequeueEvents(_fragments, _entities);
+}
+
+void FHierarchicalStateMachineProcessor::Tick(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities, float _dt)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ProcessorTick);
+	TGuardValue<bool> runningGuard(m_running, true);
+	STATEMACHINE_ASSERT(_fragments.Num() == _entities.Num());
+
+	DequeueEvents(_fragments, _entities);
+
+	for (int32 i = 0; i < _fragments.Num(); ++i)
+	{
+		for (FState* state : GetCurrentStates(_fragments[i]))
+		{
+			m_tickingEntities[state->GetIndex()].Add(_entities[i]);
+		}
+	}
+
+	for (int32 index = 0; index < m_tickingEntities.Num(); ++index)
+	{
+		TArray<void*>& entities = m_tickingEntities[index];
+		if (entities.Num() == 0)
+			continue;
+
+		if (m_callbacks[index].tick)
+		{
+			QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_TickState);
+			m_callbacks[index].tick(entities, _dt);
+		}
+		entities.Reset();
+	}
+
+	DequeueEvents(_fragments, _entities);
+}
+
+void FHierarchicalStateMachineProcessor::Stop(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ProcessorStop);
+	TGuardValue<bool> runningGuard(m_running, true);
+	STATEMACHINE_ASSERT(_fragments.Num() == _entities.Num());
+
+	for (int32 i = 0; i < _fragments.Num(); ++i)
+	{
+		FHierarchicalStateMachineFragment& fragment = _fragments[i];
+		STATEMACHINE_ASSERT(fragment.IsStarted());
+
+		for (FState* state : GetCurrentStates(fragment))
+		{
+			m_exitingEntities[state->GetIndex()].Add(_entities[i]);
+		}
+		fragment.configurationId = INDEX_NONE;
+	}
+	_FlushExits();
+}
+
+void FHierarchicalStateMachineProcessor::DequeueEvents(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities)
+{
+	QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ProcessorDequeueEvents);
+	TGuardValue<bool> runningGuard(m_running, true);
+	STATEMACHINE_ASSERT(_fragments.Num() == _entities.Num());
+
+	int32 roundsCount = 0;
+	bool dequeued = true;
+	while (dequeued && roundsCount < STATEMACHINE_FRAGMENT_DEQUEUEROUNDSLIMIT)
+	{
+		dequeued = false;
+		++roundsCount;
+
+		for (int32 i = 0; i < _fragments.Num(); ++i)
+		{
+			FHierarchicalStateMachineFragment& fragment = _fragments[i];
+			if (fragment.eventsHead == fragment.eventsQueue.Num())
+				continue;
+
+			dequeued = true;
+			int32 evt = fragment.eventsQueue[fragment.eventsHead++];
+			if (fragment.eventsHead == fragment.eventsQueue.Num())
+			{
+				fragment.eventsQueue.Reset();
+				fragment.eventsHead = 0;
+			}
+
+			// Events posted to stopped fragments are dropped, like the ones dequeued by a stopped machine
+			if (!fragment.IsStarted())
+				continue;
+
+			const CachedTransition& transition = _ResolveEvent(fragment.configurationId, evt);
+			for (FState* state : transition.exitingStates)
+			{
+				m_exitingEntities[state->GetIndex()].Add(_entities[i]);
+			}
+			for (FState* state : transition.enteringStates)
+			{
+				m_enteringEntities[state->GetIndex()].Add(_entities[i]);
+			}
+			fragment.configurationId = transition.nextConfigurationId;
+		}
+
+		_FlushExits();
+		_FlushEnters();
+	}
+
+	if (roundsCount >= STATEMACHINE_FRAGMENT_DEQUEUEROUNDSLIMIT)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[StateMachine] Stopped fragments events dequeuing after %d rounds. There may be an infinite events loop somewhere."), STATEMACHINE_FRAGMENT_DEQUEUEROUNDSLIMIT);
+	}
+}
+
+void FHierarchicalStateMachineProcessor::_FlushExits()
+{
+	for (int32 index = m_exitingEntities.Num() - 1; index >= 0; --index)
+	{
+		TArray<void*>& entities = m_exitingEntities[index];
+		if (entities.Num() == 0)
+			continue;
+
+		if (m_callbacks[index].exit)
+		{
+			QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_ExitState);
+			m_callbacks[index].exit(entities);
+		}
+		entities.Reset();
+	}
+}
+
+void FHierarchicalStateMachineProcessor::_FlushEnters()
+{
+	for (int32 index = 0; index < m_enteringEntities.Num(); ++index)
+	{
+		TArray<void*>& entities = m_enteringEntities[index];
+		if (entities.Num() == 0)
+			continue;
+
+		if (m_callbacks[index].enter)
+		{
+			QUICK_SCOPE_CYCLE_COUNTER(STAT_HSM_EnterState);
+			m_callbacks[index].enter(entities);
+		}
+		entities.Reset();
+	}
+}
+
+
+FHierarchicalStateMachineInstance::FHierarchicalStateMachineInstance(FHierarchicalStateMachineProcessor& _processor, void* _entity)
+	: m_processor(&_processor)
+	, m_entity(_entity)
+{
+}
+
+void FHierarchicalStateMachineInstance::Start()
+{
+	STATEMACHINE_ASSERT(m_processor);
+	m_processor->Start(_GetFragments(), _GetEntities());
+}
+
+void FHierarchicalStateMachineInstance::Stop()
+{
+	STATEMACHINE_ASSERT(m_processor);
+	m_processor->Stop(_GetFragments(), _GetEntities());
+}
+
+void FHierarchicalStateMachineInstance::Tick(float _dt)
+{
+	STATEMACHINE_ASSERT(m_processor);
+	m_processor->Tick(_GetFragments(), _GetEntities(), _dt);
+}
+
+void FHierarchicalStateMachineInstance::PostEvent(FName _eventName)
+{
+	STATEMACHINE_ASSERT(m_processor);
+	PostEvent(m_processor->FindEvent(_eventName));
+}
+
+void FHierarchicalStateMachineInstance::PostEvent(int32 _eventId)
+{
+	FHierarchicalStateMachineProcessor::PostEvent(m_fragment, _eventId);
+
+	// The processor is not reentrant, the running call dequeues it instead
+	if (bImmediatelyDequeueEvents && IsStarted() && !m_processor->IsRunning())
+	{
+		DequeueEvents();
+	}
+}
+
+void FHierarchicalStateMachineInstance::DequeueEvents()
+{
+	STATEMACHINE_ASSERT(m_processor);
+	m_processor->DequeueEvents(_GetFragments(), _GetEntities());
+}
+
+const TArray<FState*>& FHierarchicalStateMachineInstance::GetCurrentStates() const
+{
+	static const TArray<FState*> s_noStates;
+	return m_processor ? m_processor->GetCurrentStates(m_fragment) : s_noStates;
+}
+
+void FHierarchicalStateMachineInstance::SetEntity(void* _entity)
+{
+	STATEMACHINE_ASSERT_MSG(!IsStarted(), TEXT("Entities can only be switched while the instance is stopped."));
+	m_entity = _entity;
+}
@@ -0,0 +1,210 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachinePool.h"
+#include "HierarchicalStateMachineCookedDefinition.h"
+
+template<typename DelegateType>
+void FHierarchicalStateMachinePrototype::_CaptureDelegate(const DelegateType& _delegate, const void* _owner, FName _stateName, FHierarchicalStateMachine::State::DelegateBindFunction _binder,
+	DelegateType& _outDelegate, FHierarchicalStateMachine::State::DelegateBindFunction& _outBinder)
+{
+	if (!_owner || static_cast<const void*>(_delegate.GetUObject()) != _owner)
+	{
+		_outDelegate = _delegate;
+		return;
+	}
+
+	STATEMACHINE_ASSERT_MSGF(_binder, TEXT("A delegate of state \"%s\" is bound to the prototype owner without STATE_ENTER, STATE_TICK or STATE_EXIT and cannot be rebound."), *_stateName.ToString());
+	_outBinder = _binder;
+}
+
+FHierarchicalStateMachinePrototype::FHierarchicalStateMachinePrototype(const FHierarchicalStateMachine& _prototype, const void* _owner)
+{
+	FHierarchicalStateMachineCookedDefinition::Cook(_prototype, m_cookedDefinition);
+
+	const void* owner = _owner ? _owner : _prototype.m_callbackOwner;
+	m_stateBindings.Reserve(_prototype.m_states.Num());
+	for (auto& statePair : _prototype.m_states)
+	{
+		const FHierarchicalStateMachine::State* state = statePair.Value;
+		StateBindings& bindings = m_stateBindings.AddDefaulted_GetRef();
+		bindings.callbacks = state->m_callbacks;
+		bindings.binders = state->m_delegateBinders;
+
+		OwnerDelegates ownerDelegates;
+		ownerDelegates.stateName = state->m_name;
+		FHierarchicalStateMachine::State::DelegateBindFunction latentEnterBinder = nullptr;
+		_CaptureDelegate(state->Enter, owner, state->m_name, state->m_delegateBinders.enter, bindings.enter, ownerDelegates.binders.enter);
+		_CaptureDelegate(state->Tick, owner, state->m_name, state->m_delegateBinders.tick, bindings.tick, ownerDelegates.binders.tick);
+		_CaptureDelegate(state->Exit, owner, state->m_name, state->m_delegateBinders.exit, bindings.exit, ownerDelegates.binders.exit);
+		_CaptureDelegate(state->LatentEnter, owner, state->m_name, nullptr, bindings.latentEnter, latentEnterBinder);
+		if (ownerDelegates.binders.enter || ownerDelegates.binders.tick || ownerDelegates.binders.exit)
+		{
+			m_ownerDelegates.Add(ownerDelegates);
+		}
+	}
+
+	m_immediatelyDequeueEvents = _prototype.bImmediatelyDequeueEvents;
+	m_parallelTickTracks = _prototype.bParallelTickTracks;
+	m_rejectUnhandledEvents = _prototype.bRejectUnhandledEvents;
+	m_optimizeDefinition = _prototype.bOptimizeDefinition;
+	m_dequeueEventsBudget = _prototype.DequeueEventsBudget;
+	m_dequeueMicrosecondsBudget = _prototype.DequeueMicrosecondsBudget;
+}
+
+void FHierarchicalStateMachinePrototype::Instantiate(FHierarchicalStateMachine& _outStateMachine, void* _callbackOwner) const
+{
+	const bool loaded = FHierarchicalStateMachineCookedDefinition::Load(m_cookedDefinition, _outStateMachine);
+	STATEMACHINE_ASSERT_MSG(loaded, TEXT("The cooked definition of a prototype failed to load."));
+	if (!loaded)
+		return;
+
+	STATEMACHINE_ASSERT(_outStateMachine.m_states.Num() == m_stateBindings.Num());
+	int32 index = 0;
+	for (auto& statePair : _outStateMachine.m_states)
+	{
+		FHierarchicalStateMachine::State* state = statePair.Value;
+		const StateBindings& bindings = m_stateBindings[index++];
+		state->Enter = bindings.enter;
+		state->Tick = bindings.tick;
+		state->Exit = bindings.exit;
+		state->LatentEnter = bindings.latentEnter;
+		state->m_callbacks = bindings.callbacks;
+		state->m_delegateBinders = bindings.binders;
+	}
+
+	_outStateMachine.bImmediatelyDequeueEvents = m_immediatelyDequeueEvents;
+	_outStateMachine.bParallelTickTracks = m_parallelTickTracks;
+	_outStateMachine.bRejectUnhandledEvents = m_rejectUnhandledEvents;
+	_outStateMachine.bOptimizeDefinition = m_optimizeDefinition;
+	_outStateMachine.DequeueEventsBudget = m_dequeueEventsBudget;
+	_outStateMachine.DequeueMicrosecondsBudget = m_dequeueMicrosecondsBudget;
+	RebindOwner(_outStateMachine, _callbackOwner);
+}
+
+void FHierarchicalStateMachinePrototype::RebindOwner(FHierarchicalStateMachine& _stateMachine, void* _callbackOwner) const
+{
+	typedef FHierarchicalStateMachine::State State;
+
+	for (const OwnerDelegates& ownerDelegates : m_ownerDelegates)
+	{
+		// Removed by OptimizeDefinition
+		State* state = _stateMachine.m_states.FindRef(ownerDelegates.stateName);
+		if (!state)
+			continue;
+
+		if (ownerDelegates.binders.enter && _callbackOwner)
+		{
+			ownerDelegates.binders.enter(state, _callbackOwner);
+		}
+		else if (ownerDelegates.binders.enter)
+		{
+			state->Enter.Unbind();
+		}
+		if (ownerDelegates.binders.tick && _callbackOwner)
+		{
+			ownerDelegates.binders.tick(state, _callbackOwner);
+		}
+		else if (ownerDelegates.binders.tick)
+		{
+			state->Tick.Unbind();
+		}
+		if (ownerDelegates.binders.exit && _callbackOwner)
+		{
+			ownerDelegates.binders.exit(state, _callbackOwner);
+		}
+		else if (ownerDelegates.binders.exit)
+		{
+			state->Exit.Unbind();
+		}
+	}
+	_stateMachine.RebindCallbackOwner(_callbackOwner);
+}
+
+
+FHierarchicalStateMachinePool::FHierarchicalStateMachinePool(const FHierarchicalStateMachine& _prototype, const void* _owner)
+	: m_prototype(_prototype, _owner)
+{
+}
+
+FHierarchicalStateMachinePool::~FHierarchicalStateMachinePool()
+{
+	for (const Block& block : m_blocks)
+	{
+		delete[] block.stateMachines;
+	}
+}
+
+void FHierarchicalStateMachinePool::Reserve(int32 _count)
+{
+	const int32 missingCount = _count - m_freeStateMachines.Num();
+	if (missingCount <= 0)
+		return;
+
+	FHierarchicalStateMachine* block = new FHierarchicalStateMachine[missingCount];
+	m_blocks.Add(Block{ block, missingCount, m_count });
+	m_freeFlags.Add(true, missingCount);
+	m_count += missingCount;
+
+	// Handed out in block order
+	m_freeStateMachines.Reserve(m_freeStateMachines.Num() + missingCount);
+	for (int32 i = missingCount - 1; i >= 0; --i)
+	{
+		m_prototype.Instantiate(block[i], nullptr);
+		m_freeStateMachines.Add(&block[i]);
+	}
+}
+
+FHierarchicalStateMachine* FHierarchicalStateMachinePool::Acquire(void* _callbackOwner)
+{
+	Reserve(1);
+
+	FHierarchicalStateMachine* stateMachine = m_freeStateMachines.Pop(false);
+	m_freeFlags[_GetIndex(stateMachine)] = false;
+	m_prototype.RebindOwner(*stateMachine, _callbackOwner);
+	return stateMachine;
+}
+
+void FHierarchicalStateMachinePool::Acquire(TArrayView<void* const> _callbackOwners, TArray<FHierarchicalStateMachine*>& _outStateMachines)
+{
+	Reserve(_callbackOwners.Num());
+
+	_outStateMachines.Reserve(_outStateMachines.Num() + _callbackOwners.Num());
+	for (void* owner : _callbackOwners)
+	{
+		FHierarchicalStateMachine* stateMachine = m_freeStateMachines.Pop(false);
+		m_freeFlags[_GetIndex(stateMachine)] = false;
+		m_prototype.RebindOwner(*stateMachine, owner);
+		_outStateMachines.Add(stateMachine);
+	}
+}
+
+void FHierarchicalStateMachinePool::Release(FHierarchicalStateMachine* _stateMachine)
+{
+	STATEMACHINE_ASSERT(_stateMachine);
+	const int32 index = _GetIndex(_stateMachine);
+	STATEMACHINE_ASSERT_MSG(index != INDEX_NONE, TEXT("State Machine released to a pool it was not acquired from."));
+	STATEMACHINE_ASSERT_MSG(index == INDEX_NONE || !m_freeFlags[index], TEXT("State Machine released twice."));
+	if (index == INDEX_NONE || m_freeFlags[index])
+		return;
+
+	if (_stateMachine->IsStarted())
+	{
+		_stateMachine->Stop();
+	}
+	// Broadcasts would otherwise queue events on it until the next owner starts it
+	_stateMachine->UnregisterFromBroadcasters();
+	_stateMachine->ResetRuntimeState();
+	m_prototype.RebindOwner(*_stateMachine, nullptr);
+	m_freeFlags[index] = true;
+	m_freeStateMachines.Add(_stateMachine);
+}
+
+int32 FHierarchicalStateMachinePool::_GetIndex(const FHierarchicalStateMachine* _stateMachine) const
+{
+	for (const Block& block : m_blocks)
+	{
+		if (_stateMachine >= block.stateMachines && _stateMachine < block.stateMachines + block.count)
+			return block.firstIndex + int32(_stateMachine - block.stateMachines);
+	}
+	return INDEX_NONE;
+}
@@ -0,0 +1,697 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineRecorder.h"
+
+#include <HAL/FileManager.h>
+#include <Misc/Crc.h>
+#include <Misc/FileHelper.h>
+
+#define STATEMACHINE_RECORDING_MAGIC 0x524D5348 // "HSMR"
+#define STATEMACHINE_RECORDING_VERSION 3
+
+// The header (magic, version, definition checksum, flags, dequeued events budget) is followed by records: a type byte, then a payload depending on the type.
+// States and events are referenced by index, tracks by definition order, deserialized states by name.
+enum RecordingFlags : uint8
+{
+	RecordingFlags_ImmediatelyDequeueEvents = 1 << 0,
+	RecordingFlags_RejectUnhandledEvents = 1 << 1,
+};
+
+FHierarchicalStateMachineRecorder::~FHierarchicalStateMachineRecorder()
+{
+	End();
+}
+
+void FHierarchicalStateMachineRecorder::Begin(FHierarchicalStateMachine& _stateMachine)
+{
+	_Attach(_stateMachine);
+}
+
+bool FHierarchicalStateMachineRecorder::BeginToFile(FHierarchicalStateMachine& _stateMachine, const TCHAR* _filename)
+{
+	STATEMACHINE_ASSERT_MSG(!m_stateMachine, TEXT("Recorder already in use."));
+
+	m_fileWriter = IFileManager::Get().CreateFileWriter(_filename);
+	if (!m_fileWriter)
+	{
+		UE_LOG(LogTemp, Error, TEXT("[StateMachine] Failed to create recording file \"%s\"."), _filename);
+		return false;
+	}
+
+	_Attach(_stateMachine);
+	return true;
+}
+
+void FHierarchicalStateMachineRecorder::End()
+{
+	if (!m_stateMachine)
+		return;
+
+	m_stateMachine->m_recorder = nullptr;
+	m_stateMachine = nullptr;
+
+	if (m_fileWriter)
+	{
+		_Flush();
+		m_fileWriter->Close();
+		delete m_fileWriter;
+		m_fileWriter = nullptr;
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_Attach(FHierarchicalStateMachine& _stateMachine)
+{
+	STATEMACHINE_ASSERT_MSG(!m_stateMachine, TEXT("Recorder already in use."));
+	STATEMACHINE_ASSERT_MSG(!_stateMachine.m_recorder, TEXT("State Machine already recorded."));
+	STATEMACHINE_ASSERT_MSG(!_stateMachine.m_ticking && !_stateMachine.m_isDequeuingEvents, TEXT("Recordings must begin outside of the calls to the State Machine."));
+	STATEMACHINE_ASSERT_MSG(_stateMachine.m_events.Num() <= MAX_uint16, TEXT("Too many events to be recorded."));
+
+	m_stateMachine = &_stateMachine;
+	m_stateMachine->m_recorder = this;
+	m_data.Reset();
+	m_inputsDepth = 0;
+	_WriteHeader();
+}
+
+void FHierarchicalStateMachineRecorder::_WriteHeader()
+{
+	const uint32 magic = STATEMACHINE_RECORDING_MAGIC;
+	const uint32 version = STATEMACHINE_RECORDING_VERSION;
+	const uint32 checksum = _ComputeDefinitionChecksum(*m_stateMachine);
+	const uint8 flags = (m_stateMachine->bImmediatelyDequeueEvents ? RecordingFlags_ImmediatelyDequeueEvents : 0)
+		| (m_stateMachine->bRejectUnhandledEvents ? RecordingFlags_RejectUnhandledEvents : 0);
+	_Write(&magic, sizeof(magic));
+	_Write(&version, sizeof(version));
+	_Write(&checksum, sizeof(checksum));
+	_Write(&flags, sizeof(flags));
+	_WriteUInt16(m_stateMachine->DequeueEventsBudget);
+
+	if (!m_stateMachine->IsStarted())
+		return;
+
+	_WriteRecordType(RecordType_Snapshot);
+	_Write(&m_stateMachine->m_time, sizeof(double));
+	_WriteUInt16(uint16(m_stateMachine->m_currentStates.Num()));
+	for (const FHierarchicalStateMachine::State* state : m_stateMachine->m_currentStates)
+	{
+		_WriteUInt16(state->GetIndex());
+	}
+	_WriteUInt16(uint16(m_stateMachine->m_queuedEventsCount));
+	for (const FHierarchicalStateMachine::EventsQueue& queue : m_stateMachine->m_eventsQueues)
+	{
+		for (const FHierarchicalStateMachine::QueuedEvent& queuedEvent : queue.events)
+		{
+			_WriteUInt16(uint16(queuedEvent.eventId));
+		}
+	}
+}
+
+bool FHierarchicalStateMachineRecorder::_HasValue(uint8 _type)
+{
+	switch (_type & ~RecordType_CallbackFlag)
+	{
+	case RecordType_PostEvent:
+	case RecordType_DequeueEvents:
+	case RecordType_LatentEnterCompleted:
+	case RecordType_SuspendTrack:
+	case RecordType_ResumeTrack:
+	case RecordType_StateEntered:
+	case RecordType_StateExited:
+	case RecordType_LatentEnterStarted:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool FHierarchicalStateMachineRecorder::_BeginInput(RecordType _type, uint16 _value)
+{
+	if (m_replaying)
+	{
+		const bool allowed = m_allowNextInput;
+		m_allowNextInput = false;
+		return allowed;
+	}
+
+	_WriteRecordType(m_inputsDepth > 0 ? uint8(_type | RecordType_CallbackFlag) : uint8(_type));
+	if (_HasValue(_type))
+	{
+		_WriteUInt16(_value);
+	}
+	++m_inputsDepth;
+	return true;
+}
+
+bool FHierarchicalStateMachineRecorder::_BeginTickInput(float _dt)
+{
+	if (!_BeginInput(RecordType_Tick))
+		return false;
+
+	if (!m_replaying)
+	{
+		_Write(&_dt, sizeof(float));
+	}
+	return true;
+}
+
+bool FHierarchicalStateMachineRecorder::_BeginTrackInput(RecordType _type, const FHierarchicalStateMachine::Track* _track)
+{
+	uint16 trackIndex = 0;
+	if (!m_replaying)
+	{
+		for (auto& trackPair : m_stateMachine->m_tracks)
+		{
+			if (trackPair.Value == _track)
+				break;
+			++trackIndex;
+		}
+	}
+	return _BeginInput(_type, trackIndex);
+}
+
+bool FHierarchicalStateMachineRecorder::_BeginDeserializeInput(const TArray<FString>& _states)
+{
+	if (!_BeginInput(RecordType_DeserializeCurrentStates))
+		return false;
+
+	if (!m_replaying)
+	{
+		_WriteUInt16(uint16(_states.Num()));
+		for (const FString& state : _states)
+		{
+			FTCHARToUTF8 utf8State(*state);
+			_WriteUInt16(uint16(utf8State.Length()));
+			_Write(utf8State.Get(), utf8State.Length());
+		}
+	}
+	return true;
+}
+
+void FHierarchicalStateMachineRecorder::_EndInput()
+{
+	// Recordings may have begun from a callback despite the assert
+	if (m_inputsDepth > 0)
+	{
+		--m_inputsDepth;
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_OnOutput(RecordType _type, uint16 _value)
+{
+	if (!m_replaying)
+	{
+		_WriteRecordType(_type);
+		if (_HasValue(_type))
+		{
+			_WriteUInt16(_value);
+		}
+		return;
+	}
+
+	if (!m_verifying || m_failed)
+		return;
+
+	const int32 recordOffset = m_replayOffset;
+	uint8 recordedType = 0;
+	uint16 recordedValue = 0;
+	if (!_PeekRecordType(recordedType))
+	{
+		_Fail(FString::Printf(TEXT("The recording ended, then the State Machine produced %s."), *_DescribeRecord(_type, _value)));
+		return;
+	}
+	++m_replayOffset;
+	if (_HasValue(recordedType) && !_ReadUInt16(recordedValue))
+		return;
+
+	if (recordedType != _type || recordedValue != _value)
+	{
+		_Fail(FString::Printf(TEXT("At byte %d, recorded %s but the State Machine produced %s."), recordOffset, *_DescribeRecord(recordedType, recordedValue), *_DescribeRecord(_type, _value)));
+		return;
+	}
+
+	_ExecuteCallbackInputs();
+}
+
+FHierarchicalStateMachine::LatentTaskHandle FHierarchicalStateMachineRecorder::_OnLatentEnter(const FHierarchicalStateMachine::State* _state, const FHierarchicalStateMachine::LatentTaskHandle& _task)
+{
+	if (!m_replaying)
+	{
+		if (_task.IsValid() && !_task->IsComplete())
+		{
+			_OnOutput(RecordType_LatentEnterStarted, _state->GetIndex());
+		}
+		return _task;
+	}
+
+	// Whatever the replayed callbacks started, the state waits for the recorded completion
+	uint8 recordedType = 0;
+	if (!m_verifying || m_failed || !_PeekRecordType(recordedType) || recordedType != RecordType_LatentEnterStarted)
+		return nullptr;
+
+	_OnOutput(RecordType_LatentEnterStarted, _state->GetIndex());
+	return MakeShared<FHierarchicalStateMachine::LatentTask, ESPMode::ThreadSafe>();
+}
+
+void FHierarchicalStateMachineRecorder::_OnPollLatentEnters()
+{
+	if (!m_replaying || !m_verifying || m_failed)
+		return;
+
+	uint8 recordedType = 0;
+	while (_PeekRecordType(recordedType) && recordedType == RecordType_LatentEnterCompleted)
+	{
+		const int32 recordOffset = m_replayOffset++;
+		uint16 stateIndex = 0;
+		if (!_ReadUInt16(stateIndex))
+			return;
+
+		FHierarchicalStateMachine::PendingLatentEnter* latentEnter = m_stateMachine->m_latentEnters.FindByPredicate([stateIndex](const FHierarchicalStateMachine::PendingLatentEnter& _latentEnter)
+		{
+			return _latentEnter.state->GetIndex() == stateIndex;
+		});
+		if (!latentEnter)
+		{
+			_Fail(FString::Printf(TEXT("At byte %d, recorded %s but the state is not entering."), recordOffset, *_DescribeRecord(recordedType, stateIndex)));
+			return;
+		}
+		latentEnter->task->Complete();
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_OnLatentEnterCompleted(const FHierarchicalStateMachine::State* _state)
+{
+	if (!m_replaying)
+	{
+		_WriteRecordType(RecordType_LatentEnterCompleted);
+		_WriteUInt16(_state->GetIndex());
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_WriteRecordType(uint8 _type)
+{
+	_Write(&_type, sizeof(uint8));
+}
+
+void FHierarchicalStateMachineRecorder::_WriteUInt16(uint16 _value)
+{
+	_Write(&_value, sizeof(uint16));
+}
+
+void FHierarchicalStateMachineRecorder::_Write(const void* _data, int32 _size)
+{
+	m_data.Append(static_cast<const uint8*>(_data), _size);
+	if (m_fileWriter && m_data.Num() >= FlushSize)
+	{
+		_Flush();
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_Flush()
+{
+	if (m_data.Num() == 0)
+		return;
+
+	m_fileWriter->Serialize(m_data.GetData(), m_data.Num());
+	m_data.Reset();
+}
+
+uint32 FHierarchicalStateMachineRecorder::_ComputeDefinitionChecksum(const FHierarchicalStateMachine& _stateMachine)
+{
+	uint32 checksum = 0;
+	for (auto& trackPair : _stateMachine.m_tracks)
+	{
+		checksum = FCrc::StrCrc32(*trackPair.Key.ToString(), checksum);
+		const uint8 history = trackPair.Value->GetHistory();
+		checksum = FCrc::MemCrc32(&history, sizeof(history), checksum);
+	}
+	for (auto& statePair : _stateMachine.m_states)
+	{
+		checksum = FCrc::StrCrc32(*statePair.Key.ToString(), checksum);
+	}
+	for (const FHierarchicalStateMachine::Event& evt : _stateMachine.m_events)
+	{
+		checksum = FCrc::StrCrc32(*evt.name.ToString(), checksum);
+		checksum = FCrc::MemCrc32(&evt.priority, sizeof(evt.priority), checksum);
+	}
+	return checksum;
+}
+
+bool FHierarchicalStateMachineRecorder::Replay(FHierarchicalStateMachine& _stateMachine, TArrayView<const uint8> _data, FString* _outMismatch)
+{
+	STATEMACHINE_ASSERT_MSG(!_stateMachine.IsStarted() && !_stateMachine.m_recorder, TEXT("Recordings are replayed on stopped State Machines that are not recorded."));
+
+	FHierarchicalStateMachineRecorder replay;
+	replay.m_replaying = true;
+	replay.m_replayData = _data;
+	replay.m_stateMachine = &_stateMachine;
+	_stateMachine.m_recorder = &replay;
+
+	uint32 magic = 0;
+	uint32 version = 0;
+	uint32 checksum = 0;
+	uint8 flags = 0;
+	uint16 dequeueEventsBudget = 0;
+	if (replay._Read(&magic, sizeof(magic)) && replay._Read(&version, sizeof(version)) && replay._Read(&checksum, sizeof(checksum)) && replay._Read(&flags, sizeof(flags))
+		&& replay._ReadUInt16(dequeueEventsBudget))
+	{
+		if (magic != STATEMACHINE_RECORDING_MAGIC || version != STATEMACHINE_RECORDING_VERSION)
+		{
+			replay._Fail(TEXT("Unknown recording format or version."));
+		}
+		else if (checksum != _ComputeDefinitionChecksum(_stateMachine))
+		{
+			replay._Fail(TEXT("The recording was made with another definition."));
+		}
+	}
+
+	if (!replay.m_failed)
+	{
+		_stateMachine.bImmediatelyDequeueEvents = (flags & RecordingFlags_ImmediatelyDequeueEvents) != 0;
+		_stateMachine.bRejectUnhandledEvents = (flags & RecordingFlags_RejectUnhandledEvents) != 0;
+		_stateMachine.DequeueEventsBudget = dequeueEventsBudget;
+		_stateMachine.DequeueMicrosecondsBudget = 0.f;
+	}
+
+	// Calls made by callbacks are made by _OnOutput, right after the record they follow
+	uint8 type = 0;
+	while (!replay.m_failed && replay._PeekRecordType(type))
+	{
+		const int32 recordOffset = replay.m_replayOffset++;
+		if (type & RecordType_CallbackFlag)
+		{
+			replay._Fail(FString::Printf(TEXT("At byte %d, recorded a call made by a callback that did not run."), recordOffset));
+			break;
+		}
+		replay._ExecuteInput(type);
+	}
+
+	_stateMachine.m_recorder = nullptr;
+	replay.m_stateMachine = nullptr;
+
+	if (replay.m_failed && _outMismatch)
+	{
+		*_outMismatch = replay.m_mismatch;
+	}
+	return !replay.m_failed;
+}
+
+bool FHierarchicalStateMachineRecorder::ReplayFile(FHierarchicalStateMachine& _stateMachine, const TCHAR* _filename, FString* _outMismatch)
+{
+	TArray<uint8> data;
+	if (!FFileHelper::LoadFileToArray(data, _filename))
+	{
+		if (_outMismatch)
+		{
+			*_outMismatch = FString::Printf(TEXT("Failed to read \"%s\"."), _filename);
+		}
+		return false;
+	}
+	return Replay(_stateMachine, data, _outMismatch);
+}
+
+bool FHierarchicalStateMachineRecorder::_Read(void* _outData, int32 _size)
+{
+	if (m_replayOffset + _size > m_replayData.Num())
+	{
+		_Fail(TEXT("The recording is truncated."));
+		return false;
+	}
+
+	FMemory::Memcpy(_outData, m_replayData.GetData() + m_replayOffset, _size);
+	m_replayOffset += _size;
+	return true;
+}
+
+bool FHierarchicalStateMachineRecorder::_ReadUInt16(uint16& _outValue)
+{
+	return _Read(&_outValue, sizeof(uint16));
+}
+
+bool FHierarchicalStateMachineRecorder::_PeekRecordType(uint8& _outType) const
+{
+	if (m_replayOffset >= m_replayData.Num())
+		return false;
+
+	_outType = m_replayData[m_replayOffset];
+	return true;
+}
+
+bool FHierarchicalStateMachineRecorder::_ExecuteInput(uint8 _type)
+{
+	FHierarchicalStateMachine& stateMachine = *m_stateMachine;
+	const int32 recordOffset = m_replayOffset - 1;
+
+	switch (_type)
+	{
+	case RecordType_Start:
+		m_allowNextInput = true;
+		stateMachine.Start();
+		break;
+
+	case RecordType_Stop:
+		m_allowNextInput = true;
+		stateMachine.Stop();
+		break;
+
+	case RecordType_Tick:
+	{
+		float dt = 0.f;
+		if (!_Read(&dt, sizeof(float)))
+			return false;
+
+		m_allowNextInput = true;
+		stateMachine.Tick(dt);
+		break;
+	}
+
+	case RecordType_PostEvent:
+	{
+		uint16 eventId = 0;
+		if (!_ReadUInt16(eventId))
+			return false;
+
+		if (eventId >= stateMachine.m_events.Num())
+		{
+			_Fail(FString::Printf(TEXT("At byte %d, recorded unknown event %d."), recordOffset, eventId));
+			return false;
+		}
+
+		m_allowNextInput = true;
+		stateMachine.PostEvent(stateMachine.m_events[eventId].name);
+		break;
+	}
+
+	case RecordType_DequeueEvents:
+	{
+		uint16 limit = 0;
+		if (!_ReadUInt16(limit))
+			return false;
+
+		m_allowNextInput = true;
+		stateMachine.DequeueEvents(limit);
+		break;
+	}
+
+	case RecordType_Suspend:
+		m_allowNextInput = true;
+		stateMachine.Suspend();
+		break;
+
+	case RecordType_Resume:
+		m_allowNextInput = true;
+		stateMachine.Resume();
+		break;
+
+	case RecordType_SuspendTrack:
+	case RecordType_ResumeTrack:
+	{
+		uint16 trackIndex = 0;
+		if (!_ReadUInt16(trackIndex))
+			return false;
+
+		FHierarchicalStateMachine::Track* track = nullptr;
+		for (auto& trackPair : stateMachine.m_tracks)
+		{
+			if (trackIndex-- == 0)
+			{
+				track = trackPair.Value;
+				break;
+			}
+		}
+		if (!track)
+		{
+			_Fail(FString::Printf(TEXT("At byte %d, recorded an unknown track."), recordOffset));
+			return false;
+		}
+
+		m_allowNextInput = true;
+		if (_type == RecordType_SuspendTrack)
+		{
+			stateMachine.SuspendTrack(FHierarchicalStateMachine::TrackHandle(track));
+		}
+		else
+		{
+			stateMachine.ResumeTrack(FHierarchicalStateMachine::TrackHandle(track));
+		}
+		break;
+	}
+
+	case RecordType_DeserializeCurrentStates:
+	{
+		uint16 statesCount = 0;
+		if (!_ReadUInt16(statesCount))
+			return false;
+
+		TArray<FString> states;
+		for (int32 i = 0; i < statesCount; ++i)
+		{
+			uint16 length = 0;
+			if (!_ReadUInt16(length) || m_replayOffset + length > m_replayData.Num())
+			{
+				_Fail(TEXT("The recording is truncated."));
+				return false;
+			}
+
+			states.Add(FString(FUTF8ToTCHAR(reinterpret_cast<const ANSICHAR*>(m_replayData.GetData() + m_replayOffset), length).Get(), length));
+			m_replayOffset += length;
+		}
+
+		m_allowNextInput = true;
+		stateMachine.DeserializeCurrentStates(states);
+		break;
+	}
+
+	case RecordType_Snapshot:
+	{
+		if (stateMachine.IsStarted())
+		{
+			_Fail(FString::Printf(TEXT("At byte %d, recorded a snapshot of a started State Machine."), recordOffset));
+			return false;
+		}
+
+		double time = 0.0;
+		uint16 statesCount = 0;
+		if (!_Read(&time, sizeof(double)) || !_ReadUInt16(statesCount))
+			return false;
+
+		TArray<uint16> stateIndices;
+		stateIndices.SetNumUninitialized(statesCount);
+		for (uint16& stateIndex : stateIndices)
+		{
+			if (!_ReadUInt16(stateIndex))
+				return false;
+		}
+
+		uint16 eventsCount = 0;
+		if (!_ReadUInt16(eventsCount))
+			return false;
+
+		TArray<int32> eventsQueue;
+		for (int32 i = 0; i < eventsCount; ++i)
+		{
+			uint16 eventId = 0;
+			if (!_ReadUInt16(eventId))
+				return false;
+
+			if (eventId >= stateMachine.m_events.Num())
+			{
+				_Fail(FString::Printf(TEXT("At byte %d, recorded unknown event %d."), recordOffset, eventId));
+				return false;
+			}
+			eventsQueue.Add(eventId);
+		}
+
+		// Restoring the snapshot is not part of the recording, so not verified
+		m_verifying = false;
+		stateMachine.m_time = time;
+		m_allowNextInput = true;
+		stateMachine.Start();
+
+		// State indices are only assigned once started
+		TArray<FString> states;
+		for (uint16 stateIndex : stateIndices)
+		{
+			const FHierarchicalStateMachine::State* state = _FindState(stateIndex);
+			states.Add(state ? state->GetName().ToString() : FString());
+		}
+		m_allowNextInput = true;
+		stateMachine.DeserializeCurrentStates(states);
+		for (int32 eventId : eventsQueue)
+		{
+			stateMachine._PushEvent(eventId, time);
+		}
+		m_verifying = true;
+		break;
+	}
+
+	default:
+	{
+		uint16 value = 0;
+		if (_HasValue(_type) && !_ReadUInt16(value))
+			return false;
+
+		_Fail(FString::Printf(TEXT("At byte %d, recorded %s but the State Machine did not produce it."), recordOffset, *_DescribeRecord(_type, value)));
+		return false;
+	}
+	}
+
+	// Calls that returned before reaching the recorder, on unknown names for instance
+	m_allowNextInput = false;
+	return !m_failed;
+}
+
+void FHierarchicalStateMachineRecorder::_ExecuteCallbackInputs()
+{
+	uint8 type = 0;
+	while (!m_failed && _PeekRecordType(type) && (type & RecordType_CallbackFlag))
+	{
+		++m_replayOffset;
+		_ExecuteInput(type & ~RecordType_CallbackFlag);
+	}
+}
+
+void FHierarchicalStateMachineRecorder::_Fail(const FString& _mismatch)
+{
+	if (m_failed)
+		return;
+
+	m_failed = true;
+	m_mismatch = _mismatch;
+}
+
+const FHierarchicalStateMachine::State* FHierarchicalStateMachineRecorder::_FindState(uint16 _index) const
+{
+	for (auto& statePair : m_stateMachine->m_states)
+	{
+		if (statePair.Value->GetIndex() == _index)
+			return statePair.Value;
+	}
+	return nullptr;
+}
+
+FString FHierarchicalStateMachineRecorder::_DescribeRecord(uint8 _type, uint16 _value) const
+{
+	const FHierarchicalStateMachine::State* state = _FindState(_value);
+	const FString stateName = state ? state->GetName().ToString() : FString::Printf(TEXT("#%d"), _value);
+
+	switch (_type & ~RecordType_CallbackFlag)
+	{
+	case RecordType_Start: return TEXT("Start");
+	case RecordType_Stop: return TEXT("Stop");
+	case RecordType_Tick: return TEXT("Tick");
+	case RecordType_PostEvent: return FString::Printf(TEXT("PostEvent %s"), _value < m_stateMachine->m_events.Num() ? *m_stateMachine->m_events[_value].name.ToString() : TEXT("?"));
+	case RecordType_DequeueEvents: return TEXT("DequeueEvents");
+	case RecordType_DeserializeCurrentStates: return TEXT("DeserializeCurrentStates");
+	case RecordType_Snapshot: return TEXT("Snapshot");
+	case RecordType_Suspend: return TEXT("Suspend");
+	case RecordType_Resume: return TEXT("Resume");
+	case RecordType_SuspendTrack: return TEXT("SuspendTrack");
+	case RecordType_ResumeTrack: return TEXT("ResumeTrack");
+	case RecordType_LatentEnterCompleted: return FString::Printf(TEXT("LatentEnterCompleted %s"), *stateName);
+	case RecordType_TickStates: return TEXT("TickStates");
+	case RecordType_StateEntered: return FString::Printf(TEXT("StateEntered %s"), *stateName);
+	case RecordType_StateExited: return FString::Printf(TEXT("StateExited %s"), *stateName);
+	case RecordType_LatentEnterStarted: return FString::Printf(TEXT("LatentEnterStarted %s"), *stateName);
+	default: return FString::Printf(TEXT("unknown record %d"), _type);
+	}
+}
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineStats.h"
+
+#include <HAL/PlatformAtomics.h>
+
+DEFINE_STAT(STAT_HSM_LiveMachines);
+DEFINE_STAT(STAT_HSM_ActiveStates);
+DEFINE_STAT(STAT_HSM_EventsPosted);
+DEFINE_STAT(STAT_HSM_EventsDequeued);
+DEFINE_STAT(STAT_HSM_EventsRejected);
+DEFINE_STAT(STAT_HSM_Transitions);
+DEFINE_STAT(STAT_HSM_AverageExitSetSize);
+DEFINE_STAT(STAT_HSM_AverageEnterSetSize);
+DEFINE_STAT(STAT_HSM_QueueHighWaterMark);
+DEFINE_STAT(STAT_HSM_EventsCarriedOver);
+DEFINE_STAT(STAT_HSM_MaxEventLatency);
+DEFINE_STAT(STAT_HSM_DequeueEvents);
+
+CSV_DEFINE_CATEGORY_MODULE(STATEMACHINECORE_API, HierarchicalStateMachine, true);
+
+#if STATEMACHINE_STATS_ENABLED
+
+volatile int32 FHierarchicalStateMachineStats::s_liveMachines = 0;
+volatile int32 FHierarchicalStateMachineStats::s_activeStates = 0;
+volatile int32 FHierarchicalStateMachineStats::s_eventsPosted = 0;
+volatile int32 FHierarchicalStateMachineStats::s_eventsDequeued = 0;
+volatile int32 FHierarchicalStateMachineStats::s_eventsRejected = 0;
+volatile int32 FHierarchicalStateMachineStats::s_transitions = 0;
+volatile int32 FHierarchicalStateMachineStats::s_exitedStates = 0;
+volatile int32 FHierarchicalStateMachineStats::s_enteredStates = 0;
+volatile int32 FHierarchicalStateMachineStats::s_queueHighWaterMark = 0;
+volatile int32 FHierarchicalStateMachineStats::s_eventsCarriedOver = 0;
+volatile int32 FHierarchicalStateMachineStats::s_maxEventLatency = 0;
+FHierarchicalStateMachineStats::FrameValues FHierarchicalStateMachineStats::s_lastPublishedFrame;
+
+static void InterlockedMax(volatile int32* _destination, int32 _value)
+{
+	int32 current = *_destination;
+	while (_value > current)
+	{
+		const int32 previous = FPlatformAtomics::InterlockedCompareExchange(_destination, _value, current);
+		if (previous == current)
+			break;
+
+		current = previous;
+	}
+}
+
+void FHierarchicalStateMachineStats::RecordMachineCreated()
+{
+	INC_DWORD_STAT(STAT_HSM_LiveMachines);
+	FPlatformAtomics::InterlockedIncrement(&s_liveMachines);
+}
+
+void FHierarchicalStateMachineStats::RecordMachineDestroyed()
+{
+	DEC_DWORD_STAT(STAT_HSM_LiveMachines);
+	FPlatformAtomics::InterlockedDecrement(&s_liveMachines);
+}
+
+void FHierarchicalStateMachineStats::RecordStateEntered()
+{
+	INC_DWORD_STAT(STAT_HSM_ActiveStates);
+	FPlatformAtomics::InterlockedIncrement(&s_activeStates);
+}
+
+void FHierarchicalStateMachineStats::RecordStateExited()
+{
+	DEC_DWORD_STAT(STAT_HSM_ActiveStates);
+	FPlatformAtomics::InterlockedDecrement(&s_activeStates);
+}
+
+void FHierarchicalStateMachineStats::RecordEventPosted(int32 _queueLength)
+{
+	INC_DWORD_STAT(STAT_HSM_EventsPosted);
+	FPlatformAtomics::InterlockedIncrement(&s_eventsPosted);
+	InterlockedMax(&s_queueHighWaterMark, _queueLength);
+}
+
+void FHierarchicalStateMachineStats::RecordEventRejected()
+{
+	INC_DWORD_STAT(STAT_HSM_EventsRejected);
+	FPlatformAtomics::InterlockedIncrement(&s_eventsRejected);
+}
+
+void FHierarchicalStateMachineStats::RecordEventDequeued()
+{
+	INC_DWORD_STAT(STAT_HSM_EventsDequeued);
+	FPlatformAtomics::InterlockedIncrement(&s_eventsDequeued);
+}
+
+void FHierarchicalStateMachineStats::RecordTransition(int32 _exitingStatesCount, int32 _enteringStatesCount)
+{
+	INC_DWORD_STAT(STAT_HSM_Transitions);
+	FPlatformAtomics::InterlockedIncrement(&s_transitions);
+	FPlatformAtomics::InterlockedAdd(&s_exitedStates, _exitingStatesCount);
+	FPlatformAtomics::InterlockedAdd(&s_enteredStates, _enteringStatesCount);
+}
+
+void FHierarchicalStateMachineStats::RecordEventsCarriedOver(int32 _eventsCount)
+{
+	INC_DWORD_STAT_BY(STAT_HSM_EventsCarriedOver, _eventsCount);
+	FPlatformAtomics::InterlockedAdd(&s_eventsCarriedOver, _eventsCount);
+}
+
+void FHierarchicalStateMachineStats::RecordEventLatency(double _latency)
+{
+	InterlockedMax(&s_maxEventLatency, int32(FMath::Min(_latency * 1000000.0, double(MAX_int32))));
+}
+
+void FHierarchicalStateMachineStats::PublishFrame()
+{
+	FrameValues values;
+	values.liveMachines = s_liveMachines;
+	values.activeStates = s_activeStates;
+	values.eventsPosted = FPlatformAtomics::InterlockedExchange(&s_eventsPosted, 0);
+	values.eventsDequeued = FPlatformAtomics::InterlockedExchange(&s_eventsDequeued, 0);
+	values.eventsRejected = FPlatformAtomics::InterlockedExchange(&s_eventsRejected, 0);
+	values.transitions = FPlatformAtomics::InterlockedExchange(&s_transitions, 0);
+	const int32 exitedStates = FPlatformAtomics::InterlockedExchange(&s_exitedStates, 0);
+	const int32 enteredStates = FPlatformAtomics::InterlockedExchange(&s_enteredStates, 0);
+	values.queueHighWaterMark = FPlatformAtomics::InterlockedExchange(&s_queueHighWaterMark, 0);
+	values.eventsCarriedOver = FPlatformAtomics::InterlockedExchange(&s_eventsCarriedOver, 0);
+	values.maxEventLatency = float(FPlatformAtomics::InterlockedExchange(&s_maxEventLatency, 0)) / 1000.f;
+
+	values.averageExitSetSize = values.transitions > 0 ? float(exitedStates) / float(values.transitions) : 0.f;
+	values.averageEnterSetSize = values.transitions > 0 ? float(enteredStates) / float(values.transitions) : 0.f;
+	s_lastPublishedFrame = values;
+
+	SET_FLOAT_STAT(STAT_HSM_AverageExitSetSize, values.averageExitSetSize);
+	SET_FLOAT_STAT(STAT_HSM_AverageEnterSetSize, values.averageEnterSetSize);
+	SET_DWORD_STAT(STAT_HSM_QueueHighWaterMark, values.queueHighWaterMark);
+	SET_FLOAT_STAT(STAT_HSM_MaxEventLatency, values.maxEventLatency);
+
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, LiveMachines, values.liveMachines, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, ActiveStates, values.activeStates, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, EventsPosted, values.eventsPosted, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, EventsDequeued, values.eventsDequeued, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, EventsRejected, values.eventsRejected, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, Transitions, values.transitions, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, AverageExitSetSize, values.averageExitSetSize, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, AverageEnterSetSize, values.averageEnterSetSize, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, QueueHighWaterMark, values.queueHighWaterMark, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, EventsCarriedOver, values.eventsCarriedOver, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(HierarchicalStateMachine, MaxEventLatencyMs, values.maxEventLatency, ECsvCustomStatOp::Set);
+}
+
+#endif
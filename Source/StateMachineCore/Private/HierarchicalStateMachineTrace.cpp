@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineTrace.h"
+
+#include <HAL/PlatformAtomics.h>
+#include <HAL/PlatformMisc.h>
+#include <HAL/PlatformTime.h>
+
+FHierarchicalStateMachineTrace::Slot* FHierarchicalStateMachineTrace::s_slots = nullptr;
+volatile int64 FHierarchicalStateMachineTrace::s_writeCursor = 0;
+volatile int32 FHierarchicalStateMachineTrace::s_listenersCount = 0;
+
+void FHierarchicalStateMachineTrace::AddListener()
+{
+	check(IsInGameThread());
+
+	// The buffer is never released, so writers that saw the trace enabled can always finish their write
+	if (!s_slots)
+	{
+		s_slots = new Slot[Capacity];
+		FPlatformMisc::MemoryBarrier();
+	}
+	FPlatformAtomics::InterlockedIncrement(&s_listenersCount);
+}
+
+void FHierarchicalStateMachineTrace::RemoveListener()
+{
+	check(IsInGameThread());
+	check(s_listenersCount > 0);
+	FPlatformAtomics::InterlockedDecrement(&s_listenersCount);
+}
+
+void FHierarchicalStateMachineTrace::Write(uint32 _stateMachineId, EHierarchicalStateMachineTraceType _type, FName _name, const FHierarchicalStateMachine* _stateMachine)
+{
+	if (!IsEnabled())
+		return;
+
+	int64 index = FPlatformAtomics::InterlockedIncrement(&s_writeCursor) - 1;
+	Slot& slot = s_slots[index & (Capacity - 1)];
+
+	FPlatformAtomics::AtomicStore(&slot.sequence, int64(-1));
+	FPlatformMisc::MemoryBarrier();
+
+	slot.event.stateMachineId = _stateMachineId;
+	slot.event.type = _type;
+	slot.event.name = _name;
+	slot.event.stateMachine = _stateMachine;
+	slot.event.frame = GFrameCounter;
+	slot.event.time = FPlatformTime::Seconds();
+
+	FPlatformMisc::MemoryBarrier();
+	FPlatformAtomics::AtomicStore(&slot.sequence, index);
+}
+
+int32 FHierarchicalStateMachineTrace::Read(uint64& _cursor, TArray<FHierarchicalStateMachineTraceEvent>& _outEvents)
+{
+	if (!s_slots)
+		return 0;
+
+	int64 writeCursor = FPlatformAtomics::AtomicRead(&s_writeCursor);
+	int64 cursor = int64(_cursor);
+	int32 lostCount = 0;
+
+	if (writeCursor - cursor > Capacity)
+	{
+		lostCount += int32(writeCursor - Capacity - cursor);
+		cursor = writeCursor - Capacity;
+	}
+
+	while (cursor < writeCursor)
+	{
+		const Slot& slot = s_slots[cursor & (Capacity - 1)];
+
+		int64 sequence = FPlatformAtomics::AtomicRead(&slot.sequence);
+		if (sequence < cursor)
+			break; // Not published yet, read it next time
+
+		if (sequence == cursor)
+		{
+			FHierarchicalStateMachineTraceEvent event = slot.event;
+			FPlatformMisc::MemoryBarrier();
+			if (FPlatformAtomics::AtomicRead(&slot.sequence) == cursor)
+			{
+				_outEvents.Add(event);
+			}
+			else
+			{
+				++lostCount;
+			}
+		}
+		else
+		{
+			++lostCount; // Overwritten by a more recent event
+		}
+		++cursor;
+	}
+
+	_cursor = uint64(cursor);
+	return lostCount;
+}
+
+uint64 FHierarchicalStateMachineTrace::GetWriteCursor()
+{
+	return uint64(FPlatformAtomics::AtomicRead(&s_writeCursor));
+}
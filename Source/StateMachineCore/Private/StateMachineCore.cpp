@@ -0,0 +1,29 @@
+// Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
+
+#include "StateMachineCore.h"
+#include "HierarchicalStateMachineStats.h"
+
+#include <Misc/CoreDelegates.h>
+
+#define LOCTEXT_NAMESPACE "FStateMachineCoreModule"
+
+void FStateMachineCoreModule::StartupModule()
+{
+	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+#if STATEMACHINE_STATS_ENABLED
+	m_endFrameHandle = FCoreDelegates::OnEndFrame.AddStatic(&FHierarchicalStateMachineStats::PublishFrame);
+#endif
+}
+
+void FStateMachineCoreModule::ShutdownModule()
+{
+	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
+	// we call this function before unloading the module.
+#if STATEMACHINE_STATS_ENABLED
+	FCoreDelegates::OnEndFrame.Remove(m_endFrameHandle);
+#endif
+}
+
+#undef LOCTEXT_NAMESPACE
+
+IMPLEMENT_MODULE(FStateMachineCoreModule, StateMachineCore)
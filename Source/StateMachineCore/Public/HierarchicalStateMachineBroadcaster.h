@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+// Index from event names to the registered machines whose definitions have transitions for them, so that world level events
+// ("AlarmRaised", "NightFell") only reach the machines that know them, whatever the number of machines that do not.
+// Machines must be registered once their definition is complete, and unregister themselves when destroyed.
+class STATEMACHINECORE_API FHierarchicalStateMachineBroadcaster
+{
+public:
+	FHierarchicalStateMachineBroadcaster() {}
+	~FHierarchicalStateMachineBroadcaster();
+
+	// O(events of the machine) each, whatever the number of machines subscribed to the same events
+	void Register(FHierarchicalStateMachine* _stateMachine);
+	void Unregister(FHierarchicalStateMachine* _stateMachine);
+
+	// Queues the event on every subscribed machine first, then dequeues it on the ones set to dequeue immediately, so that no callback
+	// runs before every machine received it. With _onlyIfHandled, machines whose current configuration cannot react are skipped without
+	// touching their queue. Machines must not be destroyed by the callbacks of a broadcast. Returns the number of machines that queued the event.
+	int32 Broadcast(FName _eventName, bool _onlyIfHandled = false);
+
+	int32 GetSubscribersCount(FName _eventName) const;
+
+private:
+	struct Subscription
+	{
+		FHierarchicalStateMachine* stateMachine;
+		int32 eventId; // In the definition of stateMachine
+	};
+
+	TMap<FName, TArray<Subscription>> m_subscriptions; // Unordered, subscriptions are removed by swapping with the last one
+	TMap<FHierarchicalStateMachine*, TArray<int32>> m_subscriptionIndices; // Per registered machine, index of its subscription in m_subscriptions for each of its event ids, INDEX_NONE if none
+};
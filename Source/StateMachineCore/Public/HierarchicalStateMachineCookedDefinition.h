@@ -0,0 +1,23 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+// Compact binary form of a definition, produced offline (cook, commandlet, editor) so that maps with many machine types do not pay for
+// building hierarchies name by name at load time. The data holds flat track, state, event and transition tables referencing each other
+// by index, the closest common track of each transition already resolved, and a name table. Callbacks are not part of it: they are bound
+// after loading, through FindState or a FHierarchicalStateMachineProcessor.
+class STATEMACHINECORE_API FHierarchicalStateMachineCookedDefinition
+{
+public:
+	// Works with definitions built with the macros, the non-macro API or from data alike. The definition may be optimized first.
+	// The data is meant for the platform it was cooked on.
+	static void Cook(const FHierarchicalStateMachine& _definition, TArray<uint8>& _outData);
+
+	// Builds the definition into an empty, stopped machine in one pass over _data, typically read at once with FFileHelper::LoadFileToArray.
+	// Tracks, states and transitions are constructed in a single allocation owned by the machine, then linked by index.
+	// Returns false, leaving the machine untouched, when the data is truncated, from another version or references out of range indices.
+	static bool Load(TArrayView<const uint8> _data, FHierarchicalStateMachine& _outDefinition);
+};
@@ -0,0 +1,820 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "HAL/ThreadSafeBool.h"
+
+#define STATEMACHINE_ASSERT_ENABLED 1
+
+#if STATEMACHINE_ASSERT_ENABLED
+
+	#define STATEMACHINE_ASSERT(cond) check(cond)
+	#define STATEMACHINE_ASSERT_MSG(cond, msg) checkf(cond, msg)
+	#define STATEMACHINE_ASSERT_MSGF(cond, fmt, ...) checkf(cond, fmt, __VA_ARGS__)
+#else
+	#define STATEMACHINE_ASSERT(cond)
+	#define STATEMACHINE_ASSERT_MSGF(cond, fmt, ...)
+	#define STATEMACHINE_ASSERT_MSG(cond, msg)
+#endif
+
+#ifdef UE_EDITOR
+	#define STATEMACHINE_HISTORY_ENABLED 1
+#else
+	#define STATEMACHINE_HISTORY_ENABLED 0
+#endif
+
+class FHierarchicalStateMachineBroadcaster;
+class FHierarchicalStateMachineCookedDefinition;
+class FHierarchicalStateMachineRecorder;
+class FHierarchicalStateMachinePrototype;
+
+// Hierarchy, transition and event queue logic of the Hierarchical State Machine. Only depends on Core, so it can run headless
+// (Program targets, commandlets, simulations) without booting the engine. UHierarchicalStateMachine is the UObject flavor of it.
+class STATEMACHINECORE_API FHierarchicalStateMachine
+{
+private:
+	struct TimedTransition;
+	struct ActiveTimer;
+
+	struct StateCallbacks
+	{
+		void (*enter)(void*) = nullptr;
+		void (*tick)(void*, float) = nullptr;
+		void (*exit)(void*) = nullptr;
+		void (*batchTick)(TArrayView<void*>, float) = nullptr;
+	};
+
+public:
+	DECLARE_DELEGATE(StateEnterDelegate);
+	DECLARE_DELEGATE_OneParam(StateTickDelegate, float);
+	DECLARE_DELEGATE(StateExitDelegate);
+
+	// Raw bindings: plain function pointers stored in a contiguous per-machine table. The callback owner is shared by all raw bindings
+	// of a machine and its validity is checked once per Start/Tick/DequeueEvents call instead of once per call.
+	typedef void (*StateEnterFunction)(void*);
+	typedef void (*StateTickFunction)(void*, float);
+	typedef void (*StateExitFunction)(void*);
+	typedef void (*StateBatchTickFunction)(TArrayView<void*>, float);
+
+	// Work started by a latent Enter. Complete() may be called from any thread; the machine polls IsComplete() at the start of each Tick.
+	class LatentTask
+	{
+	public:
+		virtual ~LatentTask() {}
+		virtual bool IsComplete() const { return m_completed; }
+		void Complete() { m_completed = true; }
+
+	private:
+		FThreadSafeBool m_completed;
+	};
+
+	template<typename ResultType>
+	class FutureLatentTask : public LatentTask
+	{
+	public:
+		explicit FutureLatentTask(TFuture<ResultType>&& _future) : m_future(MoveTemp(_future)) {}
+		virtual bool IsComplete() const override { return m_future.IsReady(); }
+
+	private:
+		TFuture<ResultType> m_future;
+	};
+
+	typedef TSharedPtr<LatentTask, ESPMode::ThreadSafe> LatentTaskHandle;
+	DECLARE_DELEGATE_RetVal(LatentTaskHandle, StateLatentEnterDelegate);
+
+	// Latent task completed when _future is ready
+	template<typename ResultType>
+	static LatentTaskHandle MakeLatentTask(TFuture<ResultType>&& _future)
+	{
+		return MakeShared<FutureLatentTask<ResultType>, ESPMode::ThreadSafe>(MoveTemp(_future));
+	}
+
+	class Track;
+	class State;
+
+	enum TrackHistory : uint8
+	{
+		TrackHistory_None,
+		TrackHistory_Shallow, // Resumes the last active state of the track
+		TrackHistory_Deep, // Also resumes the last active states of every sub track
+	};
+
+	// Typed reference to a track or state of a definition, resolved once by name with FindTrack or FindState and valid for the
+	// lifetime of the definition.
+	template<typename NodeType>
+	class THandle
+	{
+	public:
+		THandle() {}
+		explicit THandle(NodeType* _node) : m_node(_node) {}
+
+		FORCEINLINE bool IsValid() const { return m_node != nullptr; }
+		FORCEINLINE NodeType* Get() const { return m_node; }
+		FORCEINLINE NodeType* operator->() const { return m_node; }
+		FORCEINLINE bool operator==(const THandle& _other) const { return m_node == _other.m_node; }
+		FORCEINLINE bool operator!=(const THandle& _other) const { return m_node != _other.m_node; }
+
+	private:
+		NodeType* m_node = nullptr;
+	};
+
+	typedef THandle<Track> TrackHandle;
+	typedef THandle<State> StateHandle;
+
+	friend class Track;
+	friend class State;
+	friend class FHierarchicalStateMachineProcessor;
+	friend class FHierarchicalStateMachineBroadcaster;
+	friend class FHierarchicalStateMachineCookedDefinition;
+	friend class FHierarchicalStateMachineRecorder;
+	friend class FHierarchicalStateMachinePrototype;
+
+	class STATEMACHINECORE_API Track
+	{
+		friend class FHierarchicalStateMachine;
+		friend class FHierarchicalStateMachineCookedDefinition;
+		friend class State;
+	public:
+		State* AddState(FName _name);
+		State* AddState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit);
+		State* AddDefaultState(FName _name);
+		State* AddDefaultState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit);
+
+		FORCEINLINE State* GetParentState() const { return m_parent; }
+		FORCEINLINE const FName& GetName() const { return m_name; }
+		FORCEINLINE const TMap<FName, State*>& GetStates() const { return m_states; }
+		FORCEINLINE State* GetDefaultState() const { return m_defaultState; }
+
+		// Promise that the callbacks of the states of this track only touch data owned by the track and only post events to their machine,
+		// so that with bParallelTickTracks the track ticks in its own task. Nested independent tracks tick within the outermost one.
+		FORCEINLINE void SetIndependent(bool _independent) { m_independent = _independent; }
+		FORCEINLINE bool IsIndependent() const { return m_independent; }
+
+		// When entered without an explicit target, typically by a transition to the state owning it, a track with a history enters its last
+		// active state instead of its default one, in the same transition. History is kept as one state index per track and reset by Start.
+		FORCEINLINE void SetHistory(TrackHistory _history) { m_history = _history; }
+		FORCEINLINE TrackHistory GetHistory() const { return m_history; }
+
+	private:
+		Track(FName _name, State* _parent, FHierarchicalStateMachine* _stateMachine);
+		~Track();
+
+		void _AssignIndices(uint16& _index);
+		void _AssignTreeOrders(int32& _preOrder, int32& _postOrder);
+
+		FName m_name;
+		TMap<FName, State*> m_states;
+		State* m_parent = nullptr;
+		State* m_defaultState = nullptr;
+		FHierarchicalStateMachine* m_stateMachine = nullptr;
+		int32 m_preOrder = 0;
+		int32 m_postOrder = 0;
+		bool m_independent = false;
+		TrackHistory m_history = TrackHistory_None;
+		bool m_resumesHistory = false; // Has a history or is within a deep history track, set at Start
+		uint16 m_index = 0; // Position in m_tracks, set at Start
+	};
+
+	class STATEMACHINECORE_API State
+	{
+		friend class FHierarchicalStateMachine;
+		friend class FHierarchicalStateMachineCookedDefinition;
+		friend class FHierarchicalStateMachinePrototype;
+		friend class State;
+	public:
+		StateEnterDelegate Enter;
+		StateTickDelegate Tick;
+		StateExitDelegate Exit;
+
+		// Called right after Enter. Until the returned task completes the state is entering: it and its sub states are not ticked,
+		// and events that would exit any of them are deferred until it completes. Other tracks keep running.
+		StateLatentEnterDelegate LatentEnter;
+
+		Track* AddTrack(FName _name);
+
+		// Same as BindUObject on the delegates, used by STATE_ENTER, STATE_TICK and STATE_EXIT. The method is also remembered so that
+		// FHierarchicalStateMachinePrototype can bind the delegate of each copy to the owner of that copy.
+		template<typename UserClass, void (UserClass::*Method)()>
+		void BindEnter(UserClass* _owner)
+		{
+			Enter.BindUObject(_owner, Method);
+			m_delegateBinders.enter = &_BindEnterMethod<UserClass, Method>;
+		}
+
+		template<typename UserClass, void (UserClass::*Method)(float)>
+		void BindTick(UserClass* _owner)
+		{
+			Tick.BindUObject(_owner, Method);
+			m_delegateBinders.tick = &_BindTickMethod<UserClass, Method>;
+		}
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		void BindExit(UserClass* _owner)
+		{
+			Exit.BindUObject(_owner, Method);
+			m_delegateBinders.exit = &_BindExitMethod<UserClass, Method>;
+		}
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		void BindRawEnter(UserClass* _owner)
+		{
+			m_stateMachine->_SetCallbackOwner(_owner);
+			m_callbacks.enter = &_CallMethod<UserClass, Method>;
+		}
+
+		template<typename UserClass, void (UserClass::*Method)(float)>
+		void BindRawTick(UserClass* _owner)
+		{
+			m_stateMachine->_SetCallbackOwner(_owner);
+			m_callbacks.tick = &_CallTickMethod<UserClass, Method>;
+		}
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		void BindRawExit(UserClass* _owner)
+		{
+			m_stateMachine->_SetCallbackOwner(_owner);
+			m_callbacks.exit = &_CallMethod<UserClass, Method>;
+		}
+
+		// The function is called once per TickBatched call with the owners of every machine in which this state is active.
+		void BindBatchTick(void* _owner, StateBatchTickFunction _function);
+
+		// O(1) once the definition is finalized by Start, by comparing the pre and post order numbers of both nodes
+		bool IsInTrack(const Track* _track) const;
+		bool IsInState(const State* _state) const;
+
+		FORCEINLINE Track* GetParentTrack() const { return m_parent; }
+		FORCEINLINE const FName& GetName() const { return m_name; }
+		FORCEINLINE const TMap<FName, Track*>& GetTracks() const { return m_tracks; }
+		FORCEINLINE uint16 GetIndex() const { return m_index; }
+
+	private:
+		State(FName _name, Track* _parent, FHierarchicalStateMachine* _stateMachine);
+		~State();
+
+		void _AssignTreeOrders(int32& _preOrder, int32& _postOrder);
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		static void _CallMethod(void* _owner) { (static_cast<UserClass*>(_owner)->*Method)(); }
+
+		template<typename UserClass, void (UserClass::*Method)(float)>
+		static void _CallTickMethod(void* _owner, float _dt) { (static_cast<UserClass*>(_owner)->*Method)(_dt); }
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		static void _BindEnterMethod(State* _state, void* _owner) { _state->Enter.BindUObject(static_cast<UserClass*>(_owner), Method); }
+
+		template<typename UserClass, void (UserClass::*Method)(float)>
+		static void _BindTickMethod(State* _state, void* _owner) { _state->Tick.BindUObject(static_cast<UserClass*>(_owner), Method); }
+
+		template<typename UserClass, void (UserClass::*Method)()>
+		static void _BindExitMethod(State* _state, void* _owner) { _state->Exit.BindUObject(static_cast<UserClass*>(_owner), Method); }
+
+		typedef void (*DelegateBindFunction)(State*, void*);
+		struct DelegateBinders
+		{
+			DelegateBindFunction enter = nullptr;
+			DelegateBindFunction tick = nullptr;
+			DelegateBindFunction exit = nullptr;
+		};
+
+		FName m_name;
+		TMap<FName, Track*> m_tracks;
+		Track* m_parent;
+		FHierarchicalStateMachine* m_stateMachine;
+		uint16 m_index = 0;
+		int32 m_preOrder = 0;
+		int32 m_postOrder = 0;
+		const Track* m_independentTrack = nullptr; // Outermost independent track above this state, set at Start
+		StateCallbacks m_callbacks;
+		DelegateBinders m_delegateBinders;
+		TArray<TimedTransition*> m_timedTransitions;
+		TArray<int32> m_reachableEventIds; // Events that may fire while this state is active
+	};
+
+public:
+	FHierarchicalStateMachine();
+	virtual ~FHierarchicalStateMachine();
+
+	Track* AddRootTrack(FName _name);
+	Track* AddRootTrack(Track* _track);
+
+	void AddEventTransition(FName _eventName, FName _sourceName, FName _targetStateName);
+
+	// Queued events of higher priority are dequeued first, events of the same priority in the order they were posted. 0 by default.
+	// Part of the definition: set once the event has a transition, before Start.
+	void SetEventPriority(FName _eventName, uint8 _priority);
+	uint8 GetEventPriority(FName _eventName) const;
+
+	// Transition fired once the source state has been active for _seconds of machine time (accumulated through Tick).
+	// The timer is scheduled when the source state is entered and cancelled when it exits.
+	void AddTimedTransition(FName _sourceStateName, FName _targetStateName, float _seconds);
+
+	// Machine level raw bindings, used by the definition macros so that wrappers can track the owner
+	template<typename UserClass, void (UserClass::*Method)()>
+	void BindRawEnter(State* _state, UserClass* _owner) { _state->BindRawEnter<UserClass, Method>(_owner); }
+
+	template<typename UserClass, void (UserClass::*Method)(float)>
+	void BindRawTick(State* _state, UserClass* _owner) { _state->BindRawTick<UserClass, Method>(_owner); }
+
+	template<typename UserClass, void (UserClass::*Method)()>
+	void BindRawExit(State* _state, UserClass* _owner) { _state->BindRawExit<UserClass, Method>(_owner); }
+
+	void BindBatchTick(State* _state, void* _owner, StateBatchTickFunction _function) { _state->BindBatchTick(_owner, _function); }
+
+	void Start();
+	void Tick(float _dt);
+
+	// Ticks several machines at once. States bound with BindBatchTick are ticked after every other state, with one call per bound
+	// function receiving the owners of all machines in which that state is active.
+	static void TickBatched(TArrayView<FHierarchicalStateMachine*> _stateMachines, float _dt);
+	void Stop();
+	void DequeueEvents(uint16 _dequeuedEventsLimit = -1);
+
+	// Keeps the current states of the whole machine without ticking them nor running any callback, until Resume. Machine time stops,
+	// so timers and times in state are frozen too, and posted events stay queued. Cleared by Stop.
+	void Suspend();
+	void Resume();
+	FORCEINLINE bool IsSuspended() const { return m_suspended; }
+
+	// Same for the states of a started machine within a track: they are not ticked, and events that would exit or enter any of them,
+	// timed transitions included, are deferred until the track resumes. Machine time goes on. Resuming only queues the deferred events again.
+	void SuspendTrack(TrackHandle _track);
+	void ResumeTrack(TrackHandle _track);
+	bool IsTrackSuspended(TrackHandle _track) const;
+	bool IsStateSuspended(const State* _state) const;
+
+	void PostEvent(FName _eventName);
+
+	// Returns true if at least one transition of this event can fire from the current configuration.
+	bool CanHandleEvent(FName _eventName) const;
+
+	// States that would be entered by a sequence of at most _transitionsCount events from the current configuration, found by
+	// resolving the events indexed on the states of every intermediate configuration. Meant to be called when the configuration changes, not every frame.
+	void GetReachableStates(int32 _transitionsCount, TArray<State*>& _outStates) const;
+
+	// Dead branches of a definition: states that no transition can enter from the default configuration, events whose transitions
+	// all start from such states, and single state tracks whose state has no callback and no transition, which only group sub tracks.
+	struct STATEMACHINECORE_API DefinitionReport
+	{
+		TArray<FName> unreachableStates;
+		TArray<FName> deadEvents;
+		TArray<FName> groupingTracks;
+
+		// Savings, filled by OptimizeDefinition
+		int32 removedStatesCount = 0;
+		int32 removedTracksCount = 0;
+		int32 removedTransitionsCount = 0;
+		int32 defaultStatesCountBefore = 0; // Entries of m_currentStates right after Start
+		int32 defaultStatesCountAfter = 0;
+		SIZE_T definitionSizeBefore = 0;
+		SIZE_T definitionSizeAfter = 0;
+
+		FString ToString() const;
+	};
+
+	void AnalyzeDefinition(DefinitionReport& _outReport) const;
+
+	// Removes unreachable states with their transitions and timers, and flattens grouping tracks by moving the sub tracks of their state
+	// up to the parent state. Indices keep their relative order, so callbacks are called in the same order as before.
+	// Must be called while stopped. Pointers to removed tracks and states dangle afterwards, events keep their ids.
+	void OptimizeDefinition(DefinitionReport& _outReport);
+
+	// Invalid handles when no track or state has this name
+	TrackHandle FindTrack(FName _name) const;
+	StateHandle FindState(FName _name) const;
+
+	// O(1) against the current configuration. Time is machine time accumulated through Tick since the state was last entered, 0 when inactive.
+	bool IsStateActive(StateHandle _state) const;
+	float GetTimeInState(StateHandle _state) const;
+
+	FORCEINLINE const TArray<State*>& GetCurrentStates() const { return m_currentStates; }
+	FORCEINLINE const TArray<Track*>& GetRootTracks() const { return m_rootTracks; }
+
+	FORCEINLINE bool IsStarted() const { return m_started; }
+
+	// True while the latent Enter of this state or of one of its parents has not completed
+	bool IsStateEntering(const State* _state) const;
+	FORCEINLINE bool HasPendingLatentEnters() const { return m_latentEnters.Num() != 0; }
+
+	// Incremented every time a state is entered or exited, so that views of the configuration can be cached.
+	FORCEINLINE uint32 GetConfigurationVersion() const { return m_configurationVersion; }
+
+	// One line per current state, indented by depth. Rebuilt only when the configuration changed since the last call.
+	const FString& GetCurrentStatesString() const;
+
+	void SerializeCurrentStates(TArray<FString>& _outStates);
+	void DeserializeCurrentStates(const TArray<FString>& _states);
+
+	// Heap memory owned by the machine, split between the definition (tracks, states, transitions, delegates, lookup maps)
+	// and the runtime state (current states, event queue, timers, history).
+	void GetAllocatedSize(SIZE_T& _outDefinitionSize, SIZE_T& _outRuntimeSize) const;
+
+	// Binds every raw callback to another owner at once, typically after cloning the machine from a prototype. The machine must be stopped.
+	void RebindCallbackOwner(void* _owner);
+
+	// Forgets the queued events, timers, machine time and metrics of a stopped machine, keeping its definition and bindings
+	void ResetRuntimeState();
+
+	// Leaves every FHierarchicalStateMachineBroadcaster it was registered to, so that broadcasts no longer queue events on it
+	void UnregisterFromBroadcasters();
+
+	struct EventQueueMetrics
+	{
+		uint32 dequeuedEventsCount = 0;
+		uint32 spentBudgetsCount = 0; // Dequeues that ran out of budget and carried events over
+		uint32 carriedOverEventsCount = 0; // Summed over those dequeues, an event carried over twice counts twice
+		double totalLatency = 0.0; // Machine time between post and dequeue, summed over the dequeued events
+		double maxLatency = 0.0;
+	};
+
+	// Accumulated since construction or the last reset
+	FORCEINLINE const EventQueueMetrics& GetEventQueueMetrics() const { return m_eventQueueMetrics; }
+	FORCEINLINE void ResetEventQueueMetrics() { m_eventQueueMetrics = EventQueueMetrics(); }
+	FORCEINLINE int32 GetQueuedEventsCount() const { return m_queuedEventsCount; }
+
+	bool bImmediatelyDequeueEvents : 1;
+
+	// Ticks the states of each independent track (see Track::SetIndependent) in a separate task, after the states outside of them.
+	// Events posted from those tasks are queued once all of them completed, in tracks order. Falls back to a serial tick when fewer than
+	// two independent tracks have current states, when the task graph is not running and in TickBatched.
+	bool bParallelTickTracks : 1;
+
+	// Drops posted events that cannot fire from the current configuration instead of queuing them.
+	// Events posted while other events are pending are always queued, since those may change the configuration first.
+	bool bRejectUnhandledEvents : 1;
+
+	// Runs OptimizeDefinition and logs its report the first time the machine starts
+	bool bOptimizeDefinition : 1;
+
+#if STATEMACHINE_HISTORY_ENABLED
+	bool bPrintHistoryInLog : 1;
+#endif
+
+	// Spent by each dequeue (Tick, immediate PostEvent, DequeueEvents), 0 for none. Once spent, the remaining events are carried over to
+	// the next dequeue, highest priorities first. Unlike the dequeued events limit, running out of budget is expected and not logged.
+	// Time budgets depend on the hardware, so recordings of machines using one may not replay.
+	uint16 DequeueEventsBudget = 0;
+	float DequeueMicrosecondsBudget = 0.f;
+
+protected:
+	// Called before callbacks may run. Wrappers owning a weak reference to the callback owner clear m_validCallbackOwner when it died.
+	virtual void _ValidateCallbackOwner();
+
+	// Identifies the machine in history logs and trace events
+	virtual FString _GetDebugName() const;
+	virtual uint32 _GetTraceId() const;
+
+	// Called once states have been entered or exited, after events dequeuing, Start, Stop and DeserializeCurrentStates
+	virtual void _OnConfigurationChanged() {}
+
+	// Wrappers attaching data to states return false for those, so that OptimizeDefinition keeps them
+	virtual bool _CanRemoveState(const State* _state) const { return true; }
+
+	FString _StringifyCurrentStates() const;
+
+	void* m_callbackOwner = nullptr;
+	void* m_validCallbackOwner = nullptr; // Null when raw callbacks must not be called
+
+private:
+	DECLARE_DELEGATE_RetVal_OneParam(bool, TrackVisitorDelegate, Track*);
+	DECLARE_DELEGATE_RetVal_OneParam(bool, StateVisitorDelegate, State*);
+	bool _VisitTrack(Track* _track, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor);
+	bool _VisitState(State* _track, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor);
+
+	bool _AssertIfTrackExists(Track* _track);
+	bool _AssertIfStateExists(State* _track);
+
+	// Nodes loaded from a cooked definition live in m_nodesArena and are only destructed, the others were allocated one by one
+	template<typename NodeType>
+	void _DestroyNode(NodeType* _node)
+	{
+		if ((uint8*)_node >= m_nodesArena && (uint8*)_node < m_nodesArena + m_nodesArenaSize)
+		{
+			_node->~NodeType();
+		}
+		else
+		{
+			delete _node;
+		}
+	}
+
+	void _AssignIndices();
+	void _ResetActiveStates();
+	void _BuildEventIndex();
+	void _ResetReachableEvents();
+	void _AddReachableEvents(const TArray<int32>& _eventIds);
+	void _RemoveReachableEvents(const TArray<int32>& _eventIds);
+	Track* _FindClosestCommonTrack(const Track* _trackA, const State* _stateB) const;
+	Track* _FindClosestCommonTrack(const State* _stateA, const State* _stateB) const;
+	bool _AreStatesConcurrent(const State* _stateA, const State* _stateB) const;
+
+	// Exiting states sorted by decreasing index and entering states sorted by increasing index when _eventId is dequeued from _currentStates
+	void _ResolveEvent(TArrayView<State* const> _currentStates, int32 _eventId, TArray<State*>& _outExitingStates, TArray<State*>& _outEnteringStates) const;
+
+	void _EnterState(State* _state);
+	void _ExitState(State* _state);
+
+	// Public calls without the recording, used internally
+	void _Stop();
+	void _DequeueEvents(uint16 _dequeuedEventsLimit = -1);
+
+	// PostEvent without the dequeuing: returns false when the event was rejected
+	bool _EnqueueEvent(int32 _eventId);
+
+	// _EnqueueEvent for events coming from outside of PostEvent, recorded as posted
+	bool _EnqueuePostedEvent(int32 _eventId);
+	FORCEINLINE bool _ShouldDequeueImmediately() const { return bImmediatelyDequeueEvents && !m_ticking && IsStarted() && !m_isDequeuingEvents; }
+
+	// False only when the event surely cannot fire once dequeued
+	bool _CanReactToEvent(int32 _eventId) const;
+
+	// Id of an event that may be posted from outside, INDEX_NONE for unknown names and the events of timed transitions
+	int32 _FindPublicEvent(FName _eventName) const;
+
+	static bool _HasCallbacks(const State* _state);
+	void _CollectEnterableStates(TSet<const State*>& _outStates) const;
+	int32 _CountDefaultStates() const;
+	void _FlattenTrack(Track* _track);
+
+	struct BatchTick
+	{
+		StateBatchTickFunction function;
+		TArray<void*> owners;
+	};
+
+	void _BeginTick(float _dt);
+	void _TickStates(float _dt, TArray<BatchTick>* _batches);
+	void _TickState(State* _state, float _dt, TArray<BatchTick>* _batches);
+	void _EndTick();
+
+	struct TickGroup
+	{
+		const Track* track = nullptr;
+		TArray<State*> states;
+		TArray<int32> postedEvents;
+	};
+
+	// Returns false when the states should tick serially
+	bool _BuildTickGroups();
+	void _TickStatesInParallel(float _dt);
+
+	void _SetCallbackOwner(void* _owner);
+	void _BuildCallbacksTable();
+
+	void _PollLatentEnters();
+	bool _ExitsEnteringState(const TArray<State*>& _exitingStates) const;
+	bool _HasSuspendedState(const TArray<State*>& _states) const;
+
+	// Default state of the track, or the state it resumes when it has a history
+	State* _GetEntryState(const Track* _track, TArrayView<State* const> _currentStates) const;
+	void _RequeueDeferredEvents();
+
+	void _ScheduleTimers(State* _state);
+	void _PostExpiredTimers();
+	bool _IsTimerStale(const ActiveTimer& _timer) const;
+
+	struct EventTransition
+	{
+		FName name;
+		Track* sourceTrack = nullptr;
+		State* sourceState = nullptr;
+		State* targetState = nullptr;
+		Track* commonTrack = nullptr; // Resolved at Start unless loaded from a cooked definition, cleared by OptimizeDefinition
+	};
+
+	bool _CanTransitionFire(const EventTransition* _transition, const TSet<const State*>& _enterableStates) const;
+
+	struct Event
+	{
+		FName name;
+		TArray<EventTransition*> transitions;
+		uint8 priority = 0;
+		bool timed = false; // Posted by the machine itself for a timed transition, named alike in every machine so never posted nor broadcast from outside
+	};
+
+	struct QueuedEvent
+	{
+		int32 eventId;
+		uint32 enterStamp; // For timed transitions, enter stamp of the source state when its timer was scheduled, 0 otherwise
+		double postTime; // Machine time, for the latency metrics
+	};
+
+	struct EventsQueue
+	{
+		uint8 priority;
+		TArray<QueuedEvent> events;
+	};
+
+	void _PushEvent(int32 _eventId, double _postTime, bool _front = false, uint32 _enterStamp = 0);
+	QueuedEvent _PopEvent();
+
+	TArray<Track*> m_rootTracks;
+	TMap<FName, Track*> m_tracks;
+	TMap<FName, State*> m_states;
+
+	uint8* m_nodesArena = nullptr; // Tracks, states and transitions of a cooked definition, see FHierarchicalStateMachineCookedDefinition
+	SIZE_T m_nodesArenaSize = 0;
+
+	TArray<State*> m_currentStates; // Order in this array matters
+	TBitArray<> m_activeStates; // Indexed by State::m_index
+	TArray<double> m_stateEnterTimes; // Indexed by State::m_index
+	TArray<uint32> m_stateEnterStamps; // Value of m_lastEnterStamp when the state was last entered, indexed by State::m_index
+	uint32 m_lastEnterStamp = 0;
+	TArray<State*> m_statesByIndex;
+	TArray<uint16> m_trackHistory; // Index of the last active state of each track resuming its history, MAX_uint16 if none, indexed by Track::m_index
+
+	// Raw callbacks of every state, indexed by State::m_index, read by enters, ticks and exits. Built at Start: each machine owns its
+	// definition, clones of a FHierarchicalStateMachinePrototype included, so there is no shared definition to hold it.
+	TArray<StateCallbacks> m_callbacksTable;
+
+	TMap<FName, int32> m_eventIds;
+	TArray<Event> m_events;
+	TArray<EventsQueue, TInlineAllocator<1>> m_eventsQueues; // One per priority posted so far, highest first
+	int32 m_queuedEventsCount = 0;
+	EventQueueMetrics m_eventQueueMetrics;
+
+	TArray<int32> m_rootReachableEventIds;
+	TArray<uint16> m_reachableEventCounts;
+	TBitArray<> m_reachableEvents;
+
+	struct TimedTransition
+	{
+		int32 eventId = INDEX_NONE;
+		State* sourceState = nullptr;
+		float delay = 0.f;
+	};
+
+	struct ActiveTimer
+	{
+		double deadline;
+		TimedTransition* transition;
+		uint32 enterStamp; // Timers of states exited or entered again since are stale
+
+		FORCEINLINE bool operator<(const ActiveTimer& _other) const { return deadline < _other.deadline; }
+	};
+
+	TArray<TimedTransition*> m_timedTransitions;
+	TArray<ActiveTimer> m_activeTimers; // Min-heap on deadline, stale timers are only dropped once expired or on compaction
+	int32 m_activeTimersCompactionSize = 32;
+	double m_time = 0.0;
+
+	struct PendingLatentEnter
+	{
+		State* state;
+		LatentTaskHandle task;
+	};
+
+	TArray<TickGroup> m_tickGroups; // Reused across ticks, the first group holds the states outside independent tracks
+	bool m_parallelTicking = false;
+
+	TArray<PendingLatentEnter> m_latentEnters;
+	TArray<QueuedEvent> m_deferredEvents; // Events that would have exited an entering state or touched a suspended track, queued again once unblocked
+
+	bool m_suspended = false;
+	TArray<const Track*, TInlineAllocator<2>> m_suspendedTracks;
+
+	uint32 m_traceId = 0;
+	uint32 m_startedTraceId = 0; // _GetTraceId() at Start, which cannot be called from the destructor
+
+	TArray<FHierarchicalStateMachineBroadcaster*, TInlineAllocator<1>> m_broadcasters; // Unregistered from on destruction
+	FHierarchicalStateMachineRecorder* m_recorder = nullptr; // Ended on destruction
+
+	uint32 m_configurationVersion = 0;
+	mutable FString m_currentStatesString;
+	mutable uint32 m_currentStatesStringVersion = MAX_uint32;
+
+	bool m_ticking = false;
+	bool m_started = false;
+	bool m_isDequeuingEvents = false;
+	bool m_definitionOptimized = false;
+	bool m_treeOrdersAssigned = false; // Cleared whenever the hierarchy changes, set by _AssignIndices
+
+#if STATEMACHINE_HISTORY_ENABLED
+	enum HistoryEntryType
+	{
+		HistoryEntryType_StateMachineStarted,
+		HistoryEntryType_StateMachineStopped,
+		HistoryEntryType_StateEntered,
+		HistoryEntryType_StateExited,
+		HistoryEntryType_EventPushed,
+		HistoryEntryType_EventPopped,
+	};
+
+	struct HistoryEntry
+	{
+		HistoryEntry() : eventName(TEXT("")) {}
+
+		HistoryEntryType type;
+		FDateTime time;
+		union
+		{
+			State* state;
+			FName eventName;
+		};
+	};
+	TArray<HistoryEntry> m_history;
+
+	void _LogStateMachineStarted();
+	void _LogStateMachineStopped();
+	void _LogStateEntered(State* _state);
+	void _LogStateExited(State* _state);
+	void _LogEventPushed(FName _name);
+	void _LogEventPopped(FName _name);
+#endif
+};
+
+
+// ==================
+// DEFINITION HELPERS
+// ==================
+
+// Works with FHierarchicalStateMachine and UHierarchicalStateMachine pointers alike
+#define STATEMACHINE_DEFINITION(HierarchicalStateMachinePointer)\
+	{\
+	auto* __hierarchicalStateMachine = HierarchicalStateMachinePointer;\
+	TArray<FHierarchicalStateMachine::Track*> __trackStack;\
+	TArray<FHierarchicalStateMachine::State*> __stateStack;\
+	FHierarchicalStateMachine::Track* __track;\
+	FHierarchicalStateMachine::State* __state;\
+	_STATEMACHINE_DEFINITION_CONTENT
+
+
+#define _STATEMACHINE_DEFINITION_CONTENT(...)\
+	__VA_ARGS__\
+	}
+
+
+#define DEFAULT_STATE(StateName)\
+	{\
+		__state = __trackStack.Top()->AddDefaultState(TEXT(#StateName)); \
+		__stateStack.Push(__state);\
+	}\
+	_STATE_CONTENT
+
+
+#define STATE(StateName)\
+	{\
+		__state = __trackStack.Top()->AddState(TEXT(#StateName)); \
+		__stateStack.Push(__state);\
+	}\
+	_STATE_CONTENT
+
+#define STATE_ENTER(objectPtr, methodPtr) __state->BindEnter<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(objectPtr)
+
+#define STATE_TICK(objectPtr, methodPtr) __state->BindTick<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(objectPtr)
+
+#define STATE_EXIT(objectPtr, methodPtr) __state->BindExit<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(objectPtr)
+
+#define STATE_ENTER_RAW(objectPtr, methodPtr) __hierarchicalStateMachine->BindRawEnter<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(__state, objectPtr)
+
+#define STATE_TICK_RAW(objectPtr, methodPtr) __hierarchicalStateMachine->BindRawTick<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(__state, objectPtr)
+
+#define STATE_EXIT_RAW(objectPtr, methodPtr) __hierarchicalStateMachine->BindRawExit<typename TRemovePointer<decltype(objectPtr)>::Type, methodPtr>(__state, objectPtr)
+
+#define STATE_TICK_BATCHED(objectPtr, functionPtr) __hierarchicalStateMachine->BindBatchTick(__state, objectPtr, functionPtr)
+
+
+
+#define _STATE_CONTENT(...)\
+	__VA_ARGS__\
+	__stateStack.Pop()
+
+
+#define TRACK(TrackName)\
+	if (__stateStack.Num() == 0)\
+	{\
+		__track = __hierarchicalStateMachine->AddRootTrack(TEXT(#TrackName));\
+	}\
+	else\
+	{\
+		__track = __stateStack.Top()->AddTrack(TEXT(#TrackName));\
+	}\
+	__trackStack.Push(__track);\
+	_TRACK_CONTENT
+
+
+// Marks the current track independent, see Track::SetIndependent
+#define TRACK_INDEPENDENT() __trackStack.Top()->SetIndependent(true)
+
+// See Track::SetHistory
+#define TRACK_HISTORY_SHALLOW() __trackStack.Top()->SetHistory(FHierarchicalStateMachine::TrackHistory_Shallow)
+#define TRACK_HISTORY_DEEP() __trackStack.Top()->SetHistory(FHierarchicalStateMachine::TrackHistory_Deep)
+
+
+#define _TRACK_CONTENT(...)\
+	__VA_ARGS__\
+	__trackStack.Pop()
+
+
+// NOTE: so far, I think event should be passed as string literals, since it will passed that way on the non-macro API
+#define TRANSITION_EVENT(eventName, sourceState, targetState)\
+	__hierarchicalStateMachine->AddEventTransition(eventName, #sourceState, #targetState)
+
+#define TRANSITION_TIMED(seconds, sourceState, targetState)\
+	__hierarchicalStateMachine->AddTimedTransition(#sourceState, #targetState, seconds)
+
+// After the event transitions, see SetEventPriority
+#define EVENT_PRIORITY(eventName, priority)\
+	__hierarchicalStateMachine->SetEventPriority(eventName, priority)
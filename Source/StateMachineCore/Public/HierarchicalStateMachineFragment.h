@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+// Runtime state of one entity running a shared definition: its current configuration and pending events, nothing else.
+// Meant to be stored by value in contiguous arrays next to the entity data and processed in bulk by FHierarchicalStateMachineProcessor.
+struct STATEMACHINECORE_API FHierarchicalStateMachineFragment
+{
+	int32 configurationId = INDEX_NONE; // Interned by the processor, INDEX_NONE when stopped
+	TArray<int32, TInlineAllocator<4>> eventsQueue;
+	int32 eventsHead = 0; // Next event to dequeue, the queue is reset once drained
+
+	FORCEINLINE bool IsStarted() const { return configurationId != INDEX_NONE; }
+};
+
+// Runs fragments against a definition shared by all of them. Callbacks are bound per state on the processor and receive the views
+// of every entity entering, ticking or exiting that state at once, so the cost of a callback is paid once per state per chunk
+// instead of once per entity.
+//
+// Each entity sees its callbacks in the same order as a FHierarchicalStateMachine would call them. Across entities, callbacks are
+// grouped by state: every exit of a dequeuing round runs before every enter, and ticks run state by state.
+// Trace and the delegates or raw bindings of the definition are not used by fragments. Definitions using timed transitions, track
+// history, latent enters, event priorities, dequeue budgets or independent tracks are rejected by the constructor.
+class STATEMACHINECORE_API FHierarchicalStateMachineProcessor
+{
+public:
+	typedef void (*StateEntitiesFunction)(TArrayView<void*> _entities);
+	typedef FHierarchicalStateMachine::StateBatchTickFunction StateEntitiesTickFunction;
+
+	// The definition is only read, is not started and must outlive the processor.
+	explicit FHierarchicalStateMachineProcessor(FHierarchicalStateMachine& _definition);
+
+	void BindEnter(FName _stateName, StateEntitiesFunction _function);
+	void BindTick(FName _stateName, StateEntitiesTickFunction _function);
+	void BindExit(FName _stateName, StateEntitiesFunction _function);
+
+	// Events are posted by id, see FindEvent. Posted events are only dequeued by DequeueEvents and Tick.
+	int32 FindEvent(FName _eventName) const;
+	static void PostEvent(FHierarchicalStateMachineFragment& _fragment, int32 _eventId);
+
+	// _entities[i] is the view passed to callbacks for _fragments[i]. Calls may be split in chunks of any size.
+	void Start(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities);
+	void Tick(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities, float _dt);
+	void Stop(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities);
+
+	// Dequeues one event per fragment per round, until every queue is empty.
+	void DequeueEvents(TArrayView<FHierarchicalStateMachineFragment> _fragments, TArrayView<void*> _entities);
+
+	FORCEINLINE const FHierarchicalStateMachine& GetDefinition() const { return *m_definition; }
+
+	// True within Start, Tick, Stop and DequeueEvents, which cannot be called again until they return
+	FORCEINLINE bool IsRunning() const { return m_running; }
+
+	// Sorted by state index, empty when the fragment is stopped
+	const TArray<FHierarchicalStateMachine::State*>& GetCurrentStates(const FHierarchicalStateMachineFragment& _fragment) const;
+
+	// Active configurations are interned once, and the outcome of an event dequeued from a configuration is memoized, so that
+	// fragments sharing a configuration resolve the same event with a single lookup.
+	struct TransitionCacheStats
+	{
+		uint32 hits = 0;
+		uint32 misses = 0;
+		uint32 uncached = 0; // Misses that could not be stored because the cache was full
+		int32 configurationsCount = 0;
+		int32 cachedTransitionsCount = 0;
+
+		FORCEINLINE float GetHitRate() const { return hits + misses > 0 ? float(hits) / float(hits + misses) : 0.f; }
+	};
+
+	FORCEINLINE const TransitionCacheStats& GetTransitionCacheStats() const { return m_cacheStats; }
+	FORCEINLINE void ResetTransitionCacheStats() { m_cacheStats.hits = m_cacheStats.misses = m_cacheStats.uncached = 0; }
+
+	// Number of (configuration, event) outcomes kept. Once reached, new outcomes are resolved on every dequeue instead.
+	int32 TransitionCacheCapacity = 4096;
+
+private:
+	static void _CheckSupportedFeatures(const FHierarchicalStateMachine& _definition);
+
+	struct StateCallbacks
+	{
+		StateEntitiesFunction enter = nullptr;
+		StateEntitiesTickFunction tick = nullptr;
+		StateEntitiesFunction exit = nullptr;
+	};
+
+	struct Configuration
+	{
+		TArray<FHierarchicalStateMachine::State*> states; // Sorted by state index
+		uint32 hash = 0;
+	};
+
+	struct CachedTransition
+	{
+		int32 nextConfigurationId = INDEX_NONE;
+		TArray<FHierarchicalStateMachine::State*> exitingStates;
+		TArray<FHierarchicalStateMachine::State*> enteringStates;
+	};
+
+	StateCallbacks* _FindCallbacks(FName _stateName);
+
+	int32 _InternConfiguration(TArray<FHierarchicalStateMachine::State*>& _states);
+	const CachedTransition& _ResolveEvent(int32 _configurationId, int32 _eventId);
+
+	// Calls the bound function of every non empty bucket and empties it
+	void _FlushExits();
+	void _FlushEnters();
+
+	FHierarchicalStateMachine* m_definition = nullptr;
+	bool m_running = false;
+
+	TArray<StateCallbacks> m_callbacks; // Indexed by State::GetIndex()
+	int32 m_defaultConfigurationId = INDEX_NONE;
+
+	TArray<Configuration> m_configurations;
+	TMultiMap<uint32, int32> m_configurationIds; // By hash
+	TArray<CachedTransition> m_cachedTransitions;
+	TMap<uint64, int32> m_cachedTransitionIds; // By (configuration id << 32 | event id)
+	CachedTransition m_uncachedTransition;
+	TransitionCacheStats m_cacheStats;
+
+	// Per state buckets of entities, reused across calls
+	TArray<TArray<void*>> m_exitingEntities;
+	TArray<TArray<void*>> m_enteringEntities;
+	TArray<TArray<void*>> m_tickingEntities;
+};
+
+// Single machine as a plain value: a fragment, the entity its callbacks receive and the processor of the shared definition, with the
+// API of FHierarchicalStateMachine. Costs no UObject, no garbage collection and no per instance definition, and is movable, so it can be
+// stored in arrays next to simulation data. Use the processor directly on fragment arrays to run many of them at once.
+//
+// Like FHierarchicalStateMachine, posted events are dequeued right away with bImmediatelyDequeueEvents. Events posted while the
+// processor is running, from callbacks, are queued instead: they are dequeued by that run when it processes the instance, by the
+// next Tick or DequeueEvents otherwise.
+class STATEMACHINECORE_API FHierarchicalStateMachineInstance
+{
+public:
+	FHierarchicalStateMachineInstance() {}
+
+	// The processor must outlive the instance
+	FHierarchicalStateMachineInstance(FHierarchicalStateMachineProcessor& _processor, void* _entity);
+
+	void Start();
+	void Stop();
+	void Tick(float _dt);
+
+	void PostEvent(FName _eventName);
+	void PostEvent(int32 _eventId);
+	void DequeueEvents();
+
+	FORCEINLINE bool IsStarted() const { return m_fragment.IsStarted(); }
+
+	// Sorted by state index, empty when stopped
+	const TArray<FHierarchicalStateMachine::State*>& GetCurrentStates() const;
+
+	// Switching entities is only allowed while stopped
+	void SetEntity(void* _entity);
+	FORCEINLINE void* GetEntity() const { return m_entity; }
+
+	FORCEINLINE FHierarchicalStateMachineProcessor* GetProcessor() const { return m_processor; }
+	FORCEINLINE const FHierarchicalStateMachineFragment& GetFragment() const { return m_fragment; }
+
+	bool bImmediatelyDequeueEvents = true;
+
+private:
+	FORCEINLINE TArrayView<FHierarchicalStateMachineFragment> _GetFragments() { return MakeArrayView(&m_fragment, 1); }
+	FORCEINLINE TArrayView<void*> _GetEntities() { return MakeArrayView(&m_entity, 1); }
+
+	FHierarchicalStateMachineProcessor* m_processor = nullptr;
+	FHierarchicalStateMachineFragment m_fragment;
+	void* m_entity = nullptr;
+};
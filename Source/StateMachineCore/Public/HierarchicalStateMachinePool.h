@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+// Definition, bindings and settings of a built machine, captured once so that copies of it can be made without running the code that
+// built it. The definition is kept cooked (see FHierarchicalStateMachineCookedDefinition): instantiating loads it in a single allocation,
+// then copies the delegates and raw bindings of each state.
+//
+// The callbacks owner of the prototype is replaced by the owner of each copy: raw bindings, and the delegates bound to that owner with
+// STATE_ENTER, STATE_TICK and STATE_EXIT. Other delegates are copied as they are. Wrapper data (state asset dependencies) and
+// broadcaster subscriptions are not part of the prototype.
+class STATEMACHINECORE_API FHierarchicalStateMachinePrototype
+{
+public:
+	// The prototype may be started or not, it is only read. _owner is the object its callbacks are bound to, by default the owner of its
+	// raw bindings. Delegates bound to it without STATE_ENTER, STATE_TICK or STATE_EXIT cannot be rebound and are not allowed.
+	explicit FHierarchicalStateMachinePrototype(const FHierarchicalStateMachine& _prototype, const void* _owner = nullptr);
+
+	// Builds a copy into an empty, stopped machine, with its callbacks bound to _callbackOwner
+	void Instantiate(FHierarchicalStateMachine& _outStateMachine, void* _callbackOwner) const;
+
+	// Binds the callbacks of a stopped copy to another owner in one call. A null owner unbinds the delegates of the prototype owner.
+	void RebindOwner(FHierarchicalStateMachine& _stateMachine, void* _callbackOwner) const;
+
+	FORCEINLINE int32 GetCookedSize() const { return m_cookedDefinition.Num(); }
+
+private:
+	typedef FHierarchicalStateMachine::StateCallbacks StateCallbacks;
+	typedef FHierarchicalStateMachine::State::DelegateBinders DelegateBinders;
+
+	struct StateBindings
+	{
+		FHierarchicalStateMachine::StateEnterDelegate enter;
+		FHierarchicalStateMachine::StateTickDelegate tick;
+		FHierarchicalStateMachine::StateExitDelegate exit;
+		FHierarchicalStateMachine::StateLatentEnterDelegate latentEnter;
+		StateCallbacks callbacks;
+		DelegateBinders binders;
+	};
+
+	// Delegates bound to the prototype owner, looked up by name since copies may have optimized their definition since
+	struct OwnerDelegates
+	{
+		FName stateName;
+		DelegateBinders binders;
+	};
+
+	TArray<uint8> m_cookedDefinition;
+	TArray<StateBindings> m_stateBindings; // In the insertion order of the definition states, which loading preserves
+	TArray<OwnerDelegates> m_ownerDelegates;
+
+	// Copies _delegate into _outDelegate, unless it is bound to the owner: _outBinder then binds it to the owner of each copy
+	template<typename DelegateType>
+	static void _CaptureDelegate(const DelegateType& _delegate, const void* _owner, FName _stateName, FHierarchicalStateMachine::State::DelegateBindFunction _binder,
+		DelegateType& _outDelegate, FHierarchicalStateMachine::State::DelegateBindFunction& _outBinder);
+
+	bool m_immediatelyDequeueEvents = false;
+	bool m_parallelTickTracks = false;
+	bool m_rejectUnhandledEvents = false;
+	bool m_optimizeDefinition = false;
+	uint16 m_dequeueEventsBudget = 0;
+	float m_dequeueMicrosecondsBudget = 0.f;
+};
+
+// Recycles machines of a single prototype, so that spawning an entity does not allocate a machine, build its definition or bind its
+// callbacks. Released machines are stopped, lose their runtime state (see FHierarchicalStateMachine::ResetRuntimeState) and leave
+// their broadcasters, so that nothing is queued on them until they are acquired and registered again.
+// Machines are allocated by blocks, each block being one contiguous array, and all of them are destroyed with the pool.
+class STATEMACHINECORE_API FHierarchicalStateMachinePool
+{
+public:
+	// See FHierarchicalStateMachinePrototype for _owner
+	explicit FHierarchicalStateMachinePool(const FHierarchicalStateMachine& _prototype, const void* _owner = nullptr);
+	~FHierarchicalStateMachinePool();
+
+	FHierarchicalStateMachinePool(const FHierarchicalStateMachinePool&) = delete;
+	FHierarchicalStateMachinePool& operator=(const FHierarchicalStateMachinePool&) = delete;
+
+	// Clones enough machines in one block for _count of them to be free, ahead of a spawn wave
+	void Reserve(int32 _count);
+
+	// Returns a stopped machine with its callbacks bound to _callbackOwner
+	FHierarchicalStateMachine* Acquire(void* _callbackOwner);
+
+	// One machine per owner, appended to _outStateMachines. Missing machines are cloned in a single block.
+	void Acquire(TArrayView<void* const> _callbackOwners, TArray<FHierarchicalStateMachine*>& _outStateMachines);
+
+	// Stops the machine if needed and makes it available again. It must have been acquired from this pool and not released since.
+	void Release(FHierarchicalStateMachine* _stateMachine);
+
+	FORCEINLINE int32 GetFreeCount() const { return m_freeStateMachines.Num(); }
+	FORCEINLINE int32 GetCount() const { return m_count; }
+	FORCEINLINE const FHierarchicalStateMachinePrototype& GetPrototype() const { return m_prototype; }
+
+private:
+	struct Block
+	{
+		FHierarchicalStateMachine* stateMachines;
+		int32 count;
+		int32 firstIndex; // Of its first machine in m_freeFlags
+	};
+
+	// Index of a machine of this pool in m_freeFlags, INDEX_NONE if it was not cloned by this pool
+	int32 _GetIndex(const FHierarchicalStateMachine* _stateMachine) const;
+
+	FHierarchicalStateMachinePrototype m_prototype;
+	TArray<Block> m_blocks; // Few of them, one per Reserve that had to clone
+	TArray<FHierarchicalStateMachine*> m_freeStateMachines;
+	TBitArray<> m_freeFlags;
+	int32 m_count = 0;
+};
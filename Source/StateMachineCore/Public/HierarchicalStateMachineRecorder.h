@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+class FArchive;
+
+// Records the calls made to a machine (Start, Stop, Tick deltas, posted events, DequeueEvents, DeserializeCurrentStates, suspensions,
+// latent enter completions) and the states it enters and exits, as a compact binary stream of state and event indices. Calls made by callbacks are
+// tagged as such, so that Replay can make them at the same point. Costs a few bytes per call, cheap enough for test servers.
+//
+// Recording and replaying must happen outside of any call to the machine. Recording while started begins with a snapshot of the current
+// states and pending events; timers, latent enters, deferred events and suspensions are not part of it, record from Start for exact replays.
+// StaticHierarchicalStateMachine and FHierarchicalStateMachineProcessor are not recorded.
+class STATEMACHINECORE_API FHierarchicalStateMachineRecorder
+{
+public:
+	FHierarchicalStateMachineRecorder() {}
+	~FHierarchicalStateMachineRecorder();
+
+	// Records in memory, see GetRecordedData
+	void Begin(FHierarchicalStateMachine& _stateMachine);
+
+	// Streams to a file, written every FlushSize bytes and when the recording ends. Returns false when the file cannot be created.
+	bool BeginToFile(FHierarchicalStateMachine& _stateMachine, const TCHAR* _filename);
+
+	// Also called when the machine is destroyed
+	void End();
+
+	FORCEINLINE bool IsRecording() const { return m_stateMachine != nullptr && !m_replaying; }
+
+	// Everything recorded in memory since Begin. Empty for file recordings.
+	FORCEINLINE const TArray<uint8>& GetRecordedData() const { return m_data; }
+
+	int32 FlushSize = 64 * 1024;
+
+	// Feeds a recording to a stopped machine built from the same definition, without waiting between ticks, and checks that it enters and
+	// exits the same states in the same order. Callbacks of that machine still run but the calls they make to it are ignored: the recorded
+	// ones are made instead. Returns false and describes the first divergence otherwise.
+	static bool Replay(FHierarchicalStateMachine& _stateMachine, TArrayView<const uint8> _data, FString* _outMismatch = nullptr);
+	static bool ReplayFile(FHierarchicalStateMachine& _stateMachine, const TCHAR* _filename, FString* _outMismatch = nullptr);
+
+private:
+	friend class FHierarchicalStateMachine;
+
+	enum RecordType : uint8
+	{
+		// Inputs
+		RecordType_Start,
+		RecordType_Stop,
+		RecordType_Tick,
+		RecordType_PostEvent,
+		RecordType_DequeueEvents,
+		RecordType_DeserializeCurrentStates,
+		RecordType_Snapshot,
+		RecordType_LatentEnterCompleted,
+		RecordType_Suspend,
+		RecordType_Resume,
+		RecordType_SuspendTrack,
+		RecordType_ResumeTrack,
+
+		// Outputs, checked while replaying
+		RecordType_TickStates,
+		RecordType_StateEntered,
+		RecordType_StateExited,
+		RecordType_LatentEnterStarted,
+
+		RecordType_CallbackFlag = 0x80, // Input made by a callback of the machine
+	};
+
+	// Called by the machine at the start of its public calls. While replaying, returns false for the calls made by callbacks.
+	bool _BeginInput(RecordType _type, uint16 _value = 0);
+	bool _BeginTickInput(float _dt);
+	bool _BeginTrackInput(RecordType _type, const FHierarchicalStateMachine::Track* _track);
+	bool _BeginDeserializeInput(const TArray<FString>& _states);
+	void _EndInput();
+
+	void _OnOutput(RecordType _type, uint16 _value = 0);
+	FHierarchicalStateMachine::LatentTaskHandle _OnLatentEnter(const FHierarchicalStateMachine::State* _state, const FHierarchicalStateMachine::LatentTaskHandle& _task);
+	void _OnPollLatentEnters();
+	void _OnLatentEnterCompleted(const FHierarchicalStateMachine::State* _state);
+
+	void _Attach(FHierarchicalStateMachine& _stateMachine);
+	void _WriteHeader();
+	void _WriteRecordType(uint8 _type);
+	void _WriteUInt16(uint16 _value);
+	void _Write(const void* _data, int32 _size);
+	void _Flush();
+
+	// Replay
+	bool _Read(void* _outData, int32 _size);
+	bool _ReadUInt16(uint16& _outValue);
+	bool _PeekRecordType(uint8& _outType) const;
+	bool _ExecuteInput(uint8 _type);
+	void _ExecuteCallbackInputs();
+	void _Fail(const FString& _mismatch);
+	FString _DescribeRecord(uint8 _type, uint16 _value) const;
+	const FHierarchicalStateMachine::State* _FindState(uint16 _index) const;
+
+	static bool _HasValue(uint8 _type);
+	static uint32 _ComputeDefinitionChecksum(const FHierarchicalStateMachine& _stateMachine);
+
+	FHierarchicalStateMachine* m_stateMachine = nullptr;
+	TArray<uint8> m_data;
+	FArchive* m_fileWriter = nullptr;
+	int32 m_inputsDepth = 0;
+
+	bool m_replaying = false;
+	TArrayView<const uint8> m_replayData;
+	int32 m_replayOffset = 0;
+	bool m_allowNextInput = false; // Set by the replay right before it makes a recorded call
+	bool m_verifying = true; // Cleared while a snapshot is restored
+	bool m_failed = false;
+	FString m_mismatch;
+};
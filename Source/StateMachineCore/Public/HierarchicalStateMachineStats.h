@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+#define STATEMACHINE_STATS_ENABLED (STATS || CSV_PROFILER)
+
+DECLARE_STATS_GROUP(TEXT("HierarchicalStateMachine"), STATGROUP_HierarchicalStateMachine, STATCAT_Advanced);
+
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Machines"), STAT_HSM_LiveMachines, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Active States"), STAT_HSM_ActiveStates, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events Posted"), STAT_HSM_EventsPosted, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events Dequeued"), STAT_HSM_EventsDequeued, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events Rejected"), STAT_HSM_EventsRejected, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Transitions"), STAT_HSM_Transitions, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Average Exit Set Size"), STAT_HSM_AverageExitSetSize, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Average Enter Set Size"), STAT_HSM_AverageEnterSetSize, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Queue High-Water Mark"), STAT_HSM_QueueHighWaterMark, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Events Carried Over"), STAT_HSM_EventsCarriedOver, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_FLOAT_COUNTER_STAT_EXTERN(TEXT("Max Event Latency (ms)"), STAT_HSM_MaxEventLatency, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DequeueEvents"), STAT_HSM_DequeueEvents, STATGROUP_HierarchicalStateMachine, STATEMACHINECORE_API);
+
+CSV_DECLARE_CATEGORY_MODULE_EXTERN(STATEMACHINECORE_API, HierarchicalStateMachine);
+
+// Activity of every machine, reported to STATGROUP_HierarchicalStateMachine ("stat HierarchicalStateMachine") and to the CSV profiler
+// category HierarchicalStateMachine. Recorders may be called from any thread. Per frame values (averages, high-water mark and every
+// CSV stat) are gathered in atomics and published by PublishFrame, called at the end of each frame by the StateMachineCore module.
+class STATEMACHINECORE_API FHierarchicalStateMachineStats
+{
+public:
+	// Values published by a PublishFrame: totals at that time, the others gathered since the previous PublishFrame
+	struct FrameValues
+	{
+		int32 liveMachines = 0;
+		int32 activeStates = 0;
+		int32 eventsPosted = 0;
+		int32 eventsDequeued = 0;
+		int32 eventsRejected = 0;
+		int32 transitions = 0;
+		float averageExitSetSize = 0.f;
+		float averageEnterSetSize = 0.f;
+		int32 queueHighWaterMark = 0;
+		int32 eventsCarriedOver = 0;
+		float maxEventLatency = 0.f; // In milliseconds of machine time
+	};
+
+#if STATEMACHINE_STATS_ENABLED
+	static void RecordMachineCreated();
+	static void RecordMachineDestroyed();
+	static void RecordStateEntered();
+	static void RecordStateExited();
+	static void RecordEventPosted(int32 _queueLength);
+	static void RecordEventRejected();
+	static void RecordEventDequeued();
+	static void RecordTransition(int32 _exitingStatesCount, int32 _enteringStatesCount);
+	static void RecordEventsCarriedOver(int32 _eventsCount);
+	static void RecordEventLatency(double _latency);
+
+	static void PublishFrame();
+
+	// Game thread only, like PublishFrame
+	FORCEINLINE static const FrameValues& GetLastPublishedFrame() { return s_lastPublishedFrame; }
+#else
+	FORCEINLINE static void RecordMachineCreated() {}
+	FORCEINLINE static void RecordMachineDestroyed() {}
+	FORCEINLINE static void RecordStateEntered() {}
+	FORCEINLINE static void RecordStateExited() {}
+	FORCEINLINE static void RecordEventPosted(int32 _queueLength) {}
+	FORCEINLINE static void RecordEventRejected() {}
+	FORCEINLINE static void RecordEventDequeued() {}
+	FORCEINLINE static void RecordTransition(int32 _exitingStatesCount, int32 _enteringStatesCount) {}
+	FORCEINLINE static void RecordEventsCarriedOver(int32 _eventsCount) {}
+	FORCEINLINE static void RecordEventLatency(double _latency) {}
+
+	FORCEINLINE static void PublishFrame() {}
+	FORCEINLINE static const FrameValues& GetLastPublishedFrame() { static const FrameValues values; return values; }
+#endif
+
+#if STATEMACHINE_STATS_ENABLED
+private:
+	// Current totals
+	static volatile int32 s_liveMachines;
+	static volatile int32 s_activeStates;
+
+	// Since the last PublishFrame
+	static volatile int32 s_eventsPosted;
+	static volatile int32 s_eventsDequeued;
+	static volatile int32 s_eventsRejected;
+	static volatile int32 s_transitions;
+	static volatile int32 s_exitedStates;
+	static volatile int32 s_enteredStates;
+	static volatile int32 s_queueHighWaterMark;
+	static volatile int32 s_eventsCarriedOver;
+	static volatile int32 s_maxEventLatency; // In microseconds of machine time
+
+	static FrameValues s_lastPublishedFrame;
+#endif
+};
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FHierarchicalStateMachine;
+
+#define STATEMACHINE_TRACE_ENABLED !UE_BUILD_SHIPPING
+
+enum class EHierarchicalStateMachineTraceType : uint8
+{
+	Started,
+	Stopped,
+	StateEntered,
+	StateExited,
+	EventPopped,
+};
+
+struct FHierarchicalStateMachineTraceEvent
+{
+	uint32 stateMachineId = 0; // UObject unique id of the machine
+	EHierarchicalStateMachineTraceType type = EHierarchicalStateMachineTraceType::Started;
+	FName name; // State or event name, debug name of the machine for Started
+	const FHierarchicalStateMachine* stateMachine = nullptr; // Started only, valid until the Stopped event of the same machine
+	uint64 frame = 0;
+	double time = 0.0;
+};
+
+// Lock-free ring buffer state machines write their activity to while at least one listener (the editor debugger for instance) is registered.
+// Writers never wait: they reserve a slot with an atomic increment and publish it with a sequence number. Readers keep their own cursor,
+// and silently skip slots that have been overwritten before they could read them.
+class STATEMACHINECORE_API FHierarchicalStateMachineTrace
+{
+public:
+	static constexpr int32 Capacity = 1 << 14;
+
+	// Must be called from the game thread
+	static void AddListener();
+	static void RemoveListener();
+
+	FORCEINLINE static bool IsEnabled() { return s_listenersCount > 0; }
+
+	static void Write(uint32 _stateMachineId, EHierarchicalStateMachineTraceType _type, FName _name, const FHierarchicalStateMachine* _stateMachine = nullptr);
+
+	// Appends events written since _cursor and advances it. Returns the number of events lost because the buffer wrapped.
+	static int32 Read(uint64& _cursor, TArray<FHierarchicalStateMachineTraceEvent>& _outEvents);
+
+	static uint64 GetWriteCursor();
+
+private:
+	struct Slot
+	{
+		volatile int64 sequence = -1;
+		FHierarchicalStateMachineTraceEvent event;
+	};
+
+	static Slot* s_slots;
+	static volatile int64 s_writeCursor;
+	static volatile int32 s_listenersCount;
+};
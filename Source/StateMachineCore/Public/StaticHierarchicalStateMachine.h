@@ -0,0 +1,800 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HierarchicalStateMachineCore.h"
+
+// Header-only counterpart of FHierarchicalStateMachine for hot per-entity machines.
+// The whole definition (hierarchy, state order, transition tables) is built by constexpr code and callbacks are plain member
+// function pointers of the owner class, so there is no delegate, no heap allocated node and no runtime route search.
+// Enter/Exit/Tick ordering follows FHierarchicalStateMachine exactly.
+
+namespace StaticStateMachine
+{
+	constexpr bool NamesEqual(const TCHAR* _a, const TCHAR* _b)
+	{
+		while (*_a && *_a == *_b)
+		{
+			++_a;
+			++_b;
+		}
+		return *_a == *_b;
+	}
+
+	// Not constexpr on purpose: reaching it while evaluating a definition turns the error into a compilation error.
+	inline void DefinitionError(const TCHAR* _message)
+	{
+		checkf(false, TEXT("%s"), _message);
+	}
+
+	template<int32 BitCount>
+	struct TStateMask
+	{
+		static constexpr int32 WordCount = (BitCount + 63) / 64;
+		uint64 words[WordCount] = {};
+
+		constexpr void Set(int32 _bit) { words[_bit >> 6] |= (uint64(1) << (_bit & 63)); }
+		constexpr void Clear(int32 _bit) { words[_bit >> 6] &= ~(uint64(1) << (_bit & 63)); }
+		constexpr bool Test(int32 _bit) const { return (words[_bit >> 6] & (uint64(1) << (_bit & 63))) != 0; }
+
+		constexpr bool IsEmpty() const
+		{
+			for (int32 i = 0; i < WordCount; ++i)
+			{
+				if (words[i] != 0)
+					return false;
+			}
+			return true;
+		}
+
+		constexpr bool Intersects(const TStateMask& _other) const
+		{
+			for (int32 i = 0; i < WordCount; ++i)
+			{
+				if ((words[i] & _other.words[i]) != 0)
+					return true;
+			}
+			return false;
+		}
+
+		constexpr void Reset()
+		{
+			for (int32 i = 0; i < WordCount; ++i)
+			{
+				words[i] = 0;
+			}
+		}
+
+		// this |= _a & _b
+		constexpr void AddIntersection(const TStateMask& _a, const TStateMask& _b)
+		{
+			for (int32 i = 0; i < WordCount; ++i)
+			{
+				words[i] |= _a.words[i] & _b.words[i];
+			}
+		}
+	};
+}
+
+
+template<typename InOwnerType, int32 MaxStates, int32 MaxTracks = MaxStates, int32 MaxTransitions = MaxStates>
+class TStaticStateMachineDefinition
+{
+public:
+	typedef InOwnerType OwnerType;
+	typedef void (OwnerType::*EnterFunction)();
+	typedef void (OwnerType::*TickFunction)(float);
+	typedef void (OwnerType::*ExitFunction)();
+	typedef StaticStateMachine::TStateMask<MaxStates> StateMask;
+
+	static constexpr int32 MaxStateCount = MaxStates;
+
+	struct StateDesc
+	{
+		const TCHAR* name = nullptr;
+		int32 parentTrack = INDEX_NONE;
+		int32 parentState = INDEX_NONE;
+		EnterFunction enter = nullptr;
+		TickFunction tick = nullptr;
+		ExitFunction exit = nullptr;
+		int32 firstChildTrack = 0; // Into childTracks
+		int32 childTrackCount = 0;
+	};
+
+	struct TrackDesc
+	{
+		const TCHAR* name = nullptr;
+		int32 parentState = INDEX_NONE;
+		int32 defaultState = INDEX_NONE;
+		StateMask childStates;
+	};
+
+	struct TransitionDesc
+	{
+		int32 event = INDEX_NONE;
+		const TCHAR* sourceName = nullptr;
+		const TCHAR* targetName = nullptr;
+		int32 sourceTrack = INDEX_NONE;
+		int32 sourceState = INDEX_NONE;
+		int32 targetState = INDEX_NONE;
+		int32 commonTrack = INDEX_NONE; // INDEX_NONE means the transition can never fire
+		StateMask exitMask; // States exited by this transition if they are active
+	};
+
+	struct EventDesc
+	{
+		const TCHAR* name = nullptr;
+		int32 firstTransition = 0;
+		int32 transitionCount = 0;
+	};
+
+	// Once finalized, states are sorted the way FHierarchicalStateMachine orders them: by track (depth first), then by declaration order
+	// inside their track. Tracks stay in declaration order, which is depth first.
+	StateDesc states[MaxStates] = {};
+	TrackDesc tracks[MaxTracks] = {};
+	TransitionDesc transitions[MaxTransitions] = {};
+	EventDesc events[MaxTransitions] = {};
+	int32 childTracks[MaxTracks] = {};
+
+	int32 stateCount = 0;
+	int32 trackCount = 0;
+	int32 transitionCount = 0;
+	int32 eventCount = 0;
+
+	// ===== BUILDING =====
+
+	constexpr TStaticStateMachineDefinition& BeginTrack(const TCHAR* _name)
+	{
+		if (trackCount >= MaxTracks)
+			StaticStateMachine::DefinitionError(TEXT("Too many Tracks, increase MaxTracks."));
+
+		if (FindTrack(_name) != INDEX_NONE)
+			StaticStateMachine::DefinitionError(TEXT("A Track with this name already exists."));
+
+		tracks[trackCount].name = _name;
+		tracks[trackCount].parentState = m_stateStackSize > 0 ? m_stateStack[m_stateStackSize - 1] : INDEX_NONE;
+		m_trackStack[m_trackStackSize++] = trackCount;
+		++trackCount;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& EndTrack()
+	{
+		--m_trackStackSize;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& BeginState(const TCHAR* _name, bool _isDefault)
+	{
+		if (stateCount >= MaxStates)
+			StaticStateMachine::DefinitionError(TEXT("Too many States, increase MaxStates."));
+
+		if (m_trackStackSize == 0)
+			StaticStateMachine::DefinitionError(TEXT("States must be declared inside a Track."));
+
+		if (FindState(_name) != INDEX_NONE)
+			StaticStateMachine::DefinitionError(TEXT("A State with this name already exists."));
+
+		int32 track = m_trackStack[m_trackStackSize - 1];
+		states[stateCount].name = _name;
+		states[stateCount].parentTrack = track;
+		states[stateCount].parentState = tracks[track].parentState;
+
+		if (_isDefault)
+		{
+			if (tracks[track].defaultState != INDEX_NONE)
+				StaticStateMachine::DefinitionError(TEXT("Track already has a default State."));
+
+			tracks[track].defaultState = stateCount;
+		}
+
+		m_stateStack[m_stateStackSize++] = stateCount;
+		++stateCount;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& EndState()
+	{
+		--m_stateStackSize;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& Enter(EnterFunction _function)
+	{
+		states[m_stateStack[m_stateStackSize - 1]].enter = _function;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& Tick(TickFunction _function)
+	{
+		states[m_stateStack[m_stateStackSize - 1]].tick = _function;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& Exit(ExitFunction _function)
+	{
+		states[m_stateStack[m_stateStackSize - 1]].exit = _function;
+		return *this;
+	}
+
+	constexpr TStaticStateMachineDefinition& TransitionEvent(const TCHAR* _eventName, const TCHAR* _sourceName, const TCHAR* _targetStateName)
+	{
+		if (transitionCount >= MaxTransitions)
+			StaticStateMachine::DefinitionError(TEXT("Too many Transitions, increase MaxTransitions."));
+
+		int32 eventId = FindEvent(_eventName);
+		if (eventId == INDEX_NONE)
+		{
+			eventId = eventCount++;
+			events[eventId].name = _eventName;
+		}
+
+		transitions[transitionCount].event = eventId;
+		transitions[transitionCount].sourceName = _sourceName;
+		transitions[transitionCount].targetName = _targetStateName;
+		++transitionCount;
+		return *this;
+	}
+
+	// Sorts states, resolves transitions and precomputes everything the runtime needs.
+	constexpr TStaticStateMachineDefinition Finalize() const
+	{
+		if (m_trackStackSize != 0 || m_stateStackSize != 0)
+			StaticStateMachine::DefinitionError(TEXT("Unbalanced State Machine definition."));
+
+		TStaticStateMachineDefinition result;
+
+		// States order
+		int32 order[MaxStates] = {};
+		int32 nextIndex = 0;
+		for (int32 t = 0; t < trackCount; ++t)
+		{
+			if (tracks[t].defaultState == INDEX_NONE)
+				StaticStateMachine::DefinitionError(TEXT("Track does not have a default state set up."));
+
+			for (int32 s = 0; s < stateCount; ++s)
+			{
+				if (states[s].parentTrack == t)
+				{
+					order[s] = nextIndex++;
+				}
+			}
+		}
+
+		result.stateCount = stateCount;
+		for (int32 s = 0; s < stateCount; ++s)
+		{
+			StateDesc& state = result.states[order[s]];
+			state = states[s];
+			state.parentState = states[s].parentState != INDEX_NONE ? order[states[s].parentState] : INDEX_NONE;
+		}
+
+		result.trackCount = trackCount;
+		for (int32 t = 0; t < trackCount; ++t)
+		{
+			TrackDesc& track = result.tracks[t];
+			track.name = tracks[t].name;
+			track.parentState = tracks[t].parentState != INDEX_NONE ? order[tracks[t].parentState] : INDEX_NONE;
+			track.defaultState = order[tracks[t].defaultState];
+		}
+
+		int32 childTrackCursor = 0;
+		for (int32 s = 0; s < stateCount; ++s)
+		{
+			result.tracks[result.states[s].parentTrack].childStates.Set(s);
+
+			result.states[s].firstChildTrack = childTrackCursor;
+			for (int32 t = 0; t < trackCount; ++t)
+			{
+				if (result.tracks[t].parentState == s)
+				{
+					result.childTracks[childTrackCursor++] = t;
+				}
+			}
+			result.states[s].childTrackCount = childTrackCursor - result.states[s].firstChildTrack;
+		}
+
+		// Transitions, grouped by event while keeping declaration order
+		result.eventCount = eventCount;
+		result.transitionCount = 0;
+		for (int32 e = 0; e < eventCount; ++e)
+		{
+			result.events[e].name = events[e].name;
+			result.events[e].firstTransition = result.transitionCount;
+
+			for (int32 i = 0; i < transitionCount; ++i)
+			{
+				if (transitions[i].event != e)
+					continue;
+
+				TransitionDesc& transition = result.transitions[result.transitionCount++];
+				transition.event = e;
+				transition.sourceName = transitions[i].sourceName;
+				transition.targetName = transitions[i].targetName;
+
+				transition.sourceTrack = result.FindTrack(transition.sourceName);
+				if (transition.sourceTrack == INDEX_NONE)
+				{
+					transition.sourceState = result.FindState(transition.sourceName);
+					if (transition.sourceState == INDEX_NONE)
+						StaticStateMachine::DefinitionError(TEXT("Source Name does not match any Track or State."));
+				}
+
+				transition.targetState = result.FindState(transition.targetName);
+				if (transition.targetState == INDEX_NONE)
+					StaticStateMachine::DefinitionError(TEXT("Target Name does not match any State."));
+
+				transition.commonTrack = transition.sourceTrack != INDEX_NONE
+					? result.FindClosestCommonTrackFromTrack(transition.sourceTrack, transition.targetState)
+					: result.FindClosestCommonTrack(transition.sourceState, transition.targetState);
+
+				if (transition.commonTrack == INDEX_NONE)
+					continue;
+
+				for (int32 s = 0; s < stateCount; ++s)
+				{
+					if (result.IsInTrack(s, transition.commonTrack) && result.AreStatesConcurrent(s, transition.targetState))
+					{
+						transition.exitMask.Set(s);
+					}
+				}
+			}
+
+			result.events[e].transitionCount = result.transitionCount - result.events[e].firstTransition;
+		}
+
+		return result;
+	}
+
+	// ===== QUERIES =====
+
+	constexpr int32 FindTrack(const TCHAR* _name) const
+	{
+		for (int32 i = 0; i < trackCount; ++i)
+		{
+			if (StaticStateMachine::NamesEqual(tracks[i].name, _name))
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	constexpr int32 FindState(const TCHAR* _name) const
+	{
+		for (int32 i = 0; i < stateCount; ++i)
+		{
+			if (StaticStateMachine::NamesEqual(states[i].name, _name))
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	constexpr int32 FindEvent(const TCHAR* _name) const
+	{
+		for (int32 i = 0; i < eventCount; ++i)
+		{
+			if (StaticStateMachine::NamesEqual(events[i].name, _name))
+				return i;
+		}
+		return INDEX_NONE;
+	}
+
+	constexpr int32 GetParentTrackOfTrack(int32 _track) const
+	{
+		return tracks[_track].parentState != INDEX_NONE ? states[tracks[_track].parentState].parentTrack : INDEX_NONE;
+	}
+
+	constexpr bool IsInTrack(int32 _state, int32 _track) const
+	{
+		int32 currentTrack = states[_state].parentTrack;
+		while (currentTrack != INDEX_NONE)
+		{
+			if (currentTrack == _track)
+				return true;
+
+			currentTrack = GetParentTrackOfTrack(currentTrack);
+		}
+		return false;
+	}
+
+	// Mirrors FHierarchicalStateMachine::_FindClosestCommonTrack(const State*, const State*)
+	constexpr int32 FindClosestCommonTrack(int32 _stateA, int32 _stateB) const
+	{
+		if (_stateA == INDEX_NONE || _stateB == INDEX_NONE)
+			return INDEX_NONE;
+
+		if (states[_stateA].parentTrack == states[_stateB].parentTrack)
+			return states[_stateA].parentTrack;
+
+		for (int32 i = 0; i < states[_stateB].childTrackCount; ++i)
+		{
+			int32 track = childTracks[states[_stateB].firstChildTrack + i];
+			if (_IsTrackOfStateOrAncestor(track, _stateA))
+				return track;
+		}
+
+		int32 currentTrack = states[_stateB].parentTrack;
+		while (currentTrack != INDEX_NONE)
+		{
+			if (_IsTrackOfStateOrAncestor(currentTrack, _stateA))
+				return currentTrack;
+
+			currentTrack = GetParentTrackOfTrack(currentTrack);
+		}
+		return INDEX_NONE;
+	}
+
+	// Mirrors FHierarchicalStateMachine::_FindClosestCommonTrack(const Track*, const State*)
+	constexpr int32 FindClosestCommonTrackFromTrack(int32 _trackA, int32 _stateB) const
+	{
+		int32 s = _stateB;
+		while (s != INDEX_NONE)
+		{
+			if (states[s].parentTrack == _trackA)
+				return _trackA;
+
+			s = states[s].parentState;
+		}
+
+		return FindClosestCommonTrack(tracks[_trackA].parentState, _stateB);
+	}
+
+	// Mirrors FHierarchicalStateMachine::_AreStatesConcurrent
+	constexpr bool AreStatesConcurrent(int32 _stateA, int32 _stateB) const
+	{
+		if (_stateA == _stateB)
+			return true;
+
+		if (states[_stateA].parentTrack == states[_stateB].parentTrack)
+			return true;
+
+		int32 AStates[MaxStates] = {};
+		int32 ATracks[MaxStates] = {};
+		int32 ACount = 0;
+		for (int32 s = _stateA; s != INDEX_NONE; s = states[s].parentState)
+		{
+			AStates[ACount] = s;
+			ATracks[ACount] = states[s].parentTrack;
+			++ACount;
+		}
+
+		for (int32 s = _stateB; s != INDEX_NONE; s = states[s].parentState)
+		{
+			for (int32 i = 0; i < ACount; ++i)
+			{
+				// If the first thing we have in common is a State, we are not concurrent. If it is a Track, we are.
+				if (AStates[i] == s) return false;
+				if (ATracks[i] == states[s].parentTrack) return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	// Tracks owned by the state, or tracks the state is in
+	constexpr bool _IsTrackOfStateOrAncestor(int32 _track, int32 _state) const
+	{
+		return tracks[_track].parentState == _state || IsInTrack(_state, _track);
+	}
+
+	int32 m_trackStack[MaxTracks] = {};
+	int32 m_trackStackSize = 0;
+	int32 m_stateStack[MaxStates] = {};
+	int32 m_stateStackSize = 0;
+};
+
+
+template<typename DefinitionType, const DefinitionType& Definition>
+class TStaticHierarchicalStateMachine
+{
+public:
+	typedef typename DefinitionType::OwnerType OwnerType;
+	typedef typename DefinitionType::StateMask StateMask;
+
+	static constexpr uint16 DefaultDequeuedEventsLimit = 5000;
+
+	explicit TStaticHierarchicalStateMachine(OwnerType* _owner)
+		: m_owner(_owner)
+	{
+	}
+
+	void Start()
+	{
+		STATEMACHINE_ASSERT(!IsStarted());
+		STATEMACHINE_ASSERT(m_currentStatesCount == 0);
+
+		// Tracks are sorted depth first, so a parent state is always activated before its sub tracks are considered
+		for (int32 t = 0; t < Definition.trackCount; ++t)
+		{
+			int32 parentState = Definition.tracks[t].parentState;
+			if (parentState == INDEX_NONE || m_activeStates.Test(parentState))
+			{
+				m_activeStates.Set(Definition.tracks[t].defaultState);
+			}
+		}
+		_RebuildCurrentStates();
+
+		for (int32 i = 0; i < m_currentStatesCount; ++i)
+		{
+			_EnterState(m_currentStates[i]);
+		}
+
+		m_started = true;
+
+		DequeueEvents();
+	}
+
+	void Tick(float _dt)
+	{
+		STATEMACHINE_ASSERT(IsStarted());
+		STATEMACHINE_ASSERT(!m_ticking);
+
+		DequeueEvents();
+
+		m_ticking = true;
+		for (int32 i = 0; i < m_currentStatesCount; ++i)
+		{
+			typename DefinitionType::TickFunction tick = Definition.states[m_currentStates[i]].tick;
+			if (tick)
+			{
+				(m_owner->*tick)(_dt);
+			}
+		}
+		m_ticking = false;
+
+		DequeueEvents();
+
+		if (!m_started)
+		{
+			_ExitAllStates();
+		}
+	}
+
+	void Stop()
+	{
+		STATEMACHINE_ASSERT(IsStarted());
+		m_started = false;
+		if (!m_ticking)
+		{
+			_ExitAllStates();
+		}
+	}
+
+	void PostEvent(int32 _eventId)
+	{
+		STATEMACHINE_ASSERT_MSG(_eventId >= 0 && _eventId < Definition.eventCount, TEXT("Unknown event."));
+
+		m_eventsQueue.Add(_eventId);
+		if (bImmediatelyDequeueEvents && !m_ticking && IsStarted() && !m_isDequeuingEvents)
+		{
+			DequeueEvents();
+		}
+	}
+
+	void PostEvent(const TCHAR* _eventName)
+	{
+		PostEvent(Definition.FindEvent(_eventName));
+	}
+
+	void DequeueEvents(uint16 _dequeuedEventsLimit = MAX_uint16)
+	{
+		m_isDequeuingEvents = true;
+
+		if (_dequeuedEventsLimit == MAX_uint16)
+			_dequeuedEventsLimit = DefaultDequeuedEventsLimit;
+
+		uint16 dequeuedEventsCount = 0;
+		while ((dequeuedEventsCount < _dequeuedEventsLimit) && m_eventsQueue.Num() != 0)
+		{
+			++dequeuedEventsCount;
+			int32 evt = m_eventsQueue[0];
+			m_eventsQueue.RemoveAt(0, 1, false);
+
+			StateMask exitingStates;
+			StateMask enteringStates;
+
+			const typename DefinitionType::EventDesc& eventDesc = Definition.events[evt];
+			for (int32 i = eventDesc.firstTransition; i < eventDesc.firstTransition + eventDesc.transitionCount; ++i)
+			{
+				const typename DefinitionType::TransitionDesc& transition = Definition.transitions[i];
+				if (transition.sourceState != INDEX_NONE && !m_activeStates.Test(transition.sourceState))
+					continue;
+
+				if (transition.commonTrack == INDEX_NONE)
+					continue;
+
+				exitingStates.AddIntersection(m_activeStates, transition.exitMask);
+
+				// No exiting states means transition is irrelevant
+				if (exitingStates.IsEmpty())
+					continue;
+
+				enteringStates.Set(transition.targetState);
+				{
+					int32 ascendingState = Definition.states[transition.targetState].parentState;
+					while (ascendingState != INDEX_NONE && !m_activeStates.Test(ascendingState))
+					{
+						enteringStates.Set(ascendingState);
+						ascendingState = Definition.states[ascendingState].parentState;
+					}
+				}
+
+				bool changed = true;
+				while (changed)
+				{
+					changed = false;
+					for (int32 s = 0; s < Definition.stateCount; ++s)
+					{
+						if (!enteringStates.Test(s))
+							continue;
+
+						const typename DefinitionType::StateDesc& state = Definition.states[s];
+						for (int32 j = 0; j < state.childTrackCount; ++j)
+						{
+							const typename DefinitionType::TrackDesc& track = Definition.tracks[Definition.childTracks[state.firstChildTrack + j]];
+							if (!enteringStates.Intersects(track.childStates))
+							{
+								enteringStates.Set(track.defaultState);
+								changed = true;
+							}
+						}
+					}
+				}
+			}
+
+			// Exiting states
+			for (int32 s = Definition.stateCount - 1; s >= 0; --s)
+			{
+				if (exitingStates.Test(s))
+				{
+					_ExitState(s);
+					m_activeStates.Clear(s);
+				}
+			}
+
+			// Entering states
+			for (int32 s = 0; s < Definition.stateCount; ++s)
+			{
+				if (enteringStates.Test(s))
+				{
+					_EnterState(s);
+					m_activeStates.Set(s);
+				}
+			}
+
+			_RebuildCurrentStates();
+		}
+
+		if (dequeuedEventsCount >= DefaultDequeuedEventsLimit)
+		{
+			UE_LOG(LogTemp, Error, TEXT("[StateMachine] Stopped events dequeuing after having dequeued more than %d events. There may be an infinite events loop somewhere."), int32(DefaultDequeuedEventsLimit));
+		}
+
+		m_isDequeuingEvents = false;
+	}
+
+	FORCEINLINE bool IsStarted() const { return m_started; }
+	FORCEINLINE bool IsStateActive(int32 _state) const { return m_activeStates.Test(_state); }
+	FORCEINLINE int32 GetCurrentStatesCount() const { return m_currentStatesCount; }
+	FORCEINLINE int32 GetCurrentState(int32 _index) const { return m_currentStates[_index]; }
+	FORCEINLINE static const TCHAR* GetStateName(int32 _state) { return Definition.states[_state].name; }
+
+	bool bImmediatelyDequeueEvents = true;
+
+private:
+	FORCEINLINE void _EnterState(int32 _state)
+	{
+		typename DefinitionType::EnterFunction enter = Definition.states[_state].enter;
+		if (enter)
+		{
+			(m_owner->*enter)();
+		}
+	}
+
+	FORCEINLINE void _ExitState(int32 _state)
+	{
+		typename DefinitionType::ExitFunction exit = Definition.states[_state].exit;
+		if (exit)
+		{
+			(m_owner->*exit)();
+		}
+	}
+
+	void _ExitAllStates()
+	{
+		for (int32 i = m_currentStatesCount - 1; i >= 0; --i)
+		{
+			_ExitState(m_currentStates[i]);
+		}
+		m_activeStates.Reset();
+		m_currentStatesCount = 0;
+	}
+
+	void _RebuildCurrentStates()
+	{
+		m_currentStatesCount = 0;
+		for (int32 s = 0; s < Definition.stateCount; ++s)
+		{
+			if (m_activeStates.Test(s))
+			{
+				m_currentStates[m_currentStatesCount++] = int16(s);
+			}
+		}
+	}
+
+	OwnerType* m_owner = nullptr;
+
+	StateMask m_activeStates;
+	int16 m_currentStates[DefinitionType::MaxStateCount] = {}; // Sorted, like FHierarchicalStateMachine::m_currentStates
+	int32 m_currentStatesCount = 0;
+
+	TArray<int32, TInlineAllocator<8>> m_eventsQueue;
+
+	bool m_ticking = false;
+	bool m_started = false;
+	bool m_isDequeuingEvents = false;
+};
+
+
+// ==================
+// DEFINITION HELPERS
+// ==================
+
+// Usage mirrors STATEMACHINE_DEFINITION, without separators between entries since the definition is a single constexpr expression:
+// static constexpr auto s_definition = STATIC_STATEMACHINE_DEFINITION(UMyClass, 16)
+// (
+//   STATIC_TRACK(Root)
+//   (
+//     STATIC_DEFAULT_STATE(Idle)
+//     (
+//       STATIC_STATE_TICK(&UMyClass::Idle_Tick)
+//     )
+//     STATIC_STATE(Move)()
+//   )
+//   STATIC_TRANSITION_EVENT("Go", Idle, Move)
+// );
+// TStaticHierarchicalStateMachine<decltype(s_definition), s_definition> stateMachine(this);
+
+#define STATIC_STATEMACHINE_DEFINITION(OwnerType, MaxStates)\
+	TStaticStateMachineDefinition<OwnerType, MaxStates>()\
+	_STATIC_STATEMACHINE_DEFINITION_CONTENT
+
+
+#define _STATIC_STATEMACHINE_DEFINITION_CONTENT(...)\
+	__VA_ARGS__\
+	.Finalize()
+
+
+#define STATIC_DEFAULT_STATE(StateName)\
+	.BeginState(TEXT(#StateName), true)\
+	_STATIC_STATE_CONTENT
+
+
+#define STATIC_STATE(StateName)\
+	.BeginState(TEXT(#StateName), false)\
+	_STATIC_STATE_CONTENT
+
+#define STATIC_STATE_ENTER(methodPtr) .Enter(methodPtr)
+
+#define STATIC_STATE_TICK(methodPtr) .Tick(methodPtr)
+
+#define STATIC_STATE_EXIT(methodPtr) .Exit(methodPtr)
+
+
+#define _STATIC_STATE_CONTENT(...)\
+	__VA_ARGS__\
+	.EndState()
+
+
+#define STATIC_TRACK(TrackName)\
+	.BeginTrack(TEXT(#TrackName))\
+	_STATIC_TRACK_CONTENT
+
+
+#define _STATIC_TRACK_CONTENT(...)\
+	__VA_ARGS__\
+	.EndTrack()
+
+
+#define STATIC_TRANSITION_EVENT(eventName, sourceState, targetState)\
+	.TransitionEvent(TEXT(eventName), TEXT(#sourceState), TEXT(#targetState))
@@ -0,0 +1,315 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "SHierarchicalStateMachineDebugger.h"
+
+#include <UObject/UObjectIterator.h>
+#include <Widgets/Input/SSlider.h>
+#include <Widgets/Layout/SScrollBox.h>
+#include <Widgets/Layout/SSplitter.h>
+#include <Widgets/SBoxPanel.h>
+#include <Widgets/Text/STextBlock.h>
+#include <Widgets/Views/STableRow.h>
+
+#include <HierarchicalStateMachine.h>
+
+#define LOCTEXT_NAMESPACE "SHierarchicalStateMachineDebugger"
+
+void SHierarchicalStateMachineDebugger::Construct(const FArguments& InArgs)
+{
+	FHierarchicalStateMachineTrace::AddListener();
+	m_traceCursor = FHierarchicalStateMachineTrace::GetWriteCursor();
+
+	ChildSlot
+	[
+		SNew(SSplitter)
+		.Orientation(Orient_Horizontal)
+
+		+ SSplitter::Slot()
+		.Value(0.3f)
+		[
+			SAssignNew(m_machinesListView, SListView<MachineItem>)
+			.ListItemsSource(&m_machines)
+			.SelectionMode(ESelectionMode::Single)
+			.OnGenerateRow(this, &SHierarchicalStateMachineDebugger::_OnGenerateMachineRow)
+			.OnSelectionChanged(this, &SHierarchicalStateMachineDebugger::_OnMachineSelectionChanged)
+		]
+
+		+ SSplitter::Slot()
+		.Value(0.7f)
+		[
+			SNew(SVerticalBox)
+
+			+ SVerticalBox::Slot()
+			.FillHeight(1.f)
+			[
+				SNew(SScrollBox)
+				+ SScrollBox::Slot()
+				[
+					SNew(STextBlock)
+					.Font(FCoreStyle::GetDefaultFontStyle("Mono", 9))
+					.Text(this, &SHierarchicalStateMachineDebugger::_GetHierarchyText)
+				]
+			]
+
+			+ SVerticalBox::Slot()
+			.AutoHeight()
+			.Padding(4.f)
+			[
+				SNew(SSlider)
+				.Value(this, &SHierarchicalStateMachineDebugger::_GetScrubValue)
+				.OnValueChanged(this, &SHierarchicalStateMachineDebugger::_OnScrubValueChanged)
+			]
+
+			+ SVerticalBox::Slot()
+			.AutoHeight()
+			.Padding(4.f)
+			[
+				SNew(STextBlock)
+				.Text(this, &SHierarchicalStateMachineDebugger::_GetScrubText)
+			]
+		]
+	];
+
+	_ResyncMachines();
+}
+
+SHierarchicalStateMachineDebugger::~SHierarchicalStateMachineDebugger()
+{
+	FHierarchicalStateMachineTrace::RemoveListener();
+}
+
+void SHierarchicalStateMachineDebugger::Tick(const FGeometry& AllottedGeometry, const double InCurrentTime, const float InDeltaTime)
+{
+	SCompoundWidget::Tick(AllottedGeometry, InCurrentTime, InDeltaTime);
+
+	_ReadTrace();
+
+	if (m_hierarchyTextDirty)
+	{
+		m_hierarchyTextDirty = false;
+		_RebuildHierarchyText();
+	}
+}
+
+void SHierarchicalStateMachineDebugger::Machine::AddTransition(const FHierarchicalStateMachineTraceEvent& _event)
+{
+	if (transitions.Num() < MaxTransitionsPerMachine)
+	{
+		transitions.Add(_event);
+		return;
+	}
+
+	transitions[transitionsHead] = _event;
+	transitionsHead = (transitionsHead + 1) % MaxTransitionsPerMachine;
+}
+
+TSharedRef<ITableRow> SHierarchicalStateMachineDebugger::_OnGenerateMachineRow(MachineItem _item, const TSharedRef<STableViewBase>& _ownerTable)
+{
+	return SNew(STableRow<MachineItem>, _ownerTable)
+	[
+		SNew(STextBlock).Text(FText::FromName(_item->label))
+	];
+}
+
+void SHierarchicalStateMachineDebugger::_OnMachineSelectionChanged(MachineItem _item, ESelectInfo::Type _selectInfo)
+{
+	m_selectedMachine = _item;
+	m_scrubValue = 1.f;
+	m_hierarchyTextDirty = true;
+}
+
+void SHierarchicalStateMachineDebugger::_OnScrubValueChanged(float _value)
+{
+	m_scrubValue = _value;
+	m_hierarchyTextDirty = true;
+}
+
+void SHierarchicalStateMachineDebugger::_ResyncMachines()
+{
+	m_machines.Reset();
+	m_machinesById.Reset();
+	m_selectedMachine.Reset();
+	m_hierarchyTextDirty = true;
+
+	for (TObjectIterator<UHierarchicalStateMachine> it; it; ++it)
+	{
+		UHierarchicalStateMachine* stateMachine = *it;
+		if (stateMachine->HasAnyFlags(RF_ClassDefaultObject) || !stateMachine->IsStarted())
+			continue;
+
+		const FString label = stateMachine->GetOuter() ? FString::Printf(TEXT("%s:%s"), *stateMachine->GetOuter()->GetName(), *stateMachine->GetName()) : stateMachine->GetName();
+		_AddMachine(stateMachine->GetUniqueID(), FName(*label), stateMachine);
+	}
+
+	if (m_machinesListView.IsValid())
+	{
+		m_machinesListView->ClearSelection();
+		m_machinesListView->RequestListRefresh();
+	}
+}
+
+void SHierarchicalStateMachineDebugger::_AddMachine(uint32 _id, FName _label, const FHierarchicalStateMachine* _stateMachine)
+{
+	// Started again without its Stopped event being read in between, which only happens around a resync
+	if (MachineItem* existing = m_machinesById.Find(_id))
+	{
+		(*existing)->label = _label;
+		(*existing)->stateMachine = _stateMachine;
+		return;
+	}
+
+	MachineItem machine = MakeShared<Machine>();
+	machine->id = _id;
+	machine->label = _label;
+	machine->stateMachine = _stateMachine;
+	m_machines.Add(machine);
+	m_machinesById.Add(_id, machine);
+}
+
+void SHierarchicalStateMachineDebugger::_RemoveMachine(uint32 _id)
+{
+	MachineItem machine;
+	if (!m_machinesById.RemoveAndCopyValue(_id, machine))
+		return;
+
+	m_machines.Remove(machine);
+	if (m_selectedMachine == machine)
+	{
+		m_selectedMachine.Reset();
+		m_hierarchyTextDirty = true;
+	}
+}
+
+void SHierarchicalStateMachineDebugger::_ReadTrace()
+{
+	m_readEvents.Reset();
+	const int32 lostCount = FHierarchicalStateMachineTrace::Read(m_traceCursor, m_readEvents);
+	if (lostCount != 0)
+	{
+		// Stopped events may be among the lost ones, and the machines they stopped may have been destroyed since
+		m_lostEventsCount += lostCount;
+		_ResyncMachines();
+	}
+
+	bool listChanged = false;
+	for (const FHierarchicalStateMachineTraceEvent& event : m_readEvents)
+	{
+		switch (event.type)
+		{
+		case EHierarchicalStateMachineTraceType::Started:
+			_AddMachine(event.stateMachineId, event.name, event.stateMachine);
+			listChanged = true;
+			break;
+
+		case EHierarchicalStateMachineTraceType::Stopped:
+			_RemoveMachine(event.stateMachineId);
+			listChanged = true;
+			break;
+
+		case EHierarchicalStateMachineTraceType::StateEntered:
+		case EHierarchicalStateMachineTraceType::StateExited:
+			if (MachineItem* machine = m_machinesById.Find(event.stateMachineId))
+			{
+				(*machine)->AddTransition(event);
+				m_hierarchyTextDirty |= *machine == m_selectedMachine;
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (listChanged)
+	{
+		m_machinesListView->RequestListRefresh();
+	}
+}
+
+int32 SHierarchicalStateMachineDebugger::_GetScrubbedTransitionIndex() const
+{
+	if (!m_selectedMachine.IsValid())
+		return 0;
+
+	return FMath::RoundToInt(m_scrubValue * m_selectedMachine->transitions.Num());
+}
+
+void SHierarchicalStateMachineDebugger::_GetScrubbedStates(TSet<FName>& _outStates) const
+{
+	if (!m_selectedMachine.IsValid())
+		return;
+
+	for (const FHierarchicalStateMachine::State* state : m_selectedMachine->stateMachine->GetCurrentStates())
+	{
+		_outStates.Add(state->GetName());
+	}
+
+	for (int32 i = m_selectedMachine->transitions.Num() - 1; i >= _GetScrubbedTransitionIndex(); --i)
+	{
+		const FHierarchicalStateMachineTraceEvent& event = m_selectedMachine->GetTransition(i);
+		if (event.type == EHierarchicalStateMachineTraceType::StateEntered)
+		{
+			_outStates.Remove(event.name);
+		}
+		else
+		{
+			_outStates.Add(event.name);
+		}
+	}
+}
+
+void SHierarchicalStateMachineDebugger::_RebuildHierarchyText()
+{
+	if (!m_selectedMachine.IsValid())
+	{
+		m_hierarchyText = LOCTEXT("NoSelection", "Select a State Machine.");
+		return;
+	}
+
+	TSet<FName> activeStates;
+	_GetScrubbedStates(activeStates);
+
+	FString text;
+	TFunction<void(const FHierarchicalStateMachine::Track*, int32)> appendTrack = [&](const FHierarchicalStateMachine::Track* _track, int32 _depth)
+	{
+		text += FString::ChrN(_depth * 2, TEXT(' ')) + _track->GetName().ToString() + TEXT("\n");
+		for (auto& statePair : _track->GetStates())
+		{
+			const FHierarchicalStateMachine::State* state = statePair.Value;
+			bool active = activeStates.Contains(state->GetName());
+			text += FString::ChrN(_depth * 2 + 2, TEXT(' ')) + (active ? TEXT("[x] ") : TEXT("[ ] ")) + state->GetName().ToString() + TEXT("\n");
+
+			for (auto& trackPair : state->GetTracks())
+			{
+				appendTrack(trackPair.Value, _depth + 2);
+			}
+		}
+	};
+
+	for (const FHierarchicalStateMachine::Track* track : m_selectedMachine->stateMachine->GetRootTracks())
+	{
+		appendTrack(track, 0);
+	}
+	m_hierarchyText = FText::FromString(text);
+}
+
+FText SHierarchicalStateMachineDebugger::_GetScrubText() const
+{
+	if (!m_selectedMachine.IsValid() || m_selectedMachine->transitions.Num() == 0)
+		return LOCTEXT("NoTransitions", "No recorded transition.");
+
+	const int32 transitionsCount = m_selectedMachine->transitions.Num();
+	int32 index = _GetScrubbedTransitionIndex();
+	if (index >= transitionsCount)
+		return FText::Format(LOCTEXT("Live", "Live ({0} recorded transitions, {1} trace events lost)"), transitionsCount, m_lostEventsCount);
+
+	const FHierarchicalStateMachineTraceEvent& event = m_selectedMachine->GetTransition(index);
+	return FText::Format(LOCTEXT("Scrubbed", "Before transition {0}/{1} (frame {2}): {3} {4}"),
+		index + 1,
+		transitionsCount,
+		FText::AsNumber(event.frame),
+		event.type == EHierarchicalStateMachineTraceType::StateEntered ? LOCTEXT("Entered", "Enter") : LOCTEXT("Exited", "Exit"),
+		FText::FromName(event.name));
+}
+
+#undef LOCTEXT_NAMESPACE
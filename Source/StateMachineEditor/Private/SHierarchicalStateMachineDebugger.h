@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Widgets/SCompoundWidget.h"
+#include "Widgets/Views/SListView.h"
+
+#include <HierarchicalStateMachineTrace.h>
+
+// Lists the running state machines, shows the hierarchy of the selected one with its active states, and scrubs through its recent
+// transitions. Everything after the opening of the debugger is read from FHierarchicalStateMachineTrace, so the game thread only pays
+// for writing trace events while the debugger is open: Started and Stopped events maintain the list, state events the transitions.
+// UObject machines already running are listed once when the debugger opens, or when trace events were lost since they may have
+// been Stopped events; plain machines started before that only appear once they start again.
+class SHierarchicalStateMachineDebugger : public SCompoundWidget
+{
+public:
+	SLATE_BEGIN_ARGS(SHierarchicalStateMachineDebugger) {}
+	SLATE_END_ARGS()
+
+	void Construct(const FArguments& InArgs);
+	virtual ~SHierarchicalStateMachineDebugger();
+
+	virtual void Tick(const FGeometry& AllottedGeometry, const double InCurrentTime, const float InDeltaTime) override;
+
+private:
+	static constexpr int32 MaxTransitionsPerMachine = 1024;
+
+	struct Machine
+	{
+		uint32 id;
+		FName label;
+		const FHierarchicalStateMachine* stateMachine; // Valid until its Stopped trace event is read
+
+		// Ring buffer of the last MaxTransitionsPerMachine state events, oldest at transitionsHead once full
+		TArray<FHierarchicalStateMachineTraceEvent> transitions;
+		int32 transitionsHead = 0;
+
+		void AddTransition(const FHierarchicalStateMachineTraceEvent& _event);
+		FORCEINLINE const FHierarchicalStateMachineTraceEvent& GetTransition(int32 _index) const { return transitions[(transitionsHead + _index) % transitions.Num()]; }
+	};
+
+	typedef TSharedPtr<Machine> MachineItem;
+
+	TSharedRef<ITableRow> _OnGenerateMachineRow(MachineItem _item, const TSharedRef<STableViewBase>& _ownerTable);
+	void _OnMachineSelectionChanged(MachineItem _item, ESelectInfo::Type _selectInfo);
+
+	// Lists the UObject machines running right now, the only full walk of the objects
+	void _ResyncMachines();
+	void _AddMachine(uint32 _id, FName _label, const FHierarchicalStateMachine* _stateMachine);
+	void _RemoveMachine(uint32 _id);
+	void _ReadTrace();
+
+	// Active states of the selected machine at the scrubbed position, rebuilt by undoing the transitions that happened after it
+	void _GetScrubbedStates(TSet<FName>& _outStates) const;
+	int32 _GetScrubbedTransitionIndex() const;
+
+	void _RebuildHierarchyText();
+	FText _GetHierarchyText() const { return m_hierarchyText; }
+	FText _GetScrubText() const;
+	float _GetScrubValue() const { return m_scrubValue; }
+	void _OnScrubValueChanged(float _value);
+
+	TArray<MachineItem> m_machines;
+	TMap<uint32, MachineItem> m_machinesById;
+	TSharedPtr<SListView<MachineItem>> m_machinesListView;
+	MachineItem m_selectedMachine;
+
+	uint64 m_traceCursor = 0;
+	int32 m_lostEventsCount = 0;
+	TArray<FHierarchicalStateMachineTraceEvent> m_readEvents; // Reused across reads
+
+	// Rebuilt on Tick when the selection, the scrubbed position or the transitions of the selected machine changed, not on paint
+	FText m_hierarchyText;
+	bool m_hierarchyTextDirty = true;
+
+	float m_scrubValue = 1.f; // 1 is live
+};
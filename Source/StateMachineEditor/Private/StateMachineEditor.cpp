@@ -2,17 +2,44 @@
 
 #include "StateMachineEditor.h"
 
+#include <Framework/Application/SlateApplication.h>
+#include <Framework/Docking/TabManager.h>
+#include <WorkspaceMenuStructure.h>
+#include <WorkspaceMenuStructureModule.h>
+#include <Widgets/Docking/SDockTab.h>
+
+#include "SHierarchicalStateMachineDebugger.h"
+
 #define LOCTEXT_NAMESPACE "FStateMachineEditorModule"
 
+static const FName s_debuggerTabName(TEXT("HierarchicalStateMachineDebugger"));
+
 void FStateMachineEditorModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+	FGlobalTabmanager::Get()->RegisterNomadTabSpawner(s_debuggerTabName, FOnSpawnTab::CreateRaw(this, &FStateMachineEditorModule::_SpawnDebuggerTab))
+		.SetDisplayName(LOCTEXT("DebuggerTabTitle", "State Machine Debugger"))
+		.SetTooltipText(LOCTEXT("DebuggerTabTooltip", "Inspect running hierarchical state machines and scrub through their recent transitions."))
+		.SetGroup(WorkspaceMenu::GetMenuStructure().GetDeveloperToolsDebugCategory());
 }
 
 void FStateMachineEditorModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	if (FSlateApplication::IsInitialized())
+	{
+		FGlobalTabmanager::Get()->UnregisterNomadTabSpawner(s_debuggerTabName);
+	}
+}
+
+TSharedRef<SDockTab> FStateMachineEditorModule::_SpawnDebuggerTab(const FSpawnTabArgs& _args)
+{
+	return SNew(SDockTab)
+		.TabRole(ETabRole::NomadTab)
+		[
+			SNew(SHierarchicalStateMachineDebugger)
+		];
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -38,8 +38,11 @@ public class StateMachineEditor : ModuleRules
 			{
 				"CoreUObject",
 				"Engine",
+				"InputCore",
 				"Slate",
 				"SlateCore",
+				"WorkspaceMenuStructure",
+				"StateMachineCore",
 				"StateMachineRuntime"
 				// ... add private dependencies that you statically link with here ...
 			}
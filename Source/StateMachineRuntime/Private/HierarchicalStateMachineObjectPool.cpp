@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineObjectPool.h"
+#include "HierarchicalStateMachine.h"
+
+void UHierarchicalStateMachineObjectPool::Initialize(const UHierarchicalStateMachine* _prototype, const UObject* _prototypeOwner)
+{
+	STATEMACHINE_ASSERT(_prototype);
+	STATEMACHINE_ASSERT_MSG(!m_prototype.IsValid(), TEXT("State Machine pools can only be initialized once."));
+	m_prototype = MakeUnique<FHierarchicalStateMachinePrototype>(*_prototype, _prototypeOwner);
+}
+
+void UHierarchicalStateMachineObjectPool::Reserve(int32 _count)
+{
+	STATEMACHINE_ASSERT_MSG(m_prototype.IsValid(), TEXT("State Machine pools must be initialized with a prototype first."));
+	if (!m_prototype.IsValid())
+		return;
+
+	m_freeStateMachines.Reserve(_count);
+	while (m_freeStateMachines.Num() < _count)
+	{
+		UHierarchicalStateMachine* stateMachine = NewObject<UHierarchicalStateMachine>(this);
+		m_prototype->Instantiate(*stateMachine, nullptr);
+		m_freeStateMachines.Add(stateMachine);
+	}
+}
+
+UHierarchicalStateMachine* UHierarchicalStateMachineObjectPool::Acquire(UObject* _callbackObject)
+{
+	Reserve(1);
+	if (m_freeStateMachines.Num() == 0)
+		return nullptr;
+
+	UHierarchicalStateMachine* stateMachine = m_freeStateMachines.Pop(false);
+	m_prototype->RebindOwner(*stateMachine, _callbackObject);
+	stateMachine->RebindCallbackObject(_callbackObject);
+	return stateMachine;
+}
+
+void UHierarchicalStateMachineObjectPool::Acquire(TArrayView<UObject* const> _callbackObjects, TArray<UHierarchicalStateMachine*>& _outStateMachines)
+{
+	Reserve(_callbackObjects.Num());
+	STATEMACHINE_ASSERT_MSG(m_freeStateMachines.Num() >= _callbackObjects.Num(), TEXT("State Machine pools must be initialized with a prototype first."));
+	if (m_freeStateMachines.Num() < _callbackObjects.Num())
+		return;
+
+	_outStateMachines.Reserve(_outStateMachines.Num() + _callbackObjects.Num());
+	for (UObject* callbackObject : _callbackObjects)
+	{
+		UHierarchicalStateMachine* stateMachine = m_freeStateMachines.Pop(false);
+		m_prototype->RebindOwner(*stateMachine, callbackObject);
+		stateMachine->RebindCallbackObject(callbackObject);
+		_outStateMachines.Add(stateMachine);
+	}
+}
+
+void UHierarchicalStateMachineObjectPool::Release(UHierarchicalStateMachine* _stateMachine)
+{
+	STATEMACHINE_ASSERT(_stateMachine && _stateMachine->GetOuter() == this);
+	STATEMACHINE_ASSERT_MSG(!m_freeStateMachines.Contains(_stateMachine), TEXT("State Machine released twice."));
+	if (_stateMachine->IsStarted())
+	{
+		_stateMachine->Stop();
+	}
+	_stateMachine->UnregisterFromBroadcasters();
+	_stateMachine->ResetRuntimeState();
+	m_prototype->RebindOwner(*_stateMachine, nullptr);
+	_stateMachine->RebindCallbackObject(nullptr);
+	m_freeStateMachines.Add(_stateMachine);
+}
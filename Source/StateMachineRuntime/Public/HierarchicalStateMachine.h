@@ -3,271 +3,97 @@
 #pragma once
 
 class UCanvas;
+struct FStreamableHandle;
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "UObject/SoftObjectPath.h"
+#include "HierarchicalStateMachineCore.h"
 #include "HierarchicalStateMachine.generated.h"
 
-#define STATEMACHINE_ASSERT_ENABLED 1
-
-#if STATEMACHINE_ASSERT_ENABLED 
-
-	#define STATEMACHINE_ASSERT(cond) check(cond)
-	#define STATEMACHINE_ASSERT_MSG(cond, msg) checkf(cond, msg)
-	#define STATEMACHINE_ASSERT_MSGF(cond, fmt, ...) checkf(cond, fmt, __VA_ARGS__)
-#else
-	#define STATEMACHINE_ASSERT(cond)
-	#define STATEMACHINE_ASSERT_MSGF(cond, fmt, ...)
-	#define STATEMACHINE_ASSERT_MSG(cond, msg)
-#endif
-
-#ifdef UE_EDITOR
-	#define STATEMACHINE_HISTORY_ENABLED 1
-#else
-	#define STATEMACHINE_HISTORY_ENABLED 0
-#endif
-
+// UObject flavor of FHierarchicalStateMachine: adds garbage collection, weak tracking of the raw callbacks owner,
+// on screen debug display and memory reporting. All the state machine logic lives in FHierarchicalStateMachine.
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
-class STATEMACHINERUNTIME_API UHierarchicalStateMachine : public UObject
+class STATEMACHINERUNTIME_API UHierarchicalStateMachine : public UObject, public FHierarchicalStateMachine
 {
 	GENERATED_BODY()
 
 public:
-	DECLARE_DELEGATE(StateEnterDelegate);
-	DECLARE_DELEGATE_OneParam(StateTickDelegate, float);
-	DECLARE_DELEGATE(StateExitDelegate);
-
-	class Track;
-	class State;
-
-	friend class Track;
-	friend class State;
-
-	class STATEMACHINERUNTIME_API Track
+	// Same as the FHierarchicalStateMachine bindings, but the owner is tracked weakly so that raw callbacks stop being called once it is destroyed.
+	template<typename UserClass, void (UserClass::*Method)()>
+	void BindRawEnter(State* _state, UserClass* _owner)
 	{
-		friend class UHierarchicalStateMachine;
-		friend class State;
-	public:
-		State* AddState(FName _name);
-		State* AddState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit);
-		State* AddDefaultState(FName _name);
-		State* AddDefaultState(FName _name, const StateEnterDelegate& _enter, const StateTickDelegate& _tick, const StateExitDelegate& _exit);
-
-		FORCEINLINE State* GetParentState() const { return m_parent; }
-		FORCEINLINE const FName& GetName() const { return m_name; }
-
-	private:
-		Track(FName _name, State* _parent, UHierarchicalStateMachine* _stateMachine);
-		~Track();
-
-		void _AssignIndices(uint16& _index);
-
-		FName m_name;
-		TMap<FName, State*> m_states;
-		State* m_parent = nullptr;
-		State* m_defaultState = nullptr;
-		UHierarchicalStateMachine* m_stateMachine = nullptr;
-	};
+		_SetCallbackObject(_owner);
+		FHierarchicalStateMachine::BindRawEnter<UserClass, Method>(_state, _owner);
+	}
 
-	class STATEMACHINERUNTIME_API State
+	template<typename UserClass, void (UserClass::*Method)(float)>
+	void BindRawTick(State* _state, UserClass* _owner)
 	{
-		friend class UHierarchicalStateMachine;
-		friend class State;
-	public:
-		StateEnterDelegate Enter;
-		StateTickDelegate Tick;
-		StateExitDelegate Exit;
-
-		Track* AddTrack(FName _name);
-
-		bool IsInTrack(const Track* _track) const;
-		bool IsInState(const State* _state) const;
-
-		FORCEINLINE Track* GetParentTrack() const { return m_parent; }
-		FORCEINLINE const FName& GetName() const { return m_name; }
-		FORCEINLINE uint16 GetIndex() const { return m_index; }
-
-	private:
-		State(FName _name, Track* _parent, UHierarchicalStateMachine* _stateMachine);
-		~State();
-
-		FName m_name;
-		TMap<FName, Track*> m_tracks;
-		Track* m_parent;
-		UHierarchicalStateMachine* m_stateMachine;
-		uint16 m_index = 0;
-	};
-
-public:	
-	UHierarchicalStateMachine();
-	~UHierarchicalStateMachine();
-
-	Track* AddRootTrack(FName _name);
-	Track* AddRootTrack(Track* _track);
-
-	void AddEventTransition(FName _eventName, FName _sourceName, FName _targetStateName);
+		_SetCallbackObject(_owner);
+		FHierarchicalStateMachine::BindRawTick<UserClass, Method>(_state, _owner);
+	}
 
-	void Start();
-	void Tick(float _dt);
-	void Stop();
-	void DequeueEvents(uint16 _dequeuedEventsLimit = -1);
+	template<typename UserClass, void (UserClass::*Method)()>
+	void BindRawExit(State* _state, UserClass* _owner)
+	{
+		_SetCallbackObject(_owner);
+		FHierarchicalStateMachine::BindRawExit<UserClass, Method>(_state, _owner);
+	}
 
-	void PostEvent(FName _eventName);
+	void BindBatchTick(State* _state, UObject* _owner, StateBatchTickFunction _function);
 
-	FORCEINLINE const TArray<State*>& GetCurrentStates() const { return m_currentStates; }
-	FORCEINLINE const TArray<Track*>& GetRootTracks() const { return m_rootTracks; }
+	// Binds every raw callback to another object at once, tracked weakly like the bindings above. The machine must be stopped.
+	void RebindCallbackObject(UObject* _owner);
 
-	FORCEINLINE bool IsStarted() const { return m_started; }
+	static void TickBatched(TArrayView<UHierarchicalStateMachine*> _stateMachines, float _dt);
 
 	void DebugDisplayCurrentStates(const FColor& _color);
 	void DebugDisplayCurrentStates(UCanvas* _canvas, const FColor& _color);
 
-	void SerializeCurrentStates(TArray<FString>& _outStates);
-	void DeserializeCurrentStates(const TArray<FString>& _states);
+	// Draws the current states of each machine at the location of the actor owning it. Machines without an owning actor, behind the view,
+	// off screen or further than _maxDistance from the view origin are skipped before any text is measured or drawn.
+	static void DebugDrawCurrentStates(UCanvas* _canvas, TArrayView<UHierarchicalStateMachine*> _stateMachines, const FColor& _color, float _maxDistance = 5000.f);
 
-	bool bImmediatelyDequeueEvents : 1;
+	// Soft asset used by a state once entered. With PrefetchTransitionsCount above 0, the assets of the current states and of the states
+	// reachable within that many transitions are requested at PrefetchPriority whenever the configuration changes, and released once out of reach.
+	void AddStateAssetDependency(State* _state, const FSoftObjectPath& _asset);
 
-#if STATEMACHINE_HISTORY_ENABLED
-	bool bPrintHistoryInLog : 1;
-#endif
+	int32 PrefetchTransitionsCount = 0;
 
-private:
-	DECLARE_DELEGATE_RetVal_OneParam(bool, TrackVisitorDelegate, Track*);
-	DECLARE_DELEGATE_RetVal_OneParam(bool, StateVisitorDelegate, State*);
-	bool _VisitTrack(Track* _track, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor);
-	bool _VisitState(State* _track, TrackVisitorDelegate _trackVisitor, StateVisitorDelegate _stateVisitor);
-
-	bool _AssertIfTrackExists(Track* _track);
-	bool _AssertIfStateExists(State* _track);
+	// Below FStreamableManager::DefaultAsyncLoadPriority, so that prefetches never delay what gameplay loads at the default priority
+	TAsyncLoadPriority PrefetchPriority = -100;
 
-	void _AssignIndices();
-	Track* _FindClosestCommonTrack(const Track* _trackA, const State* _stateB);
-	Track* _FindClosestCommonTrack(const State* _stateA, const State* _stateB);
-	bool _AreStatesConcurrent(const State* _stateA, const State* _stateB) const;
+	// True from the configuration change that brought the asset within reach to the one that took it out
+	FORCEINLINE bool IsAssetPrefetched(const FSoftObjectPath& _asset) const { return m_prefetchHandles.Contains(_asset); }
 
-	FString _StringifyCurrentStates() const;
+	// UObject interface
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
 
-	struct EventTransition
-	{
-		FName name;
-		Track* sourceTrack = nullptr;
-		State* sourceState = nullptr;
-		State* targetState = nullptr;
-	};
+protected:
+	// FHierarchicalStateMachine interface
+	virtual void _ValidateCallbackOwner() override;
+	virtual FString _GetDebugName() const override;
+	virtual uint32 _GetTraceId() const override;
+	virtual void _OnConfigurationChanged() override;
+	virtual bool _CanRemoveState(const State* _state) const override;
 
-	TArray<Track*> m_rootTracks;
-	TMap<FName, Track*> m_tracks;
-	TMap<FName, State*> m_states;
+	// Starts the async load of an asset coming within reach, through the asset manager streamable manager by default
+	virtual TSharedPtr<FStreamableHandle> _RequestPrefetch(const FSoftObjectPath& _asset, TAsyncLoadPriority _priority);
 
-	TArray<State*> m_currentStates; // Order in this array matters
-
-	TMap<FName, TArray<EventTransition*>> m_eventTransitions;
-	TArray<FName> m_eventsQueue;
-	
-	bool m_ticking = false;
-	bool m_started = false;
-	bool m_isDequeuingEvents = false;
-	
-#if STATEMACHINE_HISTORY_ENABLED 
-	enum HistoryEntryType
-	{
-		HistoryEntryType_StateMachineStarted,
-		HistoryEntryType_StateMachineStopped,
-		HistoryEntryType_StateEntered,
-		HistoryEntryType_StateExited,
-		HistoryEntryType_EventPushed,
-		HistoryEntryType_EventPopped,
-	};
+private:
+	void _SetCallbackObject(UObject* _owner);
 
-	struct HistoryEntry
-	{
-		HistoryEntry() : eventName(TEXT("")) {}
+	TWeakObjectPtr<UObject> m_callbackObject;
 
-		HistoryEntryType type;
-		FDateTime time;
-		union 
-		{
-			State* state;
-			FName eventName;
-		};
-	};
-	TArray<HistoryEntry> m_history;
+	TMap<const State*, TArray<FSoftObjectPath>> m_stateAssets;
+	TMap<FSoftObjectPath, TSharedPtr<FStreamableHandle>> m_prefetchHandles;
 
-	void _LogStateMachineStarted();
-	void _LogStateMachineStopped();
-	void _LogStateEntered(State* _state);
-	void _LogStateExited(State* _state);
-	void _LogEventPushed(FName _name);
-	void _LogEventPopped(FName _name);
-#endif
+	// Reused across configuration changes
+	TArray<State*> m_prefetchStates;
+	TSet<FSoftObjectPath> m_prefetchNeededAssets;
 };
 
-
-// ==================
-// DEFINITION HELPERS
-// ==================
-
-#define STATEMACHINE_DEFINITION(HierarchicalStateMachinePointer)\
-	{\
-	UHierarchicalStateMachine* __hierarchicalStateMachine = HierarchicalStateMachinePointer;\
-	TArray<UHierarchicalStateMachine::Track*> __trackStack;\
-	TArray<UHierarchicalStateMachine::State*> __stateStack;\
-	UHierarchicalStateMachine::Track* __track;\
-	UHierarchicalStateMachine::State* __state;\
-	_STATEMACHINE_DEFINITION_CONTENT
-
-
-#define _STATEMACHINE_DEFINITION_CONTENT(...)\
-	__VA_ARGS__\
-	}
-
-
-#define DEFAULT_STATE(StateName)\
-	{\
-		__state = __trackStack.Top()->AddDefaultState(TEXT(#StateName)); \
-		__stateStack.Push(__state);\
-	}\
-	_STATE_CONTENT
-
-
-#define STATE(StateName)\
-	{\
-		__state = __trackStack.Top()->AddState(TEXT(#StateName)); \
-		__stateStack.Push(__state);\
-	}\
-	_STATE_CONTENT
-
-#define STATE_ENTER(objectPtr, methodPtr) __state->Enter.BindUObject(objectPtr, methodPtr)
-
-#define STATE_TICK(objectPtr, methodPtr) __state->Tick.BindUObject(objectPtr, methodPtr)
-
-#define STATE_EXIT(objectPtr, methodPtr) __state->Exit.BindUObject(objectPtr, methodPtr)
-
-
-
-#define _STATE_CONTENT(...)\
-	__VA_ARGS__\
-	__stateStack.Pop()
-
-
-#define TRACK(TrackName)\
-	if (__stateStack.Num() == 0)\
-	{\
-		__track = __hierarchicalStateMachine->AddRootTrack(TEXT(#TrackName));\
-	}\
-	else\
-	{\
-		__track = __stateStack.Top()->AddTrack(TEXT(#TrackName));\
-	}\
-	__trackStack.Push(__track);\
-	_TRACK_CONTENT
-
-
-#define _TRACK_CONTENT(...)\
-	__VA_ARGS__\
-	__trackStack.Pop()
-
-
-// NOTE: so far, I think event should be passed as string literals, since it will passed that way on the non-macro API
-#define TRANSITION_EVENT(eventName, sourceState, targetState)\
-	__hierarchicalStateMachine->AddEventTransition(eventName, #sourceState, #targetState)
+// Declares a soft asset dependency of the current state, see UHierarchicalStateMachine::AddStateAssetDependency
+#define STATE_ASSET(assetPath) \
+	__hierarchicalStateMachine->AddStateAssetDependency(__state, FSoftObjectPath(assetPath))
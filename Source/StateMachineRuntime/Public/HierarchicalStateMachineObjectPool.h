@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "HierarchicalStateMachinePool.h"
+#include "HierarchicalStateMachineObjectPool.generated.h"
+
+class UHierarchicalStateMachine;
+
+// FHierarchicalStateMachinePool for UHierarchicalStateMachine: machines are created with the pool as outer and recycled instead of
+// being garbage collected, so that spawn waves do not pay for NewObject, building definitions and binding callbacks.
+// Callbacks bound to the prototype owner are rebound to the object each machine is acquired for, see FHierarchicalStateMachinePrototype.
+UCLASS()
+class STATEMACHINERUNTIME_API UHierarchicalStateMachineObjectPool : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Captures the prototype, which may then be discarded. Called once per pool. _prototypeOwner defaults to the owner of its raw bindings.
+	void Initialize(const UHierarchicalStateMachine* _prototype, const UObject* _prototypeOwner = nullptr);
+
+	void Reserve(int32 _count);
+
+	UHierarchicalStateMachine* Acquire(UObject* _callbackObject);
+	void Acquire(TArrayView<UObject* const> _callbackObjects, TArray<UHierarchicalStateMachine*>& _outStateMachines);
+
+	// Stops the machine if needed, unregisters it from its broadcasters and makes it available again.
+	// It must have been acquired from this pool and not released since.
+	void Release(UHierarchicalStateMachine* _stateMachine);
+
+	FORCEINLINE int32 GetFreeCount() const { return m_freeStateMachines.Num(); }
+
+private:
+	TUniquePtr<FHierarchicalStateMachinePrototype> m_prototype;
+
+	UPROPERTY()
+	TArray<UHierarchicalStateMachine*> m_freeStateMachines;
+};
@@ -28,6 +28,7 @@ public class StateMachineRuntime : ModuleRules
 			new string[]
 			{
 				"Core",
+				"StateMachineCore",
 				// ... add other public dependencies that you statically link with here ...
 			}
 			);
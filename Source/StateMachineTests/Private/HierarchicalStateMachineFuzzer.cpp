@@ -0,0 +1,1061 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "HierarchicalStateMachineFuzzer.h"
+
+#include <HAL/IConsoleManager.h>
+#include <HAL/PlatformTime.h>
+#include <Math/RandomStream.h>
+#include <Misc/OutputDevice.h>
+
+#include <HierarchicalStateMachineCore.h>
+
+// Bounds the events posted by callbacks between two operations, so that generated cycles always end
+#define STATEMACHINEFUZZER_MAXPOSTSPEROPERATION 16
+
+// ==========
+// REFERENCE
+// ==========
+
+// Straight port of the original FHierarchicalStateMachine algorithm: route search and concurrency test for every dequeued transition,
+// linear searches, no event index, no rejection. It is the behavior the optimized implementation must reproduce, so do not optimize it.
+// The only change is the null check in _FindClosestCommonTrack, which the original lacked for root track sourced transitions.
+class FReferenceStateMachine
+{
+public:
+	DECLARE_DELEGATE(StateEnterDelegate);
+	DECLARE_DELEGATE_OneParam(StateTickDelegate, float);
+	DECLARE_DELEGATE(StateExitDelegate);
+
+	struct State;
+
+	struct Track
+	{
+		FName name;
+		State* parent = nullptr;
+		TArray<State*> states;
+		State* defaultState = nullptr;
+	};
+
+	struct State
+	{
+		FName name;
+		Track* parent = nullptr;
+		TArray<Track*> tracks;
+		uint16 index = 0;
+
+		StateEnterDelegate Enter;
+		StateTickDelegate Tick;
+		StateExitDelegate Exit;
+	};
+
+	Track* AddRootTrack(FName _name)
+	{
+		Track* track = _NewTrack(_name, nullptr);
+		m_rootTracks.Add(track);
+		return track;
+	}
+
+	Track* AddTrack(State* _parent, FName _name)
+	{
+		Track* track = _NewTrack(_name, _parent);
+		_parent->tracks.Add(track);
+		return track;
+	}
+
+	State* AddState(Track* _parent, FName _name, bool _isDefault)
+	{
+		State* state = new State();
+		state->name = _name;
+		state->parent = _parent;
+		m_states.Add(TUniquePtr<State>(state));
+		_parent->states.Add(state);
+		if (_isDefault)
+		{
+			_parent->defaultState = state;
+		}
+		return state;
+	}
+
+	void AddEventTransition(FName _eventName, FName _sourceName, FName _targetStateName)
+	{
+		EventTransition transition;
+		transition.sourceTrack = _FindTrack(_sourceName);
+		transition.sourceState = transition.sourceTrack ? nullptr : _FindState(_sourceName);
+		transition.targetState = _FindState(_targetStateName);
+		check((transition.sourceTrack || transition.sourceState) && transition.targetState);
+
+		m_eventTransitions.FindOrAdd(_eventName).Add(transition);
+	}
+
+	void Start()
+	{
+		check(!m_started && m_currentStates.Num() == 0);
+
+		_AssignIndices();
+
+		TArray<Track*> waitingTracks = m_rootTracks;
+		while (waitingTracks.Num() != 0)
+		{
+			Track* track = waitingTracks[0];
+			waitingTracks.RemoveAt(0);
+
+			bool inserted = false;
+			for (int i = 0; i < m_currentStates.Num(); ++i)
+			{
+				if (track->defaultState->index < m_currentStates[i]->index)
+				{
+					m_currentStates.Insert(track->defaultState, i);
+					inserted = true;
+					break;
+				}
+			}
+			if (!inserted)
+			{
+				m_currentStates.Add(track->defaultState);
+			}
+
+			for (Track* childTrack : track->defaultState->tracks)
+			{
+				waitingTracks.Insert(childTrack, 0);
+			}
+		}
+
+		for (State* state : m_currentStates)
+		{
+			state->Enter.ExecuteIfBound();
+		}
+
+		m_started = true;
+
+		DequeueEvents();
+	}
+
+	void Tick(float _dt)
+	{
+		check(m_started && !m_ticking);
+
+		DequeueEvents();
+
+		m_ticking = true;
+		for (State* state : m_currentStates)
+		{
+			state->Tick.ExecuteIfBound(_dt);
+		}
+		m_ticking = false;
+
+		DequeueEvents();
+	}
+
+	void Stop()
+	{
+		check(m_started);
+		m_started = false;
+		if (!m_ticking)
+		{
+			for (int i = m_currentStates.Num() - 1; i >= 0; --i)
+			{
+				m_currentStates[i]->Exit.ExecuteIfBound();
+			}
+			m_currentStates.Empty();
+		}
+	}
+
+	void PostEvent(FName _eventName)
+	{
+		check(m_eventTransitions.Find(_eventName) != nullptr);
+
+		m_eventsQueue.Add(_eventName);
+		if (bImmediatelyDequeueEvents && !m_ticking && m_started && !m_isDequeuingEvents)
+		{
+			DequeueEvents();
+		}
+	}
+
+	void DequeueEvents()
+	{
+		m_isDequeuingEvents = true;
+
+		uint16 dequeuedEventsLimit = uint16(-1); // The original default limit
+		TArray<State*> exitingStates;
+		TArray<State*> enteringStates;
+
+		uint16 dequeuedEventsCount = 0;
+		while ((dequeuedEventsCount < dequeuedEventsLimit) && m_eventsQueue.Num() != 0)
+		{
+			exitingStates.Empty();
+			enteringStates.Empty();
+
+			++dequeuedEventsCount;
+			FName evt = m_eventsQueue[0];
+			m_eventsQueue.RemoveAt(0);
+
+			const TArray<EventTransition>& transitions = *m_eventTransitions.Find(evt);
+			for (const EventTransition& transition : transitions)
+			{
+				if (transition.sourceState && m_currentStates.Find(transition.sourceState) == INDEX_NONE)
+					continue;
+
+				Track* commonTrack = nullptr;
+				if (transition.sourceTrack)
+				{
+					commonTrack = _FindClosestCommonTrack(transition.sourceTrack, transition.targetState);
+				}
+				else
+				{
+					commonTrack = _FindClosestCommonTrack(transition.sourceState, transition.targetState);
+				}
+				if (!commonTrack)
+					continue;
+
+				for (State* state : m_currentStates)
+				{
+					if (!_IsInTrack(state, commonTrack))
+						continue;
+
+					if (!_AreStatesConcurrent(state, transition.targetState))
+						continue;
+
+					exitingStates.Add(state);
+				}
+
+				if (exitingStates.Num() == 0)
+					continue;
+
+				enteringStates.Add(transition.targetState);
+				{
+					State* ascendingState = transition.targetState;
+					while (ascendingState->parent && ascendingState->parent->parent && m_currentStates.Find(ascendingState->parent->parent) == INDEX_NONE)
+					{
+						ascendingState = ascendingState->parent->parent;
+						enteringStates.Add(ascendingState);
+					}
+				}
+
+				for (int i = 0; i < enteringStates.Num(); ++i)
+				{
+					for (Track* track : enteringStates[i]->tracks)
+					{
+						bool relevant = true;
+						for (int j = 0; j < enteringStates.Num(); ++j)
+						{
+							if (track == enteringStates[j]->parent)
+							{
+								relevant = false;
+								break;
+							}
+						}
+
+						if (relevant)
+							enteringStates.Add(track->defaultState);
+					}
+				}
+			}
+
+			auto removeDuplicates = [](TArray<State*>& _array)
+			{
+				for (int i = 0; i < _array.Num(); ++i)
+				{
+					for (int j = i + 1; j < _array.Num(); ++j)
+					{
+						if (_array[i] == _array[j])
+						{
+							_array.RemoveAt(j);
+						}
+					}
+				}
+			};
+
+			removeDuplicates(exitingStates);
+			removeDuplicates(enteringStates);
+
+			exitingStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.index > _stateB.index; });
+			enteringStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.index < _stateB.index; });
+
+			for (State* state : exitingStates)
+			{
+				state->Exit.ExecuteIfBound();
+				m_currentStates.Remove(state);
+			}
+
+			for (State* state : enteringStates)
+			{
+				state->Enter.ExecuteIfBound();
+				m_currentStates.Add(state);
+			}
+
+			m_currentStates.Sort([](const State& _stateA, const State& _stateB) { return _stateA.index < _stateB.index; });
+		}
+
+		m_isDequeuingEvents = false;
+	}
+
+	bool bImmediatelyDequeueEvents = true;
+
+private:
+	struct EventTransition
+	{
+		Track* sourceTrack = nullptr;
+		State* sourceState = nullptr;
+		State* targetState = nullptr;
+	};
+
+	Track* _NewTrack(FName _name, State* _parent)
+	{
+		Track* track = new Track();
+		track->name = _name;
+		track->parent = _parent;
+		m_tracks.Add(TUniquePtr<Track>(track));
+		return track;
+	}
+
+	Track* _FindTrack(FName _name) const
+	{
+		for (const TUniquePtr<Track>& track : m_tracks)
+		{
+			if (track->name == _name)
+				return track.Get();
+		}
+		return nullptr;
+	}
+
+	State* _FindState(FName _name) const
+	{
+		for (const TUniquePtr<State>& state : m_states)
+		{
+			if (state->name == _name)
+				return state.Get();
+		}
+		return nullptr;
+	}
+
+	// Tracks are visited in creation order and nested tracks are visited again, so the last visit wins
+	void _AssignIndices()
+	{
+		uint16 index = 0;
+		for (const TUniquePtr<Track>& track : m_tracks)
+		{
+			_AssignIndices(track.Get(), index);
+		}
+	}
+
+	void _AssignIndices(Track* _track, uint16& _index)
+	{
+		for (State* state : _track->states)
+		{
+			state->index = _index;
+			++_index;
+
+			for (Track* childTrack : state->tracks)
+			{
+				_AssignIndices(childTrack, _index);
+			}
+		}
+	}
+
+	static bool _IsInTrack(const State* _state, const Track* _track)
+	{
+		Track* currentTrack = _state->parent;
+		while (currentTrack != nullptr)
+		{
+			if (currentTrack == _track)
+				return true;
+
+			currentTrack = currentTrack->parent ? currentTrack->parent->parent : nullptr;
+		}
+		return false;
+	}
+
+	static Track* _FindClosestCommonTrack(const State* _stateA, const State* _stateB)
+	{
+		if (!_stateA || !_stateB)
+			return nullptr;
+
+		if (_stateA->parent == _stateB->parent)
+			return _stateA->parent;
+
+		TArray<Track*> ATracks;
+		for (Track* track : _stateA->tracks)
+		{
+			ATracks.Add(track);
+		}
+		Track* currentTrack = _stateA->parent;
+		while (currentTrack != nullptr)
+		{
+			ATracks.Add(currentTrack);
+			currentTrack = currentTrack->parent ? currentTrack->parent->parent : nullptr;
+		}
+
+		for (Track* track : _stateB->tracks)
+		{
+			int32 i = ATracks.Find(track);
+			if (i != INDEX_NONE)
+			{
+				return ATracks[i];
+			}
+		}
+		currentTrack = _stateB->parent;
+		while (currentTrack != nullptr)
+		{
+			int32 i = ATracks.Find(currentTrack);
+			if (i != INDEX_NONE)
+			{
+				return ATracks[i];
+			}
+			currentTrack = currentTrack->parent ? currentTrack->parent->parent : nullptr;
+		}
+
+		return nullptr;
+	}
+
+	static Track* _FindClosestCommonTrack(const Track* _trackA, const State* _stateB)
+	{
+		const State* s = _stateB;
+		while (s && s->parent)
+		{
+			if (s->parent == _trackA)
+			{
+				return const_cast<Track*>(_trackA);
+			}
+			s = s->parent->parent;
+		}
+
+		return _FindClosestCommonTrack(_trackA->parent, _stateB);
+	}
+
+	static bool _AreStatesConcurrent(const State* _stateA, const State* _stateB)
+	{
+		if (_stateA == _stateB)
+			return true;
+
+		if (_stateA->parent == _stateB->parent)
+			return true;
+
+		TArray<const Track*> ATracks;
+		TArray<const State*> AStates;
+		{
+			const State* s = _stateA;
+			while (s)
+			{
+				AStates.Add(s);
+				ATracks.Add(s->parent);
+				s = s->parent->parent;
+			}
+		}
+
+		{
+			const State* s = _stateB;
+			while (s)
+			{
+				for (int32 i = 0; i < ATracks.Num(); ++i)
+				{
+					if (AStates[i] == s) return false;
+					if (ATracks[i] == s->parent) return true;
+				}
+				s = s->parent->parent;
+			}
+		}
+
+		return false;
+	}
+
+	TArray<TUniquePtr<Track>> m_tracks; // Creation order
+	TArray<TUniquePtr<State>> m_states;
+	TArray<Track*> m_rootTracks;
+	TMap<FName, TArray<EventTransition>> m_eventTransitions;
+
+	TArray<State*> m_currentStates;
+	TArray<FName> m_eventsQueue;
+
+	bool m_ticking = false;
+	bool m_started = false;
+	bool m_isDequeuingEvents = false;
+};
+
+// ==========
+// EXECUTION
+// ==========
+
+enum TraceEntryType
+{
+	TraceEntryType_Enter,
+	TraceEntryType_Tick,
+	TraceEntryType_Exit,
+	TraceEntryType_Operation,
+	TraceEntryType_Count,
+};
+
+struct FFuzzerRun
+{
+	const FHierarchicalStateMachineFuzzer::Case* testCase = nullptr;
+	TArray<FName> nodeNames;
+	TArray<FName> eventNames;
+	TArray<int32> trace; // value * TraceEntryType_Count + type
+	int32 postsBudget = 0;
+};
+
+static void InitializeRun(FFuzzerRun& _run, const FHierarchicalStateMachineFuzzer::Case& _case)
+{
+	_run.testCase = &_case;
+	for (int32 i = 0; i < _case.nodes.Num(); ++i)
+	{
+		_run.nodeNames.Add(FName(*FString::Printf(_case.nodes[i].isTrack ? TEXT("T%d") : TEXT("S%d"), i)));
+	}
+	for (int32 i = 0; i < _case.eventsCount; ++i)
+	{
+		_run.eventNames.Add(FName(*FString::Printf(TEXT("E%d"), i)));
+	}
+}
+
+template<typename StateMachineType>
+static void RecordCallback(StateMachineType* _stateMachine, FFuzzerRun* _run, int32 _node, TraceEntryType _type, int32 _postedEvent)
+{
+	_run->trace.Add(_node * TraceEntryType_Count + _type);
+
+	if (_postedEvent != INDEX_NONE && _run->postsBudget > 0)
+	{
+		--_run->postsBudget;
+		_stateMachine->PostEvent(_run->eventNames[_postedEvent]);
+	}
+}
+
+template<typename StateMachineType, typename StateType>
+static void BindCallbacks(StateMachineType* _stateMachine, StateType* _state, FFuzzerRun* _run, int32 _node)
+{
+	const FHierarchicalStateMachineFuzzer::Node& node = _run->testCase->nodes[_node];
+	int32 enterEvent = node.enterEvent;
+	int32 tickEvent = node.tickEvent;
+	int32 exitEvent = node.exitEvent;
+
+	_state->Enter.BindLambda([=]() { RecordCallback(_stateMachine, _run, _node, TraceEntryType_Enter, enterEvent); });
+	_state->Tick.BindLambda([=](float) { RecordCallback(_stateMachine, _run, _node, TraceEntryType_Tick, tickEvent); });
+	_state->Exit.BindLambda([=]() { RecordCallback(_stateMachine, _run, _node, TraceEntryType_Exit, exitEvent); });
+}
+
+static void DefineStateMachine(FHierarchicalStateMachine* _stateMachine, FFuzzerRun* _run)
+{
+	const FHierarchicalStateMachineFuzzer::Case& testCase = *_run->testCase;
+
+	TArray<FHierarchicalStateMachine::Track*> tracks;
+	TArray<FHierarchicalStateMachine::State*> states;
+	tracks.SetNumZeroed(testCase.nodes.Num());
+	states.SetNumZeroed(testCase.nodes.Num());
+
+	for (int32 i = 0; i < testCase.nodes.Num(); ++i)
+	{
+		const FHierarchicalStateMachineFuzzer::Node& node = testCase.nodes[i];
+		if (node.isTrack)
+		{
+			tracks[i] = node.parent == INDEX_NONE ? _stateMachine->AddRootTrack(_run->nodeNames[i]) : states[node.parent]->AddTrack(_run->nodeNames[i]);
+		}
+		else
+		{
+			states[i] = node.isDefault ? tracks[node.parent]->AddDefaultState(_run->nodeNames[i]) : tracks[node.parent]->AddState(_run->nodeNames[i]);
+			BindCallbacks(_stateMachine, states[i], _run, i);
+		}
+	}
+
+	for (const FHierarchicalStateMachineFuzzer::Transition& transition : testCase.transitions)
+	{
+		_stateMachine->AddEventTransition(_run->eventNames[transition.event], _run->nodeNames[transition.source], _run->nodeNames[transition.target]);
+	}
+
+	_stateMachine->bRejectUnhandledEvents = testCase.rejectUnhandledEvents;
+}
+
+static void DefineStateMachine(FReferenceStateMachine* _stateMachine, FFuzzerRun* _run)
+{
+	const FHierarchicalStateMachineFuzzer::Case& testCase = *_run->testCase;
+
+	TArray<FReferenceStateMachine::Track*> tracks;
+	TArray<FReferenceStateMachine::State*> states;
+	tracks.SetNumZeroed(testCase.nodes.Num());
+	states.SetNumZeroed(testCase.nodes.Num());
+
+	for (int32 i = 0; i < testCase.nodes.Num(); ++i)
+	{
+		const FHierarchicalStateMachineFuzzer::Node& node = testCase.nodes[i];
+		if (node.isTrack)
+		{
+			tracks[i] = node.parent == INDEX_NONE ? _stateMachine->AddRootTrack(_run->nodeNames[i]) : _stateMachine->AddTrack(states[node.parent], _run->nodeNames[i]);
+		}
+		else
+		{
+			states[i] = _stateMachine->AddState(tracks[node.parent], _run->nodeNames[i], node.isDefault);
+			BindCallbacks(_stateMachine, states[i], _run, i);
+		}
+	}
+
+	for (const FHierarchicalStateMachineFuzzer::Transition& transition : testCase.transitions)
+	{
+		_stateMachine->AddEventTransition(_run->eventNames[transition.event], _run->nodeNames[transition.source], _run->nodeNames[transition.target]);
+	}
+}
+
+template<typename StateMachineType>
+static void Execute(FFuzzerRun& _run)
+{
+	const FHierarchicalStateMachineFuzzer::Case& testCase = *_run.testCase;
+
+	StateMachineType stateMachine;
+	DefineStateMachine(&stateMachine, &_run);
+	stateMachine.bImmediatelyDequeueEvents = testCase.immediatelyDequeueEvents;
+
+	_run.postsBudget = STATEMACHINEFUZZER_MAXPOSTSPEROPERATION;
+	stateMachine.Start();
+
+	for (int32 i = 0; i < testCase.operations.Num(); ++i)
+	{
+		const FHierarchicalStateMachineFuzzer::Operation& operation = testCase.operations[i];
+		_run.trace.Add(i * TraceEntryType_Count + TraceEntryType_Operation);
+		_run.postsBudget = STATEMACHINEFUZZER_MAXPOSTSPEROPERATION;
+
+		switch (operation.type)
+		{
+		case FHierarchicalStateMachineFuzzer::OperationType_PostEvent:
+			stateMachine.PostEvent(_run.eventNames[operation.event]);
+			break;
+
+		case FHierarchicalStateMachineFuzzer::OperationType_Tick:
+			stateMachine.Tick(0.1f);
+			break;
+
+		case FHierarchicalStateMachineFuzzer::OperationType_Restart:
+			stateMachine.Stop();
+			stateMachine.Start();
+			break;
+		}
+	}
+
+	_run.trace.Add(testCase.operations.Num() * TraceEntryType_Count + TraceEntryType_Operation);
+	_run.postsBudget = 0;
+	stateMachine.Stop();
+}
+
+static FString DescribeTraceEntry(const FFuzzerRun& _run, int32 _index)
+{
+	if (!_run.trace.IsValidIndex(_index))
+		return TEXT("<end>");
+
+	int32 value = _run.trace[_index] / TraceEntryType_Count;
+	switch (_run.trace[_index] % TraceEntryType_Count)
+	{
+	case TraceEntryType_Enter: return FString::Printf(TEXT("%s_Enter"), *_run.nodeNames[value].ToString());
+	case TraceEntryType_Tick: return FString::Printf(TEXT("%s_Tick"), *_run.nodeNames[value].ToString());
+	case TraceEntryType_Exit: return FString::Printf(TEXT("%s_Exit"), *_run.nodeNames[value].ToString());
+	default: return FString::Printf(TEXT("<operation %d>"), value);
+	}
+}
+
+// ==========
+// CASES
+// ==========
+
+// Drops everything that refers to events left without transitions, since posting an unknown event asserts.
+static void NormalizeCase(FHierarchicalStateMachineFuzzer::Case& _case)
+{
+	TBitArray<> handledEvents(false, _case.eventsCount);
+	for (const FHierarchicalStateMachineFuzzer::Transition& transition : _case.transitions)
+	{
+		handledEvents[transition.event] = true;
+	}
+
+	auto clearUnhandled = [&handledEvents](int32& _event)
+	{
+		if (_event != INDEX_NONE && !handledEvents[_event])
+		{
+			_event = INDEX_NONE;
+		}
+	};
+
+	for (FHierarchicalStateMachineFuzzer::Node& node : _case.nodes)
+	{
+		clearUnhandled(node.enterEvent);
+		clearUnhandled(node.tickEvent);
+		clearUnhandled(node.exitEvent);
+	}
+
+	_case.operations.RemoveAll([&handledEvents](const FHierarchicalStateMachineFuzzer::Operation& _operation)
+	{
+		return _operation.type == FHierarchicalStateMachineFuzzer::OperationType_PostEvent && !handledEvents[_operation.event];
+	});
+}
+
+// Removes a node and its subtree. Fails if a track would be left without states or the machine without root track.
+static bool RemoveNode(FHierarchicalStateMachineFuzzer::Case& _case, int32 _node)
+{
+	TArray<FHierarchicalStateMachineFuzzer::Node>& nodes = _case.nodes;
+
+	TArray<bool> removed;
+	removed.SetNumZeroed(nodes.Num());
+	removed[_node] = true;
+	for (int32 i = _node + 1; i < nodes.Num(); ++i)
+	{
+		removed[i] = nodes[i].parent != INDEX_NONE && removed[nodes[i].parent];
+	}
+
+	TArray<int32> remap;
+	remap.SetNumUninitialized(nodes.Num());
+	TArray<FHierarchicalStateMachineFuzzer::Node> newNodes;
+	for (int32 i = 0; i < nodes.Num(); ++i)
+	{
+		remap[i] = removed[i] ? INDEX_NONE : newNodes.Add(nodes[i]);
+	}
+
+	bool hasRootTrack = false;
+	for (int32 i = 0; i < newNodes.Num(); ++i)
+	{
+		FHierarchicalStateMachineFuzzer::Node& node = newNodes[i];
+		if (node.parent != INDEX_NONE)
+		{
+			node.parent = remap[node.parent];
+		}
+		hasRootTrack |= node.isTrack && node.parent == INDEX_NONE;
+	}
+	if (!hasRootTrack)
+		return false;
+
+	for (int32 i = 0; i < newNodes.Num(); ++i)
+	{
+		if (!newNodes[i].isTrack)
+			continue;
+
+		int32 firstState = INDEX_NONE;
+		bool hasDefault = false;
+		for (int32 j = i + 1; j < newNodes.Num(); ++j)
+		{
+			if (newNodes[j].parent == i)
+			{
+				firstState = firstState == INDEX_NONE ? j : firstState;
+				hasDefault |= newNodes[j].isDefault;
+			}
+		}
+
+		if (firstState == INDEX_NONE)
+			return false;
+
+		if (!hasDefault)
+		{
+			newNodes[firstState].isDefault = true;
+		}
+	}
+
+	TArray<FHierarchicalStateMachineFuzzer::Transition> newTransitions;
+	for (const FHierarchicalStateMachineFuzzer::Transition& transition : _case.transitions)
+	{
+		if (remap[transition.source] != INDEX_NONE && remap[transition.target] != INDEX_NONE)
+		{
+			FHierarchicalStateMachineFuzzer::Transition& newTransition = newTransitions[newTransitions.Add(transition)];
+			newTransition.source = remap[transition.source];
+			newTransition.target = remap[transition.target];
+		}
+	}
+
+	nodes = MoveTemp(newNodes);
+	_case.transitions = MoveTemp(newTransitions);
+	return true;
+}
+
+FHierarchicalStateMachineFuzzer::Case FHierarchicalStateMachineFuzzer::Generate(int32 _seed)
+{
+	FRandomStream random(_seed);
+	Case result;
+	result.seed = _seed;
+	result.immediatelyDequeueEvents = random.FRand() < 0.8f;
+	result.rejectUnhandledEvents = random.FRand() < 0.8f;
+
+	enum Shape { Shape_Balanced, Shape_Deep, Shape_Wide, Shape_Parallel, Shape_Count };
+	Shape shape = Shape(random.RandRange(0, Shape_Count - 1));
+
+	float childTracksProbability = shape == Shape_Deep ? 0.5f : shape == Shape_Parallel ? 0.4f : shape == Shape_Wide ? 0.1f : 0.25f;
+	int32 maxChildTracks = shape == Shape_Parallel ? 4 : 2;
+
+	TArray<int32> tracks;
+	int32 rootTracksCount = shape == Shape_Parallel ? random.RandRange(2, 5) : random.RandRange(1, 2);
+	for (int32 i = 0; i < rootTracksCount; ++i)
+	{
+		tracks.Add(result.nodes.Add(Node{ INDEX_NONE, true }));
+	}
+
+	TArray<int32> states;
+	int32 statesCount = random.RandRange(4, 40);
+	for (int32 i = 0; i < statesCount; ++i)
+	{
+		int32 track = tracks[random.RandRange(0, tracks.Num() - 1)];
+		if (shape == Shape_Deep && random.FRand() < 0.7f)
+		{
+			track = tracks.Last();
+		}
+		else if (shape == Shape_Wide && random.FRand() < 0.7f)
+		{
+			track = tracks[random.RandRange(0, rootTracksCount - 1)];
+		}
+
+		Node state;
+		state.parent = track;
+		int32 stateIndex = result.nodes.Add(state);
+		states.Add(stateIndex);
+
+		if (random.FRand() < childTracksProbability)
+		{
+			int32 childTracksCount = random.RandRange(1, maxChildTracks);
+			for (int32 j = 0; j < childTracksCount; ++j)
+			{
+				tracks.Add(result.nodes.Add(Node{ stateIndex, true }));
+			}
+		}
+	}
+
+	// Every track needs states and exactly one default state
+	for (int32 track : tracks)
+	{
+		TArray<int32> trackStates;
+		for (int32 i = track + 1; i < result.nodes.Num(); ++i)
+		{
+			if (result.nodes[i].parent == track && !result.nodes[i].isTrack)
+			{
+				trackStates.Add(i);
+			}
+		}
+		if (trackStates.Num() == 0)
+		{
+			Node state;
+			state.parent = track;
+			int32 stateIndex = result.nodes.Add(state);
+			states.Add(stateIndex);
+			trackStates.Add(stateIndex);
+		}
+		result.nodes[trackStates[random.RandRange(0, trackStates.Num() - 1)]].isDefault = true;
+	}
+
+	result.eventsCount = FMath::Max(2, states.Num() / 3);
+	int32 transitionsCount = FMath::Max(result.eventsCount, random.RandRange(states.Num() / 2, states.Num() * 2));
+	for (int32 i = 0; i < transitionsCount; ++i)
+	{
+		Transition transition;
+		transition.event = i < result.eventsCount ? i : random.RandRange(0, result.eventsCount - 1);
+		transition.source = random.FRand() < 0.2f ? tracks[random.RandRange(0, tracks.Num() - 1)] : states[random.RandRange(0, states.Num() - 1)];
+		transition.target = states[random.RandRange(0, states.Num() - 1)];
+		result.transitions.Add(transition);
+	}
+
+	for (int32 state : states)
+	{
+		Node& node = result.nodes[state];
+		node.enterEvent = random.FRand() < 0.15f ? random.RandRange(0, result.eventsCount - 1) : INDEX_NONE;
+		node.tickEvent = random.FRand() < 0.1f ? random.RandRange(0, result.eventsCount - 1) : INDEX_NONE;
+		node.exitEvent = random.FRand() < 0.05f ? random.RandRange(0, result.eventsCount - 1) : INDEX_NONE;
+	}
+
+	int32 operationsCount = random.RandRange(10, 80);
+	for (int32 i = 0; i < operationsCount; ++i)
+	{
+		Operation operation;
+		float roll = random.FRand();
+		operation.type = roll < 0.7f ? OperationType_PostEvent : roll < 0.95f ? OperationType_Tick : OperationType_Restart;
+		operation.event = operation.type == OperationType_PostEvent ? random.RandRange(0, result.eventsCount - 1) : INDEX_NONE;
+		result.operations.Add(operation);
+	}
+
+	NormalizeCase(result);
+	return result;
+}
+
+bool FHierarchicalStateMachineFuzzer::Compare(const Case& _case, FString* _outMismatch)
+{
+	FFuzzerRun referenceRun;
+	InitializeRun(referenceRun, _case);
+	Execute<FReferenceStateMachine>(referenceRun);
+
+	FFuzzerRun optimizedRun;
+	InitializeRun(optimizedRun, _case);
+	Execute<FHierarchicalStateMachine>(optimizedRun);
+
+	if (referenceRun.trace == optimizedRun.trace)
+		return true;
+
+	if (_outMismatch)
+	{
+		int32 index = 0;
+		while (index < referenceRun.trace.Num() && index < optimizedRun.trace.Num() && referenceRun.trace[index] == optimizedRun.trace[index])
+		{
+			++index;
+		}
+
+		int32 operation = 0;
+		for (int32 i = 0; i < index; ++i)
+		{
+			if (referenceRun.trace[i] % TraceEntryType_Count == TraceEntryType_Operation)
+			{
+				operation = referenceRun.trace[i] / TraceEntryType_Count;
+			}
+		}
+
+		*_outMismatch = FString::Printf(TEXT("Traces diverge at entry %d (operation %d): reference \"%s\", optimized \"%s\"."),
+			index, operation, *DescribeTraceEntry(referenceRun, index), *DescribeTraceEntry(optimizedRun, index));
+	}
+	return false;
+}
+
+FHierarchicalStateMachineFuzzer::Case FHierarchicalStateMachineFuzzer::Shrink(const Case& _case)
+{
+	Case result = _case;
+
+	auto tryMutation = [&result](TFunctionRef<bool(Case&)> _mutation)
+	{
+		Case candidate = result;
+		if (!_mutation(candidate))
+			return false;
+
+		NormalizeCase(candidate);
+		if (Compare(candidate))
+			return false;
+
+		result = MoveTemp(candidate);
+		return true;
+	};
+
+	bool shrunk = true;
+	while (shrunk)
+	{
+		shrunk = false;
+
+		for (int32 chunk = FMath::Max(1, result.operations.Num() / 2); chunk >= 1; chunk /= 2)
+		{
+			for (int32 i = 0; i + chunk <= result.operations.Num();)
+			{
+				if (!tryMutation([i, chunk](Case& _candidate) { _candidate.operations.RemoveAt(i, chunk); return true; }))
+				{
+					++i;
+				}
+				else
+				{
+					shrunk = true;
+				}
+			}
+		}
+
+		for (int32 i = result.nodes.Num() - 1; i >= 0; --i)
+		{
+			if (i < result.nodes.Num() && tryMutation([i](Case& _candidate) { return RemoveNode(_candidate, i); }))
+			{
+				shrunk = true;
+			}
+		}
+
+		for (int32 i = result.transitions.Num() - 1; i >= 0; --i)
+		{
+			shrunk |= tryMutation([i](Case& _candidate) { _candidate.transitions.RemoveAt(i); return true; });
+		}
+
+		for (int32 i = 0; i < result.nodes.Num(); ++i)
+		{
+			const Node& node = result.nodes[i];
+			if (node.enterEvent != INDEX_NONE)
+				shrunk |= tryMutation([i](Case& _candidate) { _candidate.nodes[i].enterEvent = INDEX_NONE; return true; });
+			if (node.tickEvent != INDEX_NONE)
+				shrunk |= tryMutation([i](Case& _candidate) { _candidate.nodes[i].tickEvent = INDEX_NONE; return true; });
+			if (node.exitEvent != INDEX_NONE)
+				shrunk |= tryMutation([i](Case& _candidate) { _candidate.nodes[i].exitEvent = INDEX_NONE; return true; });
+		}
+	}
+
+	return result;
+}
+
+FString FHierarchicalStateMachineFuzzer::Describe(const Case& _case)
+{
+	FFuzzerRun run;
+	InitializeRun(run, _case);
+
+	FString text = FString::Printf(TEXT("// Seed %d, bImmediatelyDequeueEvents = %s, bRejectUnhandledEvents = %s\n"), _case.seed,
+		_case.immediatelyDequeueEvents ? TEXT("true") : TEXT("false"), _case.rejectUnhandledEvents ? TEXT("true") : TEXT("false"));
+	text += TEXT("STATEMACHINE_DEFINITION(stateMachine)\n(\n");
+
+	TFunction<void(int32, int32)> describeChildren = [&](int32 _parent, int32 _depth)
+	{
+		FString indent = FString::ChrN(_depth, TEXT('\t'));
+		for (int32 i = 0; i < _case.nodes.Num(); ++i)
+		{
+			const Node& node = _case.nodes[i];
+			if (node.parent != _parent)
+				continue;
+
+			FString callbacks;
+			if (node.enterEvent != INDEX_NONE)
+				callbacks += FString::Printf(TEXT(" Enter posts E%d."), node.enterEvent);
+			if (node.tickEvent != INDEX_NONE)
+				callbacks += FString::Printf(TEXT(" Tick posts E%d."), node.tickEvent);
+			if (node.exitEvent != INDEX_NONE)
+				callbacks += FString::Printf(TEXT(" Exit posts E%d."), node.exitEvent);
+
+			text += FString::Printf(TEXT("%s%s(%s)%s%s\n%s(\n"), *indent, node.isTrack ? TEXT("TRACK") : node.isDefault ? TEXT("DEFAULT_STATE") : TEXT("STATE"),
+				*run.nodeNames[i].ToString(), callbacks.IsEmpty() ? TEXT("") : TEXT(" //"), *callbacks, *indent);
+			describeChildren(i, _depth + 1);
+			text += FString::Printf(TEXT("%s);\n"), *indent);
+		}
+	};
+	describeChildren(INDEX_NONE, 1);
+
+	for (const Transition& transition : _case.transitions)
+	{
+		text += FString::Printf(TEXT("\tTRANSITION_EVENT(\"%s\", %s, %s);\n"), *run.eventNames[transition.event].ToString(),
+			*run.nodeNames[transition.source].ToString(), *run.nodeNames[transition.target].ToString());
+	}
+	text += TEXT(");\n// Start, then:\n");
+
+	for (int32 i = 0; i < _case.operations.Num(); ++i)
+	{
+		const Operation& operation = _case.operations[i];
+		switch (operation.type)
+		{
+		case OperationType_PostEvent: text += FString::Printf(TEXT("// %d: PostEvent(\"%s\")\n"), i, *run.eventNames[operation.event].ToString()); break;
+		case OperationType_Tick: text += FString::Printf(TEXT("// %d: Tick\n"), i); break;
+		case OperationType_Restart: text += FString::Printf(TEXT("// %d: Stop, Start\n"), i); break;
+		}
+	}
+	text += TEXT("// Stop");
+	return text;
+}
+
+int32 FHierarchicalStateMachineFuzzer::Run(int32 _firstSeed, int32 _casesCount, FOutputDevice& _output)
+{
+	double startTime = FPlatformTime::Seconds();
+	int32 failuresCount = 0;
+
+	for (int32 i = 0; i < _casesCount; ++i)
+	{
+		Case testCase = Generate(_firstSeed + i);
+
+		FString mismatch;
+		if (Compare(testCase, &mismatch))
+			continue;
+
+		++failuresCount;
+		if (failuresCount == 1)
+		{
+			Case shrunkCase = Shrink(testCase);
+			Compare(shrunkCase, &mismatch);
+			_output.Logf(ELogVerbosity::Error, TEXT("[StateMachine] Seed %d diverges from the reference. Shrunk case:\n%s\n%s"), testCase.seed, *Describe(shrunkCase), *mismatch);
+		}
+		else
+		{
+			_output.Logf(ELogVerbosity::Error, TEXT("[StateMachine] Seed %d diverges from the reference. %s"), testCase.seed, *mismatch);
+		}
+	}
+
+	double duration = FPlatformTime::Seconds() - startTime;
+	_output.Logf(TEXT("[StateMachine] %d fuzz cases from seed %d in %.2fs (%.0f cases/s), %d failures."), _casesCount, _firstSeed, duration,
+		duration > 0.0 ? _casesCount / duration : 0.0, failuresCount);
+	return failuresCount;
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice s_fuzzCommand(
+	TEXT("HSM.Fuzz"),
+	TEXT("Compares Hierarchical State Machines against the reference implementation on random cases. Usage: HSM.Fuzz [CasesCount=1000] [FirstSeed=1]"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda([](const TArray<FString>& _args, UWorld*, FOutputDevice& _output)
+	{
+		int32 casesCount = _args.Num() > 0 ? FCString::Atoi(*_args[0]) : 1000;
+		int32 firstSeed = _args.Num() > 1 ? FCString::Atoi(*_args[1]) : 1;
+		FHierarchicalStateMachineFuzzer::Run(firstSeed, casesCount, _output);
+	})
+);
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FOutputDevice;
+
+// Differential harness: generates random hierarchies and event sequences, runs them through FHierarchicalStateMachine and through a
+// reference port of the original algorithm, and compares the full Enter/Tick/Exit traces. Every case is reproducible from its seed,
+// and failing cases are shrunk before being reported.
+class FHierarchicalStateMachineFuzzer
+{
+public:
+	struct Node
+	{
+		int32 parent = INDEX_NONE; // Parents always come before their children
+		bool isTrack = false;
+		bool isDefault = false;
+		int32 enterEvent = INDEX_NONE; // Event posted by the state callbacks, if any
+		int32 tickEvent = INDEX_NONE;
+		int32 exitEvent = INDEX_NONE;
+	};
+
+	struct Transition
+	{
+		int32 event = INDEX_NONE;
+		int32 source = INDEX_NONE; // Track or State node
+		int32 target = INDEX_NONE; // State node
+	};
+
+	enum OperationType
+	{
+		OperationType_PostEvent,
+		OperationType_Tick,
+		OperationType_Restart,
+	};
+
+	struct Operation
+	{
+		OperationType type = OperationType_PostEvent;
+		int32 event = INDEX_NONE;
+	};
+
+	struct Case
+	{
+		int32 seed = 0;
+		int32 eventsCount = 0;
+		bool immediatelyDequeueEvents = true;
+		bool rejectUnhandledEvents = true;
+		TArray<Node> nodes;
+		TArray<Transition> transitions;
+		TArray<Operation> operations;
+	};
+
+	static Case Generate(int32 _seed);
+
+	// Returns true if both implementations produced the same trace, otherwise describes the first divergence.
+	static bool Compare(const Case& _case, FString* _outMismatch = nullptr);
+
+	// Removes operations, transitions, callbacks and nodes as long as the case keeps failing.
+	static Case Shrink(const Case& _case);
+
+	static FString Describe(const Case& _case);
+
+	// Runs _casesCount cases with consecutive seeds, reports the first failure shrunk and returns the number of failures.
+	static int32 Run(int32 _firstSeed, int32 _casesCount, FOutputDevice& _output);
+};
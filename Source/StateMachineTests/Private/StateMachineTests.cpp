@@ -1,11 +1,22 @@
 // Copyright 1998-2017 Epic Games, Inc. All Rights Reserved.
 
 #include "StateMachineTests.h"
+#include "HierarchicalStateMachineFuzzer.h"
 
+#include <Async/Async.h>
 #include <Misc/AutomationTest.h>
 #include <UnrealEngine.h>
 
 #include <HierarchicalStateMachine.h>
+#include <HierarchicalStateMachineBroadcaster.h>
+#include <HierarchicalStateMachineCookedDefinition.h>
+#include <HierarchicalStateMachineFragment.h>
+#include <HierarchicalStateMachineObjectPool.h>
+#include <HierarchicalStateMachinePool.h>
+#include <HierarchicalStateMachineRecorder.h>
+#include <HierarchicalStateMachineStats.h>
+#include <HierarchicalStateMachineTrace.h>
+#include <StaticHierarchicalStateMachine.h>
 
 #define LOCTEXT_NAMESPACE "FStateMachineTestsModule"
 
@@ -26,6 +37,33 @@ void FStateMachineTestsModule::ShutdownModule()
 	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTransitionsTest");
 	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTickOrderTest");
 	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTrackTransitionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStaticStateMachineDefaultStatesTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStaticStateMachineTransitionsTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStaticStateMachineTickOrderTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStaticStateMachineTrackTransitionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTimedTransitionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineLatentEnterTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineReachableStatesTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachinePrefetchTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineOptimizeDefinitionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineHandlesTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineBroadcastTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineParallelTracksTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineCookedDefinitionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineRecordReplayTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineEventPrioritiesTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineSuspendTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTrackHistoryTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineEventRejectionTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineRawCallbacksTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachinePoolTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineMemoryTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FCoreStateMachineTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FFragmentStateMachineTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineTraceTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineFuzzTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineCurrentStatesStringTest");
+	FAutomationTestFramework::Get().UnregisterAutomationTest("FStateMachineStatsTest");
 }
 
 #undef LOCTEXT_NAMESPACE
@@ -303,6 +341,19 @@ void UTestClass::G2_Exit()
 		History.Add(TEXT("G2_Exit"));
 }
 
+int32 UTestClass::BatchTickCount = 0;
+
+void UTestClass::B1_BatchTick(TArrayView<void*> _owners, float _dt)
+{
+	++BatchTickCount;
+	for (void* owner : _owners)
+	{
+		UTestClass* testObject = static_cast<UTestClass*>(owner);
+		if (testObject->bRecord)
+			testObject->History.Add(TEXT("B1_BatchTick"));
+	}
+}
+
 // ===== TESTS =====
 
 #define TEST(cond, txt) if (!(cond)) { UE_LOG(LogTemp, Error, TEXT("%s"), TEXT(txt)); result = false; break; }
@@ -310,56 +361,53 @@ void UTestClass::G2_Exit()
 static UHierarchicalStateMachine* s_stateMachine = nullptr;
 static UTestClass* s_testObject = nullptr;
 
-static void BuildTestStateMachine()
+static void DefineTestStateMachine(FHierarchicalStateMachine* _stateMachine, UTestClass* _testObject)
 {
-	s_stateMachine = NewObject<UHierarchicalStateMachine>();
-	s_testObject = NewObject<UTestClass>();
-
-	STATEMACHINE_DEFINITION(s_stateMachine)
+	STATEMACHINE_DEFINITION(_stateMachine)
 	(
 		TRACK(A)
 		(
 			DEFAULT_STATE(A1)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::A1_Enter);
-				STATE_TICK(s_testObject, &UTestClass::A1_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::A1_Exit);
+				STATE_ENTER(_testObject, &UTestClass::A1_Enter);
+				STATE_TICK(_testObject, &UTestClass::A1_Tick);
+				STATE_EXIT(_testObject, &UTestClass::A1_Exit);
 
 				TRACK(C)
 				(
 					DEFAULT_STATE(C1)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::C1_Enter);
-						STATE_TICK(s_testObject, &UTestClass::C1_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::C1_Exit);
+						STATE_ENTER(_testObject, &UTestClass::C1_Enter);
+						STATE_TICK(_testObject, &UTestClass::C1_Tick);
+						STATE_EXIT(_testObject, &UTestClass::C1_Exit);
 					);
 					STATE(C2)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::C2_Enter);
-						STATE_TICK(s_testObject, &UTestClass::C2_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::C2_Exit);
+						STATE_ENTER(_testObject, &UTestClass::C2_Enter);
+						STATE_TICK(_testObject, &UTestClass::C2_Tick);
+						STATE_EXIT(_testObject, &UTestClass::C2_Exit);
 					);
 				);
 			);
 			STATE(A2)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::A2_Enter);
-				STATE_TICK(s_testObject, &UTestClass::A2_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::A2_Exit);
+				STATE_ENTER(_testObject, &UTestClass::A2_Enter);
+				STATE_TICK(_testObject, &UTestClass::A2_Tick);
+				STATE_EXIT(_testObject, &UTestClass::A2_Exit);
 
 				TRACK(D)
 				(
 					DEFAULT_STATE(D1)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::D1_Enter);
-						STATE_TICK(s_testObject, &UTestClass::D1_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::D1_Exit);
+						STATE_ENTER(_testObject, &UTestClass::D1_Enter);
+						STATE_TICK(_testObject, &UTestClass::D1_Tick);
+						STATE_EXIT(_testObject, &UTestClass::D1_Exit);
 					);
 					STATE(D2)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::D2_Enter);
-						STATE_TICK(s_testObject, &UTestClass::D2_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::D2_Exit);
+						STATE_ENTER(_testObject, &UTestClass::D2_Enter);
+						STATE_TICK(_testObject, &UTestClass::D2_Tick);
+						STATE_EXIT(_testObject, &UTestClass::D2_Exit);
 					);
 				);
 
@@ -367,15 +415,15 @@ static void BuildTestStateMachine()
 				(
 					DEFAULT_STATE(G1)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::G1_Enter);
-						STATE_TICK(s_testObject, &UTestClass::G1_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::G1_Exit);
+						STATE_ENTER(_testObject, &UTestClass::G1_Enter);
+						STATE_TICK(_testObject, &UTestClass::G1_Tick);
+						STATE_EXIT(_testObject, &UTestClass::G1_Exit);
 					);
 					STATE(G2)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::G2_Enter);
-						STATE_TICK(s_testObject, &UTestClass::G2_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::G2_Exit);
+						STATE_ENTER(_testObject, &UTestClass::G2_Enter);
+						STATE_TICK(_testObject, &UTestClass::G2_Tick);
+						STATE_EXIT(_testObject, &UTestClass::G2_Exit);
 					);
 				);
 			);
@@ -384,43 +432,43 @@ static void BuildTestStateMachine()
 		(
 			DEFAULT_STATE(B1)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::B1_Enter);
-				STATE_TICK(s_testObject, &UTestClass::B1_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::B1_Exit);
+				STATE_ENTER(_testObject, &UTestClass::B1_Enter);
+				STATE_TICK(_testObject, &UTestClass::B1_Tick);
+				STATE_EXIT(_testObject, &UTestClass::B1_Exit);
 			);
 			STATE(B2)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::B2_Enter);
-				STATE_TICK(s_testObject, &UTestClass::B2_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::B2_Exit);
+				STATE_ENTER(_testObject, &UTestClass::B2_Enter);
+				STATE_TICK(_testObject, &UTestClass::B2_Tick);
+				STATE_EXIT(_testObject, &UTestClass::B2_Exit);
 
 				TRACK(E)
 				(
 					DEFAULT_STATE(E1)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::E1_Enter);
-						STATE_TICK(s_testObject, &UTestClass::E1_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::E1_Exit);
+						STATE_ENTER(_testObject, &UTestClass::E1_Enter);
+						STATE_TICK(_testObject, &UTestClass::E1_Tick);
+						STATE_EXIT(_testObject, &UTestClass::E1_Exit);
 					);
 					STATE(E2)
 					(
-						STATE_ENTER(s_testObject, &UTestClass::E2_Enter);
-						STATE_TICK(s_testObject, &UTestClass::E2_Tick);
-						STATE_EXIT(s_testObject, &UTestClass::E2_Exit);
+						STATE_ENTER(_testObject, &UTestClass::E2_Enter);
+						STATE_TICK(_testObject, &UTestClass::E2_Tick);
+						STATE_EXIT(_testObject, &UTestClass::E2_Exit);
 					);
 				);
 			);
 			STATE(B3)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::B3_Enter);
-				STATE_TICK(s_testObject, &UTestClass::B3_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::B3_Exit);
+				STATE_ENTER(_testObject, &UTestClass::B3_Enter);
+				STATE_TICK(_testObject, &UTestClass::B3_Tick);
+				STATE_EXIT(_testObject, &UTestClass::B3_Exit);
 			);
 			STATE(B4)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::B4_Enter);
-				STATE_TICK(s_testObject, &UTestClass::B4_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::B4_Exit);
+				STATE_ENTER(_testObject, &UTestClass::B4_Enter);
+				STATE_TICK(_testObject, &UTestClass::B4_Tick);
+				STATE_EXIT(_testObject, &UTestClass::B4_Exit);
 			);
 		);
 
@@ -428,9 +476,9 @@ static void BuildTestStateMachine()
 		(
 			DEFAULT_STATE(F1)
 			(
-				STATE_ENTER(s_testObject, &UTestClass::F1_Enter);
-				STATE_TICK(s_testObject, &UTestClass::F1_Tick);
-				STATE_EXIT(s_testObject, &UTestClass::F1_Exit);
+				STATE_ENTER(_testObject, &UTestClass::F1_Enter);
+				STATE_TICK(_testObject, &UTestClass::F1_Tick);
+				STATE_EXIT(_testObject, &UTestClass::F1_Exit);
 			);
 		);
 
@@ -447,6 +495,13 @@ static void BuildTestStateMachine()
 	);
 }
 
+static void BuildTestStateMachine()
+{
+	s_stateMachine = NewObject<UHierarchicalStateMachine>();
+	s_testObject = NewObject<UTestClass>();
+	DefineTestStateMachine(s_stateMachine, s_testObject);
+}
+
 static void DestroyTestStateMachine()
 {
 	s_stateMachine->ConditionalBeginDestroy();
@@ -454,6 +509,140 @@ static void DestroyTestStateMachine()
 	GEngine->PerformGarbageCollectionAndCleanupActors();
 }
 
+// Same machine as BuildTestStateMachine, resolved at compile time
+static constexpr auto s_staticDefinition = STATIC_STATEMACHINE_DEFINITION(UTestClass, 16)
+(
+	STATIC_TRACK(A)
+	(
+		STATIC_DEFAULT_STATE(A1)
+		(
+			STATIC_STATE_ENTER(&UTestClass::A1_Enter)
+			STATIC_STATE_TICK(&UTestClass::A1_Tick)
+			STATIC_STATE_EXIT(&UTestClass::A1_Exit)
+
+			STATIC_TRACK(C)
+			(
+				STATIC_DEFAULT_STATE(C1)
+				(
+					STATIC_STATE_ENTER(&UTestClass::C1_Enter)
+					STATIC_STATE_TICK(&UTestClass::C1_Tick)
+					STATIC_STATE_EXIT(&UTestClass::C1_Exit)
+				)
+				STATIC_STATE(C2)
+				(
+					STATIC_STATE_ENTER(&UTestClass::C2_Enter)
+					STATIC_STATE_TICK(&UTestClass::C2_Tick)
+					STATIC_STATE_EXIT(&UTestClass::C2_Exit)
+				)
+			)
+		)
+		STATIC_STATE(A2)
+		(
+			STATIC_STATE_ENTER(&UTestClass::A2_Enter)
+			STATIC_STATE_TICK(&UTestClass::A2_Tick)
+			STATIC_STATE_EXIT(&UTestClass::A2_Exit)
+
+			STATIC_TRACK(D)
+			(
+				STATIC_DEFAULT_STATE(D1)
+				(
+					STATIC_STATE_ENTER(&UTestClass::D1_Enter)
+					STATIC_STATE_TICK(&UTestClass::D1_Tick)
+					STATIC_STATE_EXIT(&UTestClass::D1_Exit)
+				)
+				STATIC_STATE(D2)
+				(
+					STATIC_STATE_ENTER(&UTestClass::D2_Enter)
+					STATIC_STATE_TICK(&UTestClass::D2_Tick)
+					STATIC_STATE_EXIT(&UTestClass::D2_Exit)
+				)
+			)
+
+			STATIC_TRACK(G)
+			(
+				STATIC_DEFAULT_STATE(G1)
+				(
+					STATIC_STATE_ENTER(&UTestClass::G1_Enter)
+					STATIC_STATE_TICK(&UTestClass::G1_Tick)
+					STATIC_STATE_EXIT(&UTestClass::G1_Exit)
+				)
+				STATIC_STATE(G2)
+				(
+					STATIC_STATE_ENTER(&UTestClass::G2_Enter)
+					STATIC_STATE_TICK(&UTestClass::G2_Tick)
+					STATIC_STATE_EXIT(&UTestClass::G2_Exit)
+				)
+			)
+		)
+	)
+	STATIC_TRACK(B)
+	(
+		STATIC_DEFAULT_STATE(B1)
+		(
+			STATIC_STATE_ENTER(&UTestClass::B1_Enter)
+			STATIC_STATE_TICK(&UTestClass::B1_Tick)
+			STATIC_STATE_EXIT(&UTestClass::B1_Exit)
+		)
+		STATIC_STATE(B2)
+		(
+			STATIC_STATE_ENTER(&UTestClass::B2_Enter)
+			STATIC_STATE_TICK(&UTestClass::B2_Tick)
+			STATIC_STATE_EXIT(&UTestClass::B2_Exit)
+
+			STATIC_TRACK(E)
+			(
+				STATIC_DEFAULT_STATE(E1)
+				(
+					STATIC_STATE_ENTER(&UTestClass::E1_Enter)
+					STATIC_STATE_TICK(&UTestClass::E1_Tick)
+					STATIC_STATE_EXIT(&UTestClass::E1_Exit)
+				)
+				STATIC_STATE(E2)
+				(
+					STATIC_STATE_ENTER(&UTestClass::E2_Enter)
+					STATIC_STATE_TICK(&UTestClass::E2_Tick)
+					STATIC_STATE_EXIT(&UTestClass::E2_Exit)
+				)
+			)
+		)
+		STATIC_STATE(B3)
+		(
+			STATIC_STATE_ENTER(&UTestClass::B3_Enter)
+			STATIC_STATE_TICK(&UTestClass::B3_Tick)
+			STATIC_STATE_EXIT(&UTestClass::B3_Exit)
+		)
+		STATIC_STATE(B4)
+		(
+			STATIC_STATE_ENTER(&UTestClass::B4_Enter)
+			STATIC_STATE_TICK(&UTestClass::B4_Tick)
+			STATIC_STATE_EXIT(&UTestClass::B4_Exit)
+		)
+	)
+
+	STATIC_TRACK(F)
+	(
+		STATIC_DEFAULT_STATE(F1)
+		(
+			STATIC_STATE_ENTER(&UTestClass::F1_Enter)
+			STATIC_STATE_TICK(&UTestClass::F1_Tick)
+			STATIC_STATE_EXIT(&UTestClass::F1_Exit)
+		)
+	)
+
+	STATIC_TRANSITION_EVENT("Event1", A1, D2)
+	STATIC_TRANSITION_EVENT("Event1", E1, E2)
+	STATIC_TRANSITION_EVENT("Event2", B1, B2)
+	STATIC_TRANSITION_EVENT("Event2", B3, B4)
+
+	STATIC_TRANSITION_EVENT("SelfTransition", G1, G1)
+
+	STATIC_TRANSITION_EVENT("TrackTransition1", C, C2)
+	STATIC_TRANSITION_EVENT("TrackTransition2", A, D2)
+	STATIC_TRANSITION_EVENT("TrackTransition3", A, G2)
+);
+
+typedef TStaticHierarchicalStateMachine<decltype(s_staticDefinition), s_staticDefinition> FStaticTestStateMachine;
+
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineLifeCycleTest, "StateMachine.LifeCycle", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
 bool FStateMachineLifeCycleTest::RunTest(const FString& Parameters)
 {
@@ -462,31 +651,95 @@ bool FStateMachineLifeCycleTest::RunTest(const FString& Parameters)
 	return true;
 }
 
+template<typename StateMachineType>
+static bool RunDefaultStatesScenario(StateMachineType& _stateMachine, UTestClass* _testObject)
+{
+	bool result = true;
+
+	do
+	{
+		_testObject->bRecord = true;
+		_stateMachine.Start();
+		_stateMachine.Stop();
+
+		TEST(_testObject->History.Num() == 8, "Failed to initialize all states.");
+		TEST(_testObject->History[0] == TEXT("A1_Enter"), "Invalid initialization order.");
+		TEST(_testObject->History[1] == TEXT("C1_Enter"), "Invalid initialization order.");
+		TEST(_testObject->History[2] == TEXT("B1_Enter"), "Invalid initialization order.");
+		TEST(_testObject->History[3] == TEXT("F1_Enter"), "Invalid initialization order.");
+		TEST(_testObject->History[4] == TEXT("F1_Exit"), "Invalid initialization order.");
+		TEST(_testObject->History[5] == TEXT("B1_Exit"), "Invalid initialization order.");
+		TEST(_testObject->History[6] == TEXT("C1_Exit"), "Invalid initialization order.");
+		TEST(_testObject->History[7] == TEXT("A1_Exit"), "Invalid initialization order.");
+	}
+	while (false);
+
+	return result;
+}
+
 IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineDefaultStatesTest, "StateMachine.DefaultStates", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
 bool FStateMachineDefaultStatesTest::RunTest(const FString& Parameters)
 {
 	BuildTestStateMachine();
+	bool result = RunDefaultStatesScenario(*s_stateMachine, s_testObject);
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticStateMachineDefaultStatesTest, "StateMachine.Static.DefaultStates", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStaticStateMachineDefaultStatesTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObject = NewObject<UTestClass>();
+	FStaticTestStateMachine stateMachine(testObject);
+	bool result = RunDefaultStatesScenario(stateMachine, testObject);
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+template<typename StateMachineType>
+static bool RunTransitionsScenario(StateMachineType& _stateMachine, UTestClass* _testObject)
+{
 	bool result = true;
 
 	do
 	{
-		s_testObject->bRecord = true;
-		s_stateMachine->Start();
-		s_stateMachine->Stop();
+		_stateMachine.Start();
+		_testObject->bRecord = true;
+
+		_stateMachine.PostEvent(TEXT("Event1"));
+		TEST(_testObject->History.Num() == 5, "Incorrect Transition.");
+		TEST(_testObject->History[0] == TEXT("C1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[1] == TEXT("A1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[2] == TEXT("A2_Enter"), "Incorrect Transition.");
+		TEST(_testObject->History[3] == TEXT("D2_Enter"), "Incorrect Transition.");
+		TEST(_testObject->History[4] == TEXT("G1_Enter"), "Incorrect Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.PostEvent(TEXT("SelfTransition"));
+		TEST(_testObject->History.Num() == 2, "Failed Self Transition.");
+		TEST(_testObject->History[0] == TEXT("G1_Exit"), "Failed Self Transition.");
+		TEST(_testObject->History[1] == TEXT("G1_Enter"), "Failed Self Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.PostEvent(TEXT("Event2"));
+		TEST(_testObject->History.Num() == 3, "Incorrect Transition.");
+		TEST(_testObject->History[0] == TEXT("B1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[1] == TEXT("B2_Enter"), "Incorrect Transition.");
+		TEST(_testObject->History[2] == TEXT("E1_Enter"), "Incorrect Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.Stop();
+
+		TEST(_testObject->History.Num() == 6, "Incorrect Exit Order.");
+		TEST(_testObject->History[0] == TEXT("F1_Exit"), "Incorrect Exit Order.");
+		TEST(_testObject->History[1] == TEXT("E1_Exit"), "Incorrect Exit Order.");
+		TEST(_testObject->History[2] == TEXT("B2_Exit"), "Incorrect Exit Order.");
+		TEST(_testObject->History[3] == TEXT("G1_Exit"), "Incorrect Exit Order.");
+		TEST(_testObject->History[4] == TEXT("D2_Exit"), "Incorrect Exit Order.");
+		TEST(_testObject->History[5] == TEXT("A2_Exit"), "Incorrect Exit Order.");
 
-		TEST(s_testObject->History.Num() == 8, "Failed to initialize all states.");
-		TEST(s_testObject->History[0] == TEXT("A1_Enter"), "Invalid initialization order.");
-		TEST(s_testObject->History[1] == TEXT("C1_Enter"), "Invalid initialization order.");
-		TEST(s_testObject->History[2] == TEXT("B1_Enter"), "Invalid initialization order.");
-		TEST(s_testObject->History[3] == TEXT("F1_Enter"), "Invalid initialization order.");
-		TEST(s_testObject->History[4] == TEXT("F1_Exit"), "Invalid initialization order.");
-		TEST(s_testObject->History[5] == TEXT("B1_Exit"), "Invalid initialization order.");
-		TEST(s_testObject->History[6] == TEXT("C1_Exit"), "Invalid initialization order.");
-		TEST(s_testObject->History[7] == TEXT("A1_Exit"), "Invalid initialization order.");
-	}
-	while (false);
+	} while (false);
 
-	DestroyTestStateMachine();
 	return result;
 }
 
@@ -494,6 +747,339 @@ IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTransitionsTest, "StateMachine.Tra
 bool FStateMachineTransitionsTest::RunTest(const FString& Parameters)
 {
 	BuildTestStateMachine();
+	bool result = RunTransitionsScenario(*s_stateMachine, s_testObject);
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticStateMachineTransitionsTest, "StateMachine.Static.Transitions", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStaticStateMachineTransitionsTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObject = NewObject<UTestClass>();
+	FStaticTestStateMachine stateMachine(testObject);
+	bool result = RunTransitionsScenario(stateMachine, testObject);
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+template<typename StateMachineType>
+static bool RunTickOrderScenario(StateMachineType& _stateMachine, UTestClass* _testObject)
+{
+	bool result = true;
+
+	do
+	{
+		_stateMachine.Start();
+		_testObject->bRecord = true;
+
+		_stateMachine.Tick(0.f);
+		TEST(_testObject->History.Num() == 4, "Incorrect Tick Sequence.");
+		TEST(_testObject->History[0] == TEXT("A1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[1] == TEXT("C1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[2] == TEXT("B1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[3] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
+
+		_stateMachine.PostEvent(TEXT("Event1"));
+		_testObject->History.Empty();
+
+		_stateMachine.Tick(0.f);
+		TEST(_testObject->History.Num() == 5, "Incorrect Tick Sequence.");
+		TEST(_testObject->History[0] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[1] == TEXT("D2_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[2] == TEXT("G1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[3] == TEXT("B1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[4] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
+
+		_stateMachine.PostEvent(TEXT("Event2"));
+		_testObject->History.Empty();
+
+		_stateMachine.Tick(0.f);
+		TEST(_testObject->History.Num() == 6, "Incorrect Tick Sequence.");
+		TEST(_testObject->History[0] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[1] == TEXT("D2_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[2] == TEXT("G1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[3] == TEXT("B2_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[4] == TEXT("E1_Tick"), "Incorrect Tick Sequence.");
+		TEST(_testObject->History[5] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
+
+		_stateMachine.Stop();
+
+	} while (false);
+
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTickOrderTest, "StateMachine.TickOrder", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineTickOrderTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = RunTickOrderScenario(*s_stateMachine, s_testObject);
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticStateMachineTickOrderTest, "StateMachine.Static.TickOrder", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStaticStateMachineTickOrderTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObject = NewObject<UTestClass>();
+	FStaticTestStateMachine stateMachine(testObject);
+	bool result = RunTickOrderScenario(stateMachine, testObject);
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+template<typename StateMachineType>
+static bool RunTrackTransitionScenario(StateMachineType& _stateMachine, UTestClass* _testObject)
+{
+	bool result = true;
+
+	do
+	{
+		_stateMachine.Start();
+		_testObject->bRecord = true;
+
+		_stateMachine.PostEvent(TEXT("TrackTransition1"));
+		TEST(_testObject->History.Num() == 2, "Incorrect Transition.");
+		TEST(_testObject->History[0] == TEXT("C1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[1] == TEXT("C2_Enter"), "Incorrect Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.PostEvent(TEXT("TrackTransition2"));
+		TEST(_testObject->History.Num() == 5, "Incorrect Transition.");
+		TEST(_testObject->History[0] == TEXT("C2_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[1] == TEXT("A1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[2] == TEXT("A2_Enter"), "Incorrect Transition.");
+		TEST(_testObject->History[3] == TEXT("D2_Enter"), "Incorrect Transition.");
+		TEST(_testObject->History[4] == TEXT("G1_Enter"), "Incorrect Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.PostEvent(TEXT("TrackTransition3"));
+		TEST(_testObject->History.Num() == 2, "Incorrect Transition.");
+		TEST(_testObject->History[0] == TEXT("G1_Exit"), "Incorrect Transition.");
+		TEST(_testObject->History[1] == TEXT("G2_Enter"), "Incorrect Transition.");
+		_testObject->History.Empty();
+
+		_stateMachine.Stop();
+
+	} while (false);
+
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTrackTransitionTest, "StateMachine.TrackTransition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineTrackTransitionTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = RunTrackTransitionScenario(*s_stateMachine, s_testObject);
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStaticStateMachineTrackTransitionTest, "StateMachine.Static.TrackTransition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStaticStateMachineTrackTransitionTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObject = NewObject<UTestClass>();
+	FStaticTestStateMachine stateMachine(testObject);
+	bool result = RunTrackTransitionScenario(stateMachine, testObject);
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCoreStateMachineTest, "StateMachine.Core", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FCoreStateMachineTest::RunTest(const FString& Parameters)
+{
+	// Same scenarios on the engine independent machine, which is neither a UObject nor garbage collected
+	UTestClass* testObject = NewObject<UTestClass>();
+	bool result = true;
+
+	do
+	{
+		{
+			FHierarchicalStateMachine stateMachine;
+			DefineTestStateMachine(&stateMachine, testObject);
+			TEST(RunDefaultStatesScenario(stateMachine, testObject), "Core DefaultStates scenario failed.");
+		}
+		testObject->bRecord = false;
+		testObject->History.Empty();
+		{
+			FHierarchicalStateMachine stateMachine;
+			DefineTestStateMachine(&stateMachine, testObject);
+			TEST(RunTransitionsScenario(stateMachine, testObject), "Core Transitions scenario failed.");
+		}
+		testObject->bRecord = false;
+		testObject->History.Empty();
+		{
+			FHierarchicalStateMachine stateMachine;
+			DefineTestStateMachine(&stateMachine, testObject);
+			TEST(RunTickOrderScenario(stateMachine, testObject), "Core TickOrder scenario failed.");
+		}
+		testObject->bRecord = false;
+		testObject->History.Empty();
+		{
+			FHierarchicalStateMachine stateMachine;
+			DefineTestStateMachine(&stateMachine, testObject);
+			TEST(RunTrackTransitionScenario(stateMachine, testObject), "Core TrackTransition scenario failed.");
+		}
+
+	} while (false);
+
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+template<void (UTestClass::*Method)()>
+static void CallOnTestEntities(TArrayView<void*> _entities)
+{
+	for (void* entity : _entities)
+	{
+		(static_cast<UTestClass*>(entity)->*Method)();
+	}
+}
+
+template<void (UTestClass::*Method)(float)>
+static void CallTickOnTestEntities(TArrayView<void*> _entities, float _dt)
+{
+	for (void* entity : _entities)
+	{
+		(static_cast<UTestClass*>(entity)->*Method)(_dt);
+	}
+}
+
+#define BIND_TEST_ENTITIES_STATE(processor, StateName) \
+	processor.BindEnter(#StateName, &CallOnTestEntities<&UTestClass::StateName##_Enter>); \
+	processor.BindTick(#StateName, &CallTickOnTestEntities<&UTestClass::StateName##_Tick>); \
+	processor.BindExit(#StateName, &CallOnTestEntities<&UTestClass::StateName##_Exit>)
+
+static void BindTestEntitiesStates(FHierarchicalStateMachineProcessor& _processor)
+{
+	BIND_TEST_ENTITIES_STATE(_processor, A1);
+	BIND_TEST_ENTITIES_STATE(_processor, A2);
+	BIND_TEST_ENTITIES_STATE(_processor, B1);
+	BIND_TEST_ENTITIES_STATE(_processor, B2);
+	BIND_TEST_ENTITIES_STATE(_processor, B3);
+	BIND_TEST_ENTITIES_STATE(_processor, B4);
+	BIND_TEST_ENTITIES_STATE(_processor, C1);
+	BIND_TEST_ENTITIES_STATE(_processor, C2);
+	BIND_TEST_ENTITIES_STATE(_processor, D1);
+	BIND_TEST_ENTITIES_STATE(_processor, D2);
+	BIND_TEST_ENTITIES_STATE(_processor, E1);
+	BIND_TEST_ENTITIES_STATE(_processor, E2);
+	BIND_TEST_ENTITIES_STATE(_processor, F1);
+	BIND_TEST_ENTITIES_STATE(_processor, G1);
+	BIND_TEST_ENTITIES_STATE(_processor, G2);
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FFragmentStateMachineTest, "StateMachine.Fragment", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FFragmentStateMachineTest::RunTest(const FString& Parameters)
+{
+	// Definition callbacks are bound to nothing, only the processor bindings are called
+	FHierarchicalStateMachine definition;
+	DefineTestStateMachine(&definition, nullptr);
+
+	FHierarchicalStateMachineProcessor processor(definition);
+	BindTestEntitiesStates(processor);
+
+	TArray<UTestClass*> testObjects;
+	for (int32 i = 0; i < 3; ++i)
+	{
+		testObjects.Add(NewObject<UTestClass>());
+	}
+	bool result = true;
+
+	do
+	{
+		FHierarchicalStateMachineInstance stateMachine(processor, testObjects[0]);
+
+		TEST(RunDefaultStatesScenario(stateMachine, testObjects[0]), "Fragment DefaultStates scenario failed.");
+		testObjects[0]->bRecord = false;
+		testObjects[0]->History.Empty();
+		TEST(RunTransitionsScenario(stateMachine, testObjects[0]), "Fragment Transitions scenario failed.");
+		testObjects[0]->bRecord = false;
+		testObjects[0]->History.Empty();
+		TEST(RunTickOrderScenario(stateMachine, testObjects[0]), "Fragment TickOrder scenario failed.");
+		testObjects[0]->bRecord = false;
+		testObjects[0]->History.Empty();
+		TEST(RunTrackTransitionScenario(stateMachine, testObjects[0]), "Fragment TrackTransition scenario failed.");
+		testObjects[0]->History.Empty();
+
+		// Chunk of entities: only the one that received the event transitions, the others keep ticking the same states
+		TArray<FHierarchicalStateMachineFragment> fragments;
+		fragments.SetNum(testObjects.Num());
+		TArray<void*> entities;
+		for (UTestClass* testObject : testObjects)
+		{
+			testObject->bRecord = true;
+			entities.Add(testObject);
+		}
+
+		processor.Start(fragments, entities);
+		for (UTestClass* testObject : testObjects)
+		{
+			TEST(testObject->History.Num() == 4, "Failed to initialize all entities.");
+			testObject->History.Empty();
+		}
+
+		FHierarchicalStateMachineProcessor::PostEvent(fragments[1], processor.FindEvent("Event1"));
+		processor.Tick(fragments, entities, 0.f);
+		TEST(testObjects[0]->History.Num() == 4 && testObjects[0]->History[0] == TEXT("A1_Tick"), "Untouched entity transitioned.");
+		TEST(testObjects[2]->History.Num() == 4 && testObjects[2]->History[0] == TEXT("A1_Tick"), "Untouched entity transitioned.");
+		TEST(testObjects[1]->History.Num() == 10, "Incorrect Transition.");
+		TEST(testObjects[1]->History[0] == TEXT("C1_Exit"), "Incorrect Transition.");
+		TEST(testObjects[1]->History[1] == TEXT("A1_Exit"), "Incorrect Transition.");
+		TEST(testObjects[1]->History[2] == TEXT("A2_Enter"), "Incorrect Transition.");
+		TEST(testObjects[1]->History[5] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
+
+		// Same event from the same configuration resolves from the transition cache into the same configuration
+		processor.ResetTransitionCacheStats();
+		FHierarchicalStateMachineProcessor::PostEvent(fragments[2], processor.FindEvent("Event1"));
+		processor.Tick(fragments, entities, 0.f);
+		TEST(processor.GetTransitionCacheStats().hits == 1 && processor.GetTransitionCacheStats().misses == 0, "Transition was not resolved from the cache.");
+		TEST(fragments[2].configurationId == fragments[1].configurationId, "Identical configurations were not interned once.");
+		TEST(processor.GetCurrentStates(fragments[2]).Num() == 5, "Incorrect interned configuration.");
+
+		processor.Stop(fragments, entities);
+		TEST(!fragments[0].IsStarted() && !fragments[1].IsStarted() && !fragments[2].IsStarted(), "Fragments were not stopped.");
+		for (UTestClass* testObject : testObjects)
+		{
+			testObject->History.Empty();
+		}
+
+		// Instances stored by value keep their state when the array grows
+		TArray<FHierarchicalStateMachineInstance> instances;
+		instances.Emplace(processor, testObjects[0]);
+		instances[0].Start();
+		instances[0].PostEvent(FName("Event1"));
+		TEST(instances[0].GetCurrentStates().Num() == 5, "Instance events should be dequeued when posted.");
+		instances.Emplace(processor, testObjects[1]);
+		instances[1].bImmediatelyDequeueEvents = false;
+		instances[1].Start();
+		instances[1].PostEvent(FName("Event1"));
+		TEST(instances[1].GetCurrentStates().Num() == 4, "Instance events should wait for the next dequeue.");
+		instances[1].DequeueEvents();
+		TEST(instances[0].GetCurrentStates().Num() == 5 && instances[1].GetCurrentStates().Num() == 5, "Incorrect instance configurations.");
+		TEST(testObjects[0]->History.Num() == 9 && testObjects[0]->History[6] == TEXT("A2_Enter"), "Incorrect instance callbacks.");
+		TEST(testObjects[1]->History.Num() == 9 && testObjects[1]->History[6] == TEXT("A2_Enter"), "Incorrect instance callbacks.");
+		for (FHierarchicalStateMachineInstance& instance : instances)
+		{
+			instance.Stop();
+		}
+		TEST(!instances[0].IsStarted() && instances[0].GetCurrentStates().Num() == 0, "Instances were not stopped.");
+
+	} while (false);
+
+	for (UTestClass* testObject : testObjects)
+	{
+		testObject->ConditionalBeginDestroy();
+	}
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTimedTransitionTest, "StateMachine.TimedTransition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineTimedTransitionTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	s_stateMachine->AddTimedTransition("B1", "B3", 1.f);
+	s_stateMachine->AddEventTransition("RestartB1", "B1", "B1");
 	bool result = true;
 
 	do
@@ -501,37 +1087,54 @@ bool FStateMachineTransitionsTest::RunTest(const FString& Parameters)
 		s_stateMachine->Start();
 		s_testObject->bRecord = true;
 
-		s_stateMachine->PostEvent("Event1");
-		TEST(s_testObject->History.Num() == 5, "Incorrect Transition.");
-		TEST(s_testObject->History[0] == TEXT("C1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[1] == TEXT("A1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[2] == TEXT("A2_Enter"), "Incorrect Transition.");
-		TEST(s_testObject->History[3] == TEXT("D2_Enter"), "Incorrect Transition.");
-		TEST(s_testObject->History[4] == TEXT("G1_Enter"), "Incorrect Transition.");
+		s_stateMachine->Tick(0.5f);
+		TEST(s_testObject->History.Num() == 4, "Timed transition fired too early.");
 		s_testObject->History.Empty();
 
-		s_stateMachine->PostEvent("SelfTransition");
-		TEST(s_testObject->History.Num() == 2, "Failed Self Transition.");
-		TEST(s_testObject->History[0] == TEXT("G1_Exit"), "Failed Self Transition.");
-		TEST(s_testObject->History[1] == TEXT("G1_Enter"), "Failed Self Transition.");
+		s_stateMachine->Tick(0.6f);
+		TEST(s_testObject->History.Num() == 6, "Timed transition did not fire.");
+		TEST(s_testObject->History[0] == TEXT("B1_Exit"), "Incorrect Timed Transition.");
+		TEST(s_testObject->History[1] == TEXT("B3_Enter"), "Incorrect Timed Transition.");
+		TEST(s_testObject->History[4] == TEXT("B3_Tick"), "Incorrect Timed Transition.");
 		s_testObject->History.Empty();
 
+		s_stateMachine->Stop();
+		s_stateMachine->Start();
+		s_stateMachine->Tick(0.5f);
 		s_stateMachine->PostEvent("Event2");
-		TEST(s_testObject->History.Num() == 3, "Incorrect Transition.");
-		TEST(s_testObject->History[0] == TEXT("B1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[1] == TEXT("B2_Enter"), "Incorrect Transition.");
-		TEST(s_testObject->History[2] == TEXT("E1_Enter"), "Incorrect Transition.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Tick(1.f);
+		TEST(s_testObject->History.Num() == 5, "Timed transition was not cancelled on exit.");
+		TEST(s_testObject->History[2] == TEXT("B2_Tick"), "Timed transition was not cancelled on exit.");
 		s_testObject->History.Empty();
 
 		s_stateMachine->Stop();
 
-		TEST(s_testObject->History.Num() == 6, "Incorrect Exit Order.");
-		TEST(s_testObject->History[0] == TEXT("F1_Exit"), "Incorrect Exit Order.");
-		TEST(s_testObject->History[1] == TEXT("E1_Exit"), "Incorrect Exit Order.");
-		TEST(s_testObject->History[2] == TEXT("B2_Exit"), "Incorrect Exit Order.");
-		TEST(s_testObject->History[3] == TEXT("G1_Exit"), "Incorrect Exit Order.");
-		TEST(s_testObject->History[4] == TEXT("D2_Exit"), "Incorrect Exit Order.");
-		TEST(s_testObject->History[5] == TEXT("A2_Exit"), "Incorrect Exit Order.");
+		// Queued before the timeout within the same tick: the timeout belongs to the previous enter and must not fire
+		UHierarchicalStateMachine::StateHandle b1 = s_stateMachine->FindState("B1");
+		UHierarchicalStateMachine::StateHandle b3 = s_stateMachine->FindState("B3");
+		s_stateMachine->bImmediatelyDequeueEvents = false;
+		s_stateMachine->Start();
+		s_stateMachine->PostEvent("RestartB1");
+		s_stateMachine->Tick(1.1f);
+		TEST(s_stateMachine->IsStateActive(b1) && !s_stateMachine->IsStateActive(b3), "Timed transition fired on a state entered again.");
+		s_stateMachine->Tick(0.5f);
+		TEST(s_stateMachine->IsStateActive(b1), "Timed transition fired too early after the state was entered again.");
+
+		// Timer events are named alike in every machine: outside code can neither query, post nor broadcast them
+		const FName timerEventName(TEXT("__TimedTransition"), 1);
+		TEST(!s_stateMachine->CanHandleEvent(timerEventName), "Timer events should be hidden from CanHandleEvent.");
+		{
+			FHierarchicalStateMachineBroadcaster broadcaster;
+			broadcaster.Register(s_stateMachine);
+			TEST(broadcaster.GetSubscribersCount(timerEventName) == 0 && broadcaster.GetSubscribersCount("Event2") == 1, "Timer events should not be broadcast.");
+			broadcaster.Unregister(s_stateMachine);
+		}
+		s_stateMachine->Tick(0.6f);
+		TEST(s_stateMachine->IsStateActive(b3), "Timed transition of the state entered again did not fire.");
+
+		s_stateMachine->Stop();
 
 	} while (false);
 
@@ -539,46 +1142,47 @@ bool FStateMachineTransitionsTest::RunTest(const FString& Parameters)
 	return result;
 }
 
-IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTickOrderTest, "StateMachine.TickOrder", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
-bool FStateMachineTickOrderTest::RunTest(const FString& Parameters)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineLatentEnterTest, "StateMachine.LatentEnter", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineLatentEnterTest::RunTest(const FString& Parameters)
 {
 	BuildTestStateMachine();
 	bool result = true;
 
+	TSharedRef<UHierarchicalStateMachine::LatentTask, ESPMode::ThreadSafe> task = MakeShared<UHierarchicalStateMachine::LatentTask, ESPMode::ThreadSafe>();
+	UHierarchicalStateMachine::State* A2 = s_stateMachine->GetRootTracks()[0]->GetStates().FindRef("A2");
+	A2->LatentEnter.BindLambda([task]() -> UHierarchicalStateMachine::LatentTaskHandle { return task; });
+
 	do
 	{
 		s_stateMachine->Start();
 		s_testObject->bRecord = true;
 
-		s_stateMachine->Tick(0.f);
-		TEST(s_testObject->History.Num() == 4, "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[0] == TEXT("A1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[1] == TEXT("C1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[2] == TEXT("B1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[3] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
-
 		s_stateMachine->PostEvent("Event1");
+		TEST(s_testObject->History.Num() == 5, "Incorrect Transition.");
+		TEST(s_stateMachine->IsStateEntering(A2), "A2 should be entering until its task completes.");
 		s_testObject->History.Empty();
 
 		s_stateMachine->Tick(0.f);
-		TEST(s_testObject->History.Num() == 5, "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[0] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[1] == TEXT("D2_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[2] == TEXT("G1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[3] == TEXT("B1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[4] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
+		TEST(s_testObject->History.Num() == 2, "Entering states were ticked.");
+		TEST(s_testObject->History[0] == TEXT("B1_Tick"), "Other tracks should keep ticking.");
+		TEST(s_testObject->History[1] == TEXT("F1_Tick"), "Other tracks should keep ticking.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->PostEvent("SelfTransition");
+		TEST(s_testObject->History.Num() == 0, "Event exiting an entering state was not deferred.");
 
 		s_stateMachine->PostEvent("Event2");
+		TEST(s_testObject->History.Num() == 3, "Event outside of the entering subtree was deferred.");
+		TEST(s_testObject->History[0] == TEXT("B1_Exit"), "Incorrect Transition.");
 		s_testObject->History.Empty();
 
+		task->Complete();
 		s_stateMachine->Tick(0.f);
-		TEST(s_testObject->History.Num() == 6, "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[0] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[1] == TEXT("D2_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[2] == TEXT("G1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[3] == TEXT("B2_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[4] == TEXT("E1_Tick"), "Incorrect Tick Sequence.");
-		TEST(s_testObject->History[5] == TEXT("F1_Tick"), "Incorrect Tick Sequence.");
+		TEST(!s_stateMachine->HasPendingLatentEnters(), "Completed latent enter was not polled.");
+		TEST(s_testObject->History.Num() == 8, "Deferred event was not dequeued after completion.");
+		TEST(s_testObject->History[0] == TEXT("G1_Exit"), "Deferred event was not dequeued after completion.");
+		TEST(s_testObject->History[1] == TEXT("G1_Enter"), "Deferred event was not dequeued after completion.");
+		TEST(s_testObject->History[2] == TEXT("A2_Tick"), "Entered state was not ticked after completion.");
 
 		s_stateMachine->Stop();
 
@@ -588,42 +1192,1042 @@ bool FStateMachineTickOrderTest::RunTest(const FString& Parameters)
 	return result;
 }
 
-IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTrackTransitionTest, "StateMachine.TrackTransition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
-bool FStateMachineTrackTransitionTest::RunTest(const FString& Parameters)
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineReachableStatesTest, "StateMachine.ReachableStates", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineReachableStatesTest::RunTest(const FString& Parameters)
 {
 	BuildTestStateMachine();
 	bool result = true;
 
+	auto containsState = [](const TArray<UHierarchicalStateMachine::State*>& _states, FName _name)
+	{
+		return _states.ContainsByPredicate([_name](const UHierarchicalStateMachine::State* _state) { return _state->GetName() == _name; });
+	};
+
 	do
 	{
+		TArray<UHierarchicalStateMachine::State*> states;
 		s_stateMachine->Start();
-		s_testObject->bRecord = true;
-
-		s_stateMachine->PostEvent("TrackTransition1");
-		TEST(s_testObject->History.Num() == 2, "Incorrect Transition.");
-		TEST(s_testObject->History[0] == TEXT("C1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[1] == TEXT("C2_Enter"), "Incorrect Transition.");
-		s_testObject->History.Empty();
 
-		s_stateMachine->PostEvent("TrackTransition2");
-		TEST(s_testObject->History.Num() == 5, "Incorrect Transition.");
-		TEST(s_testObject->History[0] == TEXT("C2_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[1] == TEXT("A1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[2] == TEXT("A2_Enter"), "Incorrect Transition.");
-		TEST(s_testObject->History[3] == TEXT("D2_Enter"), "Incorrect Transition.");
-		TEST(s_testObject->History[4] == TEXT("G1_Enter"), "Incorrect Transition.");
-		s_testObject->History.Empty();
+		s_stateMachine->GetReachableStates(1, states);
+		TEST(states.Num() == 8, "Incorrect states reachable in one transition.");
+		TEST(containsState(states, "D2"), "D2 should be reachable through Event1.");
+		TEST(containsState(states, "C2"), "C2 should be reachable through TrackTransition1.");
+		TEST(!containsState(states, "E2"), "E2 should not be reachable before E1 is entered.");
 
-		s_stateMachine->PostEvent("TrackTransition3");
-		TEST(s_testObject->History.Num() == 2, "Incorrect Transition.");
-		TEST(s_testObject->History[0] == TEXT("G1_Exit"), "Incorrect Transition.");
-		TEST(s_testObject->History[1] == TEXT("G2_Enter"), "Incorrect Transition.");
-		s_testObject->History.Empty();
+		s_stateMachine->GetReachableStates(2, states);
+		TEST(containsState(states, "E2"), "E2 should be reachable through Event2 then Event1.");
 
 		s_stateMachine->Stop();
+		s_stateMachine->GetReachableStates(1, states);
+		TEST(states.Num() == 0, "Stopped machine should not reach any state.");
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+TSharedPtr<FStreamableHandle> UTestPrefetchStateMachine::_RequestPrefetch(const FSoftObjectPath& _asset, TAsyncLoadPriority _priority)
+{
+	Requests.Emplace(_asset, _priority);
+	return nullptr;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachinePrefetchTest, "StateMachine.Prefetch", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachinePrefetchTest::RunTest(const FString& Parameters)
+{
+	UTestPrefetchStateMachine* stateMachine = NewObject<UTestPrefetchStateMachine>();
+	const FSoftObjectPath a1(TEXT("/Game/Prefetch/A1.A1"));
+	const FSoftObjectPath a2(TEXT("/Game/Prefetch/A2.A2"));
+	const FSoftObjectPath a3(TEXT("/Game/Prefetch/A3.A3"));
+
+	STATEMACHINE_DEFINITION(stateMachine)
+	(
+		TRACK(A)
+		(
+			DEFAULT_STATE(A1)
+			(
+				STATE_ASSET(a1);
+			);
+			STATE(A2)
+			(
+				STATE_ASSET(a2);
+			);
+			STATE(A3)
+			(
+				STATE_ASSET(a3);
+			);
+		);
+
+		TRANSITION_EVENT("Event1", A1, A2);
+		TRANSITION_EVENT("Event2", A2, A3);
+	);
+
+	auto requestedAt = [stateMachine](const FSoftObjectPath& _asset, TAsyncLoadPriority _priority)
+	{
+		return stateMachine->Requests.ContainsByPredicate([&_asset, _priority](const TPair<FSoftObjectPath, TAsyncLoadPriority>& _request) { return _request.Key == _asset && _request.Value == _priority; });
+	};
+
+	bool result = true;
+
+	do
+	{
+		stateMachine->PrefetchTransitionsCount = 1;
+		stateMachine->PrefetchPriority = -50;
+		stateMachine->Start();
+		TEST(stateMachine->Requests.Num() == 2 && requestedAt(a1, -50) && requestedAt(a2, -50), "Current and reachable assets should be requested at PrefetchPriority.");
+		TEST(!stateMachine->IsAssetPrefetched(a3), "Assets out of reach should not be requested.");
+		stateMachine->Requests.Reset();
+
+		stateMachine->PostEvent("Event1");
+		TEST(stateMachine->Requests.Num() == 1 && requestedAt(a3, -50), "Only assets coming within reach should be requested.");
+		TEST(!stateMachine->IsAssetPrefetched(a1) && stateMachine->IsAssetPrefetched(a2), "Assets out of reach should be released.");
+		stateMachine->Requests.Reset();
+
+		stateMachine->PostEvent("Event2");
+		TEST(stateMachine->Requests.Num() == 0, "Prefetched assets should not be requested again.");
+		TEST(!stateMachine->IsAssetPrefetched(a2) && stateMachine->IsAssetPrefetched(a3), "Assets out of reach should be released.");
+
+		stateMachine->Stop();
+		TEST(!stateMachine->IsAssetPrefetched(a3), "Stopped machines should release every asset.");
+
+	} while (false);
+
+	stateMachine->ConditionalBeginDestroy();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineOptimizeDefinitionTest, "StateMachine.OptimizeDefinition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineOptimizeDefinitionTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	// Dead branches on top of the test machine: B5 is never targeted, H1 and I1 only group tracks
+	s_stateMachine->GetRootTracks()[1]->AddState("B5");
+	s_stateMachine->AddRootTrack("H")->AddDefaultState("H1")->AddTrack("I")->AddDefaultState("I1");
+
+	do
+	{
+		UHierarchicalStateMachine::DefinitionReport report;
+		s_stateMachine->AnalyzeDefinition(report);
+		TEST(report.unreachableStates.Num() == 3, "Incorrect unreachable states.");
+		TEST(report.unreachableStates.Contains("B3") && report.unreachableStates.Contains("B4") && report.unreachableStates.Contains("B5"), "B3, B4 and B5 should be unreachable.");
+		TEST(report.deadEvents.Num() == 0, "Event2 can still fire from B1.");
+		TEST(report.groupingTracks.Num() == 2, "Incorrect grouping tracks.");
+		TEST(report.groupingTracks.Contains("H") && report.groupingTracks.Contains("I"), "H and I should be grouping tracks.");
+
+		s_stateMachine->OptimizeDefinition(report);
+		TEST(report.removedStatesCount == 5, "Incorrect removed states count.");
+		TEST(report.removedTracksCount == 2, "Incorrect removed tracks count.");
+		TEST(report.removedTransitionsCount == 1, "The B3 to B4 transition should be removed.");
+		TEST(report.defaultStatesCountBefore == 6 && report.defaultStatesCountAfter == 4, "Grouping states should leave the default configuration.");
+		TEST(report.definitionSizeAfter < report.definitionSizeBefore, "Definition should shrink.");
+
+		TEST(RunTransitionsScenario(*s_stateMachine, s_testObject), "Optimized definition changed the callbacks order.");
+
+		s_stateMachine->AnalyzeDefinition(report);
+		TEST(report.unreachableStates.Num() == 0 && report.groupingTracks.Num() == 0, "Optimized definition should not have dead branches left.");
 
 	} while (false);
 
 	DestroyTestStateMachine();
 	return result;
 }
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineHandlesTest, "StateMachine.Handles", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineHandlesTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		UHierarchicalStateMachine::StateHandle a1 = s_stateMachine->FindState("A1");
+		UHierarchicalStateMachine::StateHandle a2 = s_stateMachine->FindState("A2");
+		UHierarchicalStateMachine::StateHandle d2 = s_stateMachine->FindState("D2");
+		UHierarchicalStateMachine::TrackHandle a = s_stateMachine->FindTrack("A");
+		UHierarchicalStateMachine::TrackHandle c = s_stateMachine->FindTrack("C");
+		TEST(a1.IsValid() && a2.IsValid() && d2.IsValid() && a.IsValid() && c.IsValid(), "Failed to resolve handles.");
+		TEST(!s_stateMachine->FindState("Unknown").IsValid(), "Unknown state should give an invalid handle.");
+
+		TEST(d2->IsInTrack(a.Get()) && d2->IsInState(a2.Get()), "Walked ancestry failed.");
+
+		s_stateMachine->Start();
+		TEST(d2->IsInTrack(a.Get()) && d2->IsInState(a2.Get()), "Numbered ancestry failed.");
+		TEST(!d2->IsInTrack(c.Get()) && !d2->IsInState(a1.Get()) && !a2->IsInState(a2.Get()), "Numbered ancestry should be strict.");
+
+		TEST(s_stateMachine->IsStateActive(a1) && !s_stateMachine->IsStateActive(d2), "Incorrect active states after Start.");
+
+		s_stateMachine->Tick(0.5f);
+		TEST(FMath::IsNearlyEqual(s_stateMachine->GetTimeInState(a1), 0.5f), "Incorrect time in A1.");
+
+		s_stateMachine->PostEvent("Event1");
+		TEST(!s_stateMachine->IsStateActive(a1) && s_stateMachine->IsStateActive(d2), "Incorrect active states after Event1.");
+		TEST(s_stateMachine->GetTimeInState(a1) == 0.f && s_stateMachine->GetTimeInState(d2) == 0.f, "Time should restart on enter.");
+
+		s_stateMachine->Tick(0.25f);
+		TEST(FMath::IsNearlyEqual(s_stateMachine->GetTimeInState(d2), 0.25f), "Incorrect time in D2.");
+
+		s_stateMachine->Stop();
+		TEST(!s_stateMachine->IsStateActive(d2), "No state should be active once stopped.");
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineBroadcastTest, "StateMachine.Broadcast", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineBroadcastTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObject = NewObject<UTestClass>();
+	bool result = true;
+
+	do
+	{
+		// Declared first so that the machines unregister themselves when destroyed
+		FHierarchicalStateMachineBroadcaster broadcaster;
+
+		FHierarchicalStateMachine stateMachines[3];
+		for (FHierarchicalStateMachine& stateMachine : stateMachines)
+		{
+			DefineTestStateMachine(&stateMachine, testObject);
+			broadcaster.Register(&stateMachine);
+		}
+
+		FHierarchicalStateMachine otherStateMachine;
+		otherStateMachine.AddRootTrack("X")->AddDefaultState("X1");
+		otherStateMachine.AddEventTransition("NightFell", "X", "X1");
+		broadcaster.Register(&otherStateMachine);
+
+		TEST(broadcaster.GetSubscribersCount("Event1") == 3, "Incorrect Event1 subscribers.");
+		TEST(broadcaster.GetSubscribersCount("NightFell") == 1, "Incorrect NightFell subscribers.");
+		TEST(broadcaster.GetSubscribersCount("Unknown") == 0, "Unknown event should not have subscribers.");
+
+		for (FHierarchicalStateMachine& stateMachine : stateMachines)
+		{
+			stateMachine.Start();
+		}
+		otherStateMachine.Start();
+
+		// The first machine keeps unhandled events, only the filter keeps Event1 out of its queue
+		stateMachines[0].bRejectUnhandledEvents = false;
+		stateMachines[0].PostEvent("Event1");
+		TEST(broadcaster.Broadcast("Event1", true) == 2, "Event1 should only reach the machines in A1.");
+
+		const FHierarchicalStateMachine::StateHandle d2 = stateMachines[1].FindState("D2");
+		TEST(stateMachines[1].IsStateActive(d2) && stateMachines[2].IsStateActive(stateMachines[2].FindState("D2")), "Broadcast event was not dequeued.");
+
+		TEST(broadcaster.Broadcast("Event2") == 3, "Event2 should reach every machine in B1.");
+		TEST(stateMachines[0].IsStateActive(stateMachines[0].FindState("B2")), "Broadcast event was not dequeued.");
+
+		broadcaster.Unregister(&stateMachines[2]);
+		TEST(broadcaster.GetSubscribersCount("Event1") == 2, "Unregistered machine is still subscribed.");
+		TEST(broadcaster.GetSubscribersCount("NightFell") == 1, "Other subscriptions should be kept.");
+
+		// Removed subscriptions are replaced by the last one, which must still be found when its machine unregisters
+		broadcaster.Unregister(&stateMachines[0]);
+		TEST(broadcaster.GetSubscribersCount("Event1") == 1, "Unregistered machine is still subscribed.");
+		broadcaster.Unregister(&stateMachines[1]);
+		TEST(broadcaster.GetSubscribersCount("Event1") == 0 && broadcaster.GetSubscribersCount("Event2") == 0, "Unregistered machines are still subscribed.");
+		broadcaster.Register(&stateMachines[1]);
+		broadcaster.Register(&stateMachines[0]);
+		TEST(broadcaster.GetSubscribersCount("Event1") == 2, "Machines should be able to register again.");
+
+		for (FHierarchicalStateMachine& stateMachine : stateMachines)
+		{
+			stateMachine.Stop();
+		}
+		otherStateMachine.Stop();
+
+	} while (false);
+
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineParallelTracksTest, "StateMachine.ParallelTracks", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineParallelTracksTest::RunTest(const FString& Parameters)
+{
+	bool result = true;
+
+	do
+	{
+		// Each track only touches its own counter while ticking, entering states are recorded on the calling thread
+		FHierarchicalStateMachine stateMachine;
+		stateMachine.bParallelTickTracks = true;
+
+		int32 ticksCounts[3] = { 0, 0, 0 };
+		TArray<FString> history;
+		const TCHAR* trackNames[3] = { TEXT("P"), TEXT("Q"), TEXT("R") };
+		for (int32 i = 0; i < 3; ++i)
+		{
+			const FString trackName = trackNames[i];
+			FHierarchicalStateMachine::Track* track = stateMachine.AddRootTrack(*trackName);
+			track->SetIndependent(true);
+
+			FHierarchicalStateMachine::State* firstState = track->AddDefaultState(*(trackName + TEXT("1")));
+			int32* ticksCount = &ticksCounts[i];
+			firstState->Tick.BindLambda([&stateMachine, ticksCount, trackName](float _dt)
+			{
+				++(*ticksCount);
+				stateMachine.PostEvent(*(TEXT("Go") + trackName));
+			});
+
+			FHierarchicalStateMachine::State* secondState = track->AddState(*(trackName + TEXT("2")));
+			secondState->Enter.BindLambda([&history, trackName]() { history.Add(trackName + TEXT("2_Enter")); });
+			secondState->Tick.BindLambda([ticksCount](float _dt) { ++(*ticksCount); });
+
+			stateMachine.AddEventTransition(*(TEXT("Go") + trackName), *(trackName + TEXT("1")), *(trackName + TEXT("2")));
+		}
+
+		stateMachine.Start();
+		stateMachine.Tick(0.f);
+		TEST(ticksCounts[0] == 1 && ticksCounts[1] == 1 && ticksCounts[2] == 1, "Every track should have ticked once.");
+		TEST(history.Num() == 3, "Events posted from the tasks were not merged.");
+		TEST(history[0] == TEXT("P2_Enter") && history[1] == TEXT("Q2_Enter") && history[2] == TEXT("R2_Enter"), "Events should be merged in tracks order.");
+
+		stateMachine.Tick(0.f);
+		TEST(ticksCounts[0] == 2 && ticksCounts[1] == 2 && ticksCounts[2] == 2, "Every track should have ticked twice.");
+		stateMachine.Stop();
+
+	} while (false);
+
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineCookedDefinitionTest, "StateMachine.CookedDefinition", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineCookedDefinitionTest::RunTest(const FString& Parameters)
+{
+	FHierarchicalStateMachine definition;
+	DefineTestStateMachine(&definition, nullptr);
+	definition.GetRootTracks()[2]->SetIndependent(true);
+
+	TArray<uint8> cookedData;
+	FHierarchicalStateMachineCookedDefinition::Cook(definition, cookedData);
+
+	UTestClass* testObject = NewObject<UTestClass>();
+	bool result = true;
+
+	do
+	{
+		FHierarchicalStateMachine loadedDefinition;
+		TEST(FHierarchicalStateMachineCookedDefinition::Load(cookedData, loadedDefinition), "Failed to load cooked definition.");
+		TEST(loadedDefinition.GetRootTracks().Num() == 3 && loadedDefinition.GetRootTracks()[0]->GetName() == TEXT("A"), "Incorrect root tracks.");
+		TEST(loadedDefinition.FindTrack("F")->IsIndependent() && !loadedDefinition.FindTrack("A")->IsIndependent(), "Incorrect independent tracks.");
+		TEST(loadedDefinition.FindState("D2")->IsInState(loadedDefinition.FindState("A2").Get()), "Incorrect hierarchy.");
+
+		TArray<uint8> recookedData;
+		FHierarchicalStateMachineCookedDefinition::Cook(loadedDefinition, recookedData);
+		TEST(recookedData == cookedData, "Cooking a loaded definition should give the same data.");
+
+		// Same indices, so the scenarios see the same callbacks order. Processors do not run independent tracks.
+		definition.FindTrack("F")->SetIndependent(false);
+		loadedDefinition.FindTrack("F")->SetIndependent(false);
+		FHierarchicalStateMachineProcessor definitionProcessor(definition);
+		FHierarchicalStateMachineProcessor processor(loadedDefinition);
+		TEST(loadedDefinition.FindState("G2")->GetIndex() == definition.FindState("G2")->GetIndex(), "Incorrect state indices.");
+		BindTestEntitiesStates(processor);
+
+		FHierarchicalStateMachineInstance stateMachine(processor, testObject);
+		TEST(RunTransitionsScenario(stateMachine, testObject), "Cooked Transitions scenario failed.");
+		testObject->bRecord = false;
+		testObject->History.Empty();
+		TEST(RunTrackTransitionScenario(stateMachine, testObject), "Cooked TrackTransition scenario failed.");
+
+		FHierarchicalStateMachine corruptedDefinition;
+		TArray<uint8> corruptedData(cookedData.GetData(), cookedData.Num() - 1);
+		TEST(!FHierarchicalStateMachineCookedDefinition::Load(corruptedData, corruptedDefinition), "Truncated data should not load.");
+		corruptedData = cookedData;
+		corruptedData[0] = 0; // Magic
+		TEST(!FHierarchicalStateMachineCookedDefinition::Load(corruptedData, corruptedDefinition), "Unknown data should not load.");
+		TEST(corruptedDefinition.GetRootTracks().Num() == 0, "Failed loads should leave the machine untouched.");
+
+		// A sub track parented to one of its own states: every index is valid, but the cycle is out of reach of the root tracks.
+		// Version 3 layout: 10 int32 of header, then 5 int32 per track (name, parentState, ...), then 2 int32 per state (name, parentTrack).
+		corruptedData = cookedData;
+		auto readInt = [&corruptedData](int32 _offset)
+		{
+			int32 value;
+			FMemory::Memcpy(&value, corruptedData.GetData() + _offset, sizeof(int32));
+			return value;
+		};
+		const int32 tracksOffset = 10 * sizeof(int32);
+		const int32 statesOffset = tracksOffset + readInt(4 * sizeof(int32)) * 5 * sizeof(int32);
+		const int32 statesCount = readInt(5 * sizeof(int32));
+		int32 cycleTrack = INDEX_NONE;
+		for (int32 stateIndex = 0; stateIndex < statesCount && cycleTrack == INDEX_NONE; ++stateIndex)
+		{
+			const int32 parentTrack = readInt(statesOffset + (stateIndex * 2 + 1) * sizeof(int32));
+			const int32 parentStateOffset = tracksOffset + (parentTrack * 5 + 1) * sizeof(int32);
+			if (readInt(parentStateOffset) != INDEX_NONE)
+			{
+				cycleTrack = parentTrack;
+				FMemory::Memcpy(corruptedData.GetData() + parentStateOffset, &stateIndex, sizeof(int32));
+			}
+		}
+		TEST(cycleTrack != INDEX_NONE, "The test definition should have sub tracks.");
+		TEST(!FHierarchicalStateMachineCookedDefinition::Load(corruptedData, corruptedDefinition), "Hierarchy cycles should not load.");
+		TEST(corruptedDefinition.GetRootTracks().Num() == 0 && !corruptedDefinition.FindState("A1").IsValid(), "Failed loads should leave the machine untouched.");
+
+	} while (false);
+
+	testObject->ConditionalBeginDestroy();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineRecordReplayTest, "StateMachine.RecordReplay", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineRecordReplayTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		FHierarchicalStateMachineRecorder recorder;
+		recorder.Begin(*s_stateMachine);
+		TEST(recorder.IsRecording(), "Recorder should be recording.");
+		TEST(RunTransitionsScenario(*s_stateMachine, s_testObject), "Recorded Transitions scenario failed.");
+		recorder.End();
+		TEST(!recorder.IsRecording(), "Recorder should not be recording anymore.");
+
+		// Replayed without callbacks, on a machine built from the same definition
+		FString mismatch;
+		FHierarchicalStateMachine replayedStateMachine;
+		DefineTestStateMachine(&replayedStateMachine, nullptr);
+		TEST(FHierarchicalStateMachineRecorder::Replay(replayedStateMachine, recorder.GetRecordedData(), &mismatch), "Replay diverged.");
+		TEST(!replayedStateMachine.IsStarted(), "Replay should end stopped, as recorded.");
+
+		TArray<uint8> truncatedData(recorder.GetRecordedData().GetData(), recorder.GetRecordedData().Num() - 1);
+		FHierarchicalStateMachine truncatedStateMachine;
+		DefineTestStateMachine(&truncatedStateMachine, nullptr);
+		TEST(!FHierarchicalStateMachineRecorder::Replay(truncatedStateMachine, truncatedData, &mismatch) && !mismatch.IsEmpty(), "Truncated recording should not replay.");
+
+		FHierarchicalStateMachine otherStateMachine;
+		otherStateMachine.AddRootTrack(TEXT("A"))->AddDefaultState(TEXT("A1"));
+		mismatch.Empty();
+		TEST(!FHierarchicalStateMachineRecorder::Replay(otherStateMachine, recorder.GetRecordedData(), &mismatch) && !mismatch.IsEmpty(), "Recording of another definition should not replay.");
+
+		// Recording a started machine begins with a snapshot
+		s_testObject->bRecord = false;
+		s_testObject->History.Empty();
+		s_stateMachine->Start();
+		s_stateMachine->PostEvent(TEXT("Event1"));
+		recorder.Begin(*s_stateMachine);
+		s_stateMachine->PostEvent(TEXT("SelfTransition"));
+		s_stateMachine->PostEvent(TEXT("Event2"));
+		s_stateMachine->Tick(0.1f);
+		recorder.End();
+		s_stateMachine->Stop();
+
+		FHierarchicalStateMachine snapshotStateMachine;
+		DefineTestStateMachine(&snapshotStateMachine, nullptr);
+		TEST(FHierarchicalStateMachineRecorder::Replay(snapshotStateMachine, recorder.GetRecordedData(), &mismatch), "Replay from snapshot diverged.");
+		TEST(snapshotStateMachine.IsStateActive(snapshotStateMachine.FindState("G1")) && snapshotStateMachine.IsStateActive(snapshotStateMachine.FindState("E1")), "Replay from snapshot ended in incorrect states.");
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineEventPrioritiesTest, "StateMachine.EventPriorities", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineEventPrioritiesTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		s_stateMachine->SetEventPriority("Event2", 1);
+		TEST(s_stateMachine->GetEventPriority("Event2") == 1 && s_stateMachine->GetEventPriority("Event1") == 0, "Incorrect event priorities.");
+
+		s_stateMachine->bImmediatelyDequeueEvents = false;
+		s_stateMachine->Start();
+		s_testObject->bRecord = true;
+
+		s_stateMachine->PostEvent("Event1");
+		s_stateMachine->PostEvent("Event2");
+		TEST(s_stateMachine->GetQueuedEventsCount() == 2, "Events should be queued.");
+		s_stateMachine->DequeueEvents();
+		TEST(s_testObject->History.Num() == 8, "Incorrect Transitions.");
+		TEST(s_testObject->History[0] == TEXT("B1_Exit"), "Higher priority event should be dequeued first.");
+		TEST(s_testObject->History[3] == TEXT("C1_Exit"), "Lower priority event should be dequeued last.");
+		s_testObject->History.Empty();
+		s_stateMachine->Stop();
+		s_testObject->History.Empty();
+
+		// Budget of one event per dequeue, the other one is carried over to the next tick
+		s_stateMachine->DequeueEventsBudget = 1;
+		s_stateMachine->ResetEventQueueMetrics();
+		s_stateMachine->Start();
+		s_stateMachine->PostEvent("Event1");
+		s_stateMachine->PostEvent("Event2");
+		s_stateMachine->DequeueEvents();
+		TEST(s_testObject->History.Num() == 3 && s_testObject->History[0] == TEXT("B1_Exit"), "Only the higher priority event should be dequeued.");
+		TEST(s_stateMachine->GetQueuedEventsCount() == 1, "Lower priority event should be carried over.");
+		TEST(s_stateMachine->GetEventQueueMetrics().spentBudgetsCount == 1 && s_stateMachine->GetEventQueueMetrics().carriedOverEventsCount == 1, "Incorrect carried over metrics.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Tick(0.5f);
+		TEST(s_testObject->History.Num() > 0 && s_testObject->History[0] == TEXT("C1_Exit"), "Carried over event should be dequeued on the next tick.");
+		TEST(s_stateMachine->GetQueuedEventsCount() == 0, "Queue should be empty.");
+		TEST(s_stateMachine->GetEventQueueMetrics().dequeuedEventsCount == 2, "Incorrect dequeued events metrics.");
+		TEST(FMath::IsNearlyEqual(s_stateMachine->GetEventQueueMetrics().maxLatency, 0.5), "Incorrect latency metrics.");
+
+		s_stateMachine->Stop();
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineSuspendTest, "StateMachine.Suspend", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineSuspendTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		UHierarchicalStateMachine::TrackHandle c = s_stateMachine->FindTrack("C");
+		UHierarchicalStateMachine::StateHandle c1 = s_stateMachine->FindState("C1");
+
+		s_stateMachine->Start();
+		s_testObject->bRecord = true;
+
+		s_stateMachine->SuspendTrack(c);
+		TEST(s_stateMachine->IsTrackSuspended(c) && s_stateMachine->IsStateSuspended(c1.Get()), "Track should be suspended.");
+		TEST(!s_stateMachine->IsStateSuspended(s_stateMachine->FindState("A1").Get()), "Parent state should not be suspended.");
+		TEST(s_testObject->History.Num() == 0, "Suspending should not run callbacks.");
+
+		s_stateMachine->Tick(0.1f);
+		TEST(s_testObject->History.Contains(TEXT("A1_Tick")) && !s_testObject->History.Contains(TEXT("C1_Tick")), "Suspended states should not tick.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->PostEvent("TrackTransition1");
+		TEST(s_testObject->History.Num() == 0 && s_stateMachine->IsStateActive(c1), "Events within a suspended track should be deferred.");
+
+		s_stateMachine->PostEvent("Event2");
+		TEST(s_testObject->History.Num() == 3 && s_testObject->History[0] == TEXT("B1_Exit"), "Events outside of a suspended track should be handled.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->ResumeTrack(c);
+		TEST(!s_stateMachine->IsTrackSuspended(c), "Track should be resumed.");
+		TEST(s_testObject->History.Num() == 2, "Deferred event should be handled on resume.");
+		TEST(s_testObject->History[0] == TEXT("C1_Exit"), "Deferred event should be handled on resume.");
+		TEST(s_testObject->History[1] == TEXT("C2_Enter"), "Deferred event should be handled on resume.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Suspend();
+		s_stateMachine->Tick(0.1f);
+		s_stateMachine->PostEvent("Event1");
+		TEST(s_testObject->History.Num() == 0, "Suspended machine should not run callbacks.");
+		TEST(s_stateMachine->GetQueuedEventsCount() == 1, "Events posted to a suspended machine should stay queued.");
+
+		s_stateMachine->Resume();
+		TEST(!s_stateMachine->IsSuspended(), "Machine should be resumed.");
+		TEST(s_testObject->History.Num() > 0 && s_testObject->History[0] == TEXT("C2_Exit"), "Queued event should be handled on resume.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Stop();
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+static bool RunTrackHistoryScenario(FName _historyTrack, FHierarchicalStateMachine::TrackHistory _history)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		s_stateMachine->FindTrack(_historyTrack)->SetHistory(_history);
+		s_stateMachine->AddEventTransition("Back", "A2", "A1");
+		s_stateMachine->Start();
+
+		s_stateMachine->PostEvent("TrackTransition1");
+		s_stateMachine->PostEvent("Event1");
+		s_testObject->bRecord = true;
+
+		// A1 resumes C2 in the same transition
+		s_stateMachine->PostEvent("Back");
+		TEST(s_testObject->History.Num() == 5, "Incorrect Transition.");
+		TEST(s_testObject->History[3] == TEXT("A1_Enter"), "Incorrect Transition.");
+		TEST(s_testObject->History[4] == TEXT("C2_Enter"), "Track should resume its last active state.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Stop();
+		s_stateMachine->Start();
+		TEST(s_stateMachine->IsStateActive(s_stateMachine->FindState("C1")), "History should be reset by Start.");
+		s_stateMachine->Stop();
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTrackHistoryTest, "StateMachine.TrackHistory", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineTrackHistoryTest::RunTest(const FString& Parameters)
+{
+	bool result = true;
+
+	do
+	{
+		TEST(RunTrackHistoryScenario("C", FHierarchicalStateMachine::TrackHistory_Shallow), "Shallow history scenario failed.");
+
+		// C has no history of its own but is within A
+		TEST(RunTrackHistoryScenario("A", FHierarchicalStateMachine::TrackHistory_Deep), "Deep history scenario failed.");
+
+	} while (false);
+
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineEventRejectionTest, "StateMachine.EventRejection", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineEventRejectionTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		TEST(!s_stateMachine->CanHandleEvent("Event1"), "Stopped machine should not handle events.");
+
+		s_stateMachine->Start();
+		s_testObject->bRecord = true;
+
+		TEST(s_stateMachine->CanHandleEvent("Event1"), "Event1 should be handled from A1.");
+		TEST(s_stateMachine->CanHandleEvent("Event2"), "Event2 should be handled from B1.");
+		TEST(s_stateMachine->CanHandleEvent("TrackTransition1"), "TrackTransition1 should be handled from C.");
+		TEST(!s_stateMachine->CanHandleEvent("SelfTransition"), "SelfTransition should not be handled while G is inactive.");
+
+		s_stateMachine->PostEvent("SelfTransition");
+		TEST(s_testObject->History.Num() == 0, "Unhandled event triggered a transition.");
+
+		s_stateMachine->PostEvent("Event1");
+		TEST(s_stateMachine->CanHandleEvent("SelfTransition"), "SelfTransition should be handled from G1.");
+		TEST(!s_stateMachine->CanHandleEvent("TrackTransition1"), "TrackTransition1 should not be handled while C is inactive.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->PostEvent("SelfTransition");
+		TEST(s_testObject->History.Num() == 2, "Handled event was rejected.");
+		s_testObject->History.Empty();
+
+		s_stateMachine->Stop();
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+static UHierarchicalStateMachine* BuildRawCallbacksStateMachine(UTestClass* _testObject)
+{
+	UHierarchicalStateMachine* stateMachine = NewObject<UHierarchicalStateMachine>();
+
+	STATEMACHINE_DEFINITION(stateMachine)
+	(
+		TRACK(A)
+		(
+			DEFAULT_STATE(A1)
+			(
+				STATE_ENTER_RAW(_testObject, &UTestClass::A1_Enter);
+				STATE_TICK_RAW(_testObject, &UTestClass::A1_Tick);
+				STATE_EXIT_RAW(_testObject, &UTestClass::A1_Exit);
+			);
+			STATE(A2)
+			(
+				STATE_ENTER_RAW(_testObject, &UTestClass::A2_Enter);
+				STATE_TICK_RAW(_testObject, &UTestClass::A2_Tick);
+				STATE_EXIT_RAW(_testObject, &UTestClass::A2_Exit);
+			);
+		);
+		TRACK(B)
+		(
+			DEFAULT_STATE(B1)
+			(
+				STATE_TICK_BATCHED(_testObject, &UTestClass::B1_BatchTick);
+			);
+		);
+
+		TRANSITION_EVENT("Event1", A1, A2);
+	);
+
+	return stateMachine;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineRawCallbacksTest, "StateMachine.RawCallbacks", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineRawCallbacksTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObjects[2] = { NewObject<UTestClass>(), NewObject<UTestClass>() };
+	UHierarchicalStateMachine* stateMachines[2] = { BuildRawCallbacksStateMachine(testObjects[0]), BuildRawCallbacksStateMachine(testObjects[1]) };
+	UTestClass::BatchTickCount = 0;
+	bool result = true;
+
+	do
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			testObjects[i]->bRecord = true;
+			stateMachines[i]->Start();
+		}
+		TEST(testObjects[0]->History.Num() == 1 && testObjects[0]->History[0] == TEXT("A1_Enter"), "Raw Enter was not called.");
+
+		stateMachines[0]->PostEvent("Event1");
+		TEST(testObjects[0]->History.Num() == 3, "Incorrect Transition.");
+		TEST(testObjects[0]->History[1] == TEXT("A1_Exit"), "Raw Exit was not called.");
+		TEST(testObjects[0]->History[2] == TEXT("A2_Enter"), "Raw Enter was not called.");
+		testObjects[0]->History.Empty();
+		testObjects[1]->History.Empty();
+
+		UHierarchicalStateMachine::TickBatched(MakeArrayView(stateMachines), 0.f);
+		TEST(UTestClass::BatchTickCount == 1, "Batched tick should be called once for all machines.");
+		TEST(testObjects[0]->History.Num() == 2, "Incorrect Tick Sequence.");
+		TEST(testObjects[0]->History[0] == TEXT("A2_Tick"), "Incorrect Tick Sequence.");
+		TEST(testObjects[0]->History[1] == TEXT("B1_BatchTick"), "Incorrect Tick Sequence.");
+		TEST(testObjects[1]->History.Num() == 2, "Incorrect Tick Sequence.");
+		TEST(testObjects[1]->History[0] == TEXT("A1_Tick"), "Incorrect Tick Sequence.");
+		TEST(testObjects[1]->History[1] == TEXT("B1_BatchTick"), "Incorrect Tick Sequence.");
+		testObjects[1]->History.Empty();
+
+		stateMachines[1]->Tick(0.f);
+		TEST(UTestClass::BatchTickCount == 2, "Batch tick function should also be called by Tick.");
+		TEST(testObjects[1]->History.Num() == 2, "Incorrect Tick Sequence.");
+
+		for (int i = 0; i < 2; ++i)
+		{
+			stateMachines[i]->Stop();
+		}
+
+	} while (false);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		stateMachines[i]->ConditionalBeginDestroy();
+		testObjects[i]->ConditionalBeginDestroy();
+	}
+	GEngine->PerformGarbageCollectionAndCleanupActors();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachinePoolTest, "StateMachine.Pool", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachinePoolTest::RunTest(const FString& Parameters)
+{
+	UTestClass* testObjects[3] = { NewObject<UTestClass>(), NewObject<UTestClass>(), NewObject<UTestClass>() };
+	UHierarchicalStateMachine* prototype = BuildRawCallbacksStateMachine(testObjects[0]);
+	UHierarchicalStateMachineObjectPool* objectPool = NewObject<UHierarchicalStateMachineObjectPool>();
+	for (UTestClass* testObject : testObjects)
+	{
+		testObject->bRecord = true;
+	}
+	bool result = true;
+
+	do
+	{
+		FHierarchicalStateMachinePool pool(*prototype);
+		pool.Reserve(2);
+		TEST(pool.GetCount() == 2 && pool.GetFreeCount() == 2, "Incorrect reserved count.");
+
+		void* owners[2] = { testObjects[1], testObjects[2] };
+		TArray<FHierarchicalStateMachine*> stateMachines;
+		pool.Acquire(MakeArrayView(owners), stateMachines);
+		TEST(stateMachines.Num() == 2 && pool.GetFreeCount() == 0 && pool.GetCount() == 2, "Bulk acquire should use the reserved machines.");
+
+		stateMachines[0]->Start();
+		stateMachines[0]->PostEvent("Event1");
+		TEST(testObjects[0]->History.Num() == 0, "Clones should not call the callbacks of the prototype owner.");
+		TEST(testObjects[1]->History.Num() == 3 && testObjects[1]->History[2] == TEXT("A2_Enter"), "Clones should call the callbacks of their owner.");
+		TEST(testObjects[2]->History.Num() == 0, "Incorrect owner.");
+		testObjects[1]->History.Empty();
+
+		stateMachines[0]->bImmediatelyDequeueEvents = false;
+		stateMachines[0]->PostEvent("Event1");
+		pool.Release(stateMachines[0]);
+		TEST(testObjects[1]->History.Num() == 1 && testObjects[1]->History[0] == TEXT("A2_Exit"), "Released machines should be stopped.");
+		TEST(stateMachines[0]->GetQueuedEventsCount() == 0, "Released machines should forget their events.");
+		testObjects[1]->History.Empty();
+
+		FHierarchicalStateMachine* recycledStateMachine = pool.Acquire(testObjects[2]);
+		TEST(recycledStateMachine == stateMachines[0] && pool.GetCount() == 2, "Released machines should be recycled.");
+		recycledStateMachine->Start();
+		TEST(testObjects[2]->History.Num() == 1 && testObjects[2]->History[0] == TEXT("A1_Enter"), "Recycled machines should be rebound.");
+		TEST(testObjects[1]->History.Num() == 0, "Recycled machines should not call their previous owner.");
+		testObjects[2]->History.Empty();
+
+		pool.Release(recycledStateMachine);
+		pool.Release(stateMachines[1]);
+		FHierarchicalStateMachine* acquiredStateMachines[3] = { pool.Acquire(testObjects[1]), pool.Acquire(testObjects[1]), nullptr };
+		TEST(pool.GetCount() == 2, "Pools should only grow when empty.");
+		acquiredStateMachines[2] = pool.Acquire(testObjects[1]);
+		TEST(pool.GetCount() == 3 && pool.GetFreeCount() == 0, "Pools should grow when empty.");
+		for (FHierarchicalStateMachine* acquiredStateMachine : acquiredStateMachines)
+		{
+			pool.Release(acquiredStateMachine);
+		}
+
+		// Broadcasts between a release and the next acquire must not reach the next owner
+		{
+			FHierarchicalStateMachineBroadcaster broadcaster;
+			FHierarchicalStateMachine* broadcastStateMachine = pool.Acquire(testObjects[1]);
+			broadcaster.Register(broadcastStateMachine);
+			broadcastStateMachine->Start();
+			pool.Release(broadcastStateMachine);
+			TEST(broadcaster.GetSubscribersCount("Event1") == 0, "Released machines should leave their broadcasters.");
+			TEST(broadcaster.Broadcast("Event1") == 0 && broadcastStateMachine->GetQueuedEventsCount() == 0, "Broadcasts should not reach released machines.");
+			testObjects[1]->History.Empty();
+
+			FHierarchicalStateMachine* nextStateMachine = pool.Acquire(testObjects[2]);
+			TEST(nextStateMachine == broadcastStateMachine, "Released machines should be recycled.");
+			nextStateMachine->Start();
+			TEST(testObjects[2]->History.Num() == 1 && testObjects[2]->History[0] == TEXT("A1_Enter"), "Recycled machines should not dequeue stale broadcasts.");
+			TEST(nextStateMachine->IsStateActive(nextStateMachine->FindState("A1")), "Recycled machines should start in their default states.");
+			pool.Release(nextStateMachine);
+			testObjects[2]->History.Empty();
+		}
+
+		// Delegates bound with the definition macros follow the owner too
+		for (UTestClass* testObject : testObjects)
+		{
+			testObject->History.Empty();
+		}
+		FHierarchicalStateMachine delegatesPrototype;
+		DefineTestStateMachine(&delegatesPrototype, testObjects[0]);
+		FHierarchicalStateMachinePool delegatesPool(delegatesPrototype, testObjects[0]);
+		FHierarchicalStateMachine* delegatesStateMachine = delegatesPool.Acquire(testObjects[1]);
+		delegatesStateMachine->Start();
+		TEST(testObjects[0]->History.Num() == 0, "Clones should not call the delegates of the prototype owner.");
+		TEST(testObjects[1]->History.Num() == 4 && testObjects[1]->History[0] == TEXT("A1_Enter"), "Clones should call the delegates of their owner.");
+		testObjects[1]->History.Empty();
+		delegatesPool.Release(delegatesStateMachine);
+		TEST(testObjects[1]->History.Num() == 4, "Released clones should exit their states.");
+		testObjects[1]->History.Empty();
+		delegatesStateMachine = delegatesPool.Acquire(testObjects[2]);
+		delegatesStateMachine->Start();
+		TEST(testObjects[1]->History.Num() == 0 && testObjects[2]->History.Num() == 4, "Recycled clones should call the delegates of their new owner.");
+		testObjects[2]->History.Empty();
+		delegatesPool.Release(delegatesStateMachine);
+		testObjects[2]->History.Empty();
+
+		objectPool->Initialize(prototype);
+		objectPool->Reserve(1);
+		UHierarchicalStateMachine* stateMachine = objectPool->Acquire(testObjects[2]);
+		TEST(stateMachine && stateMachine->GetOuter() == objectPool && objectPool->GetFreeCount() == 0, "Object pools should use the reserved machines.");
+		stateMachine->Start();
+		TEST(testObjects[2]->History.Num() == 1 && testObjects[2]->History[0] == TEXT("A1_Enter"), "Pooled objects should call the callbacks of their owner.");
+		objectPool->Release(stateMachine);
+		TEST(!stateMachine->IsStarted() && objectPool->GetFreeCount() == 1, "Released objects should be stopped and recycled.");
+
+	} while (false);
+
+	objectPool->ConditionalBeginDestroy();
+	prototype->ConditionalBeginDestroy();
+	for (UTestClass* testObject : testObjects)
+	{
+		testObject->ConditionalBeginDestroy();
+	}
+	GEngine->PerformGarbageCollectionAndCleanupActors();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineMemoryTest, "StateMachine.Memory", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineMemoryTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		SIZE_T definitionSize = 0;
+		SIZE_T runtimeSize = 0;
+		s_stateMachine->GetAllocatedSize(definitionSize, runtimeSize);
+		TEST(definitionSize >= 15 * sizeof(UHierarchicalStateMachine::State) + 7 * sizeof(UHierarchicalStateMachine::Track), "Definition size does not account for all nodes.");
+
+		s_stateMachine->Start();
+		SIZE_T startedDefinitionSize = 0;
+		SIZE_T startedRuntimeSize = 0;
+		s_stateMachine->GetAllocatedSize(startedDefinitionSize, startedRuntimeSize);
+		TEST(startedRuntimeSize > runtimeSize, "Runtime size does not account for current states.");
+
+		FResourceSizeEx resourceSize(EResourceSizeMode::Exclusive);
+		s_stateMachine->GetResourceSizeEx(resourceSize);
+		TEST(resourceSize.GetTotalMemoryBytes() >= startedDefinitionSize + startedRuntimeSize, "Resource size does not include allocated size.");
+
+		s_stateMachine->Stop();
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineCurrentStatesStringTest, "StateMachine.CurrentStatesString", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineCurrentStatesStringTest::RunTest(const FString& Parameters)
+{
+	BuildTestStateMachine();
+	bool result = true;
+
+	do
+	{
+		s_stateMachine->Start();
+
+		uint32 version = s_stateMachine->GetConfigurationVersion();
+		const TCHAR* cachedString = *s_stateMachine->GetCurrentStatesString();
+		TEST(s_stateMachine->GetCurrentStatesString().Contains(TEXT("A: A1")), "Current states string is missing A1.");
+		TEST(*s_stateMachine->GetCurrentStatesString() == cachedString, "Current states string was rebuilt without configuration change.");
+
+		s_stateMachine->Tick(0.1f);
+		TEST(s_stateMachine->GetConfigurationVersion() == version, "Ticking changed the configuration version.");
+
+		s_stateMachine->PostEvent("Event1");
+		TEST(s_stateMachine->GetConfigurationVersion() != version, "Transition did not change the configuration version.");
+		TEST(!s_stateMachine->GetCurrentStatesString().Contains(TEXT("A: A1")), "Current states string was not rebuilt after a transition.");
+
+		s_stateMachine->Stop();
+		TEST(s_stateMachine->GetCurrentStatesString().IsEmpty(), "Current states string was not cleared on stop.");
+
+	} while (false);
+
+	DestroyTestStateMachine();
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineStatsTest, "StateMachine.Stats", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineStatsTest::RunTest(const FString& Parameters)
+{
+	bool result = true;
+
+#if STATEMACHINE_STATS_ENABLED
+	do
+	{
+		typedef FHierarchicalStateMachineStats Stats;
+
+		// Drops what was gathered since the end of the last frame, the test then runs within a single publication
+		Stats::PublishFrame();
+		const int32 liveMachines = Stats::GetLastPublishedFrame().liveMachines;
+		const int32 activeStates = Stats::GetLastPublishedFrame().activeStates;
+
+		FHierarchicalStateMachine stateMachine;
+		stateMachine.AddRootTrack("X")->AddDefaultState("X1");
+		stateMachine.GetRootTracks()[0]->AddState("X2");
+		stateMachine.AddEventTransition("Go", "X1", "X2");
+		stateMachine.AddEventTransition("Back", "X2", "X1");
+		stateMachine.Start();
+
+		stateMachine.bImmediatelyDequeueEvents = false;
+		stateMachine.PostEvent("Go");
+		stateMachine.PostEvent("Back");
+		stateMachine.PostEvent("Go");
+		stateMachine.Tick(0.1f);
+		TEST(stateMachine.GetQueuedEventsCount() == 0, "Tick did not dequeue every event.");
+
+		// Go cannot fire from X2 and nothing is pending, so it is rejected when posted
+		stateMachine.bImmediatelyDequeueEvents = true;
+		stateMachine.PostEvent("Go");
+
+		Stats::PublishFrame();
+		const Stats::FrameValues& frame = Stats::GetLastPublishedFrame();
+		TEST(frame.liveMachines == liveMachines + 1, "Incorrect live machines.");
+		TEST(frame.activeStates == activeStates + 1, "Incorrect active states.");
+		TEST(frame.eventsPosted == 4, "Incorrect posted events count.");
+		TEST(frame.eventsDequeued == 3, "Incorrect dequeued events count.");
+		TEST(frame.eventsRejected == 1, "Incorrect rejected events count.");
+		TEST(frame.transitions == 3, "Incorrect transitions count.");
+		TEST(frame.averageExitSetSize == 1.f && frame.averageEnterSetSize == 1.f, "Incorrect average exit and enter set sizes.");
+		TEST(frame.queueHighWaterMark == 3, "Incorrect queue high-water mark.");
+		TEST(frame.eventsCarriedOver == 0, "No event should be carried over without a budget.");
+
+		Stats::PublishFrame();
+		TEST(Stats::GetLastPublishedFrame().eventsPosted == 0 && Stats::GetLastPublishedFrame().transitions == 0, "Per frame counts were not reset by PublishFrame.");
+		TEST(Stats::GetLastPublishedFrame().liveMachines == liveMachines + 1, "Totals should not be reset by PublishFrame.");
+
+		stateMachine.Stop();
+
+	} while (false);
+#endif
+
+	return result;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineTraceTest, "StateMachine.Trace", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineTraceTest::RunTest(const FString& Parameters)
+{
+	typedef FHierarchicalStateMachineTrace Trace;
+	typedef FHierarchicalStateMachineTraceEvent TraceEvent;
+
+	// Every event written by this test names itself after its id, so that torn reads can be told apart
+	auto writeEvent = [](int32 _id, EHierarchicalStateMachineTraceType _type) { Trace::Write(uint32(_id), _type, FName(TEXT("Trace"), _id)); };
+	auto isTorn = [](const TraceEvent& _event) { return _event.name != FName(TEXT("Trace"), int32(_event.stateMachineId)); };
+
+	Trace::AddListener();
+	bool result = true;
+
+	do
+	{
+		TArray<TraceEvent> events;
+		uint64 cursor = Trace::GetWriteCursor();
+		for (int32 i = 0; i < 3; ++i)
+		{
+			writeEvent(i, EHierarchicalStateMachineTraceType::StateEntered);
+		}
+		TEST(Trace::Read(cursor, events) == 0 && events.Num() == 3, "Incorrect events read.");
+		TEST(events[0].stateMachineId == 0 && events[2].stateMachineId == 2 && events[2].type == EHierarchicalStateMachineTraceType::StateEntered, "Events should be read in writing order.");
+		TEST(cursor == Trace::GetWriteCursor(), "Reads should move the cursor to the last written event.");
+		events.Reset();
+		TEST(Trace::Read(cursor, events) == 0 && events.Num() == 0, "Events should only be read once.");
+
+		// A reader behind by more than the capacity loses the oldest events, then reads the ones left in the buffer in order
+		const int32 overwrittenCount = 10;
+		for (int32 i = 0; i < Trace::Capacity + overwrittenCount; ++i)
+		{
+			writeEvent(i, EHierarchicalStateMachineTraceType::StateExited);
+		}
+		TEST(Trace::Read(cursor, events) == overwrittenCount && events.Num() == Trace::Capacity, "Wrapped events should be counted as lost.");
+		TEST(events[0].stateMachineId == overwrittenCount && events.Last().stateMachineId == Trace::Capacity + overwrittenCount - 1, "Incorrect events read after wrapping.");
+		TEST(!events.ContainsByPredicate(isTorn), "Torn events were read.");
+
+		// Writers on other threads lap the reader while it copies slots: a slot rewritten during its copy fails the sequence check
+		// and is counted as lost, never returned
+		const uint64 concurrentStart = Trace::GetWriteCursor();
+		cursor = concurrentStart;
+		events.Reset();
+		int32 lostCount = 0;
+		TArray<TFuture<void>> writers;
+		for (int32 i = 0; i < 4; ++i)
+		{
+			writers.Add(Async(EAsyncExecution::ThreadPool, [writeEvent]()
+			{
+				for (int32 j = 0; j < 4 * Trace::Capacity; ++j)
+				{
+					writeEvent(j, EHierarchicalStateMachineTraceType::EventPopped);
+				}
+			}));
+		}
+		bool writing = true;
+		while (writing)
+		{
+			// One last read once every writer is done
+			writing = writers.ContainsByPredicate([](const TFuture<void>& _writer) { return !_writer.IsReady(); });
+			lostCount += Trace::Read(cursor, events);
+		}
+		TEST(uint64(events.Num() + lostCount) == Trace::GetWriteCursor() - concurrentStart, "Every event should be either read or counted as lost.");
+		TEST(!events.ContainsByPredicate(isTorn), "Torn events were read.");
+
+	} while (false);
+
+	Trace::RemoveListener();
+	return result;
+}
+
+// Differential run against the reference port, see HSM.Fuzz for longer runs
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FStateMachineFuzzTest, "StateMachine.Fuzz", EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+bool FStateMachineFuzzTest::RunTest(const FString& Parameters)
+{
+	return FHierarchicalStateMachineFuzzer::Run(1, 2000, *GLog) == 0;
+}
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Modules/ModuleManager.h"
+#include "HierarchicalStateMachine.h"
 
 #include "StateMachineTests.generated.h"
 
@@ -77,4 +78,20 @@ public:
 	void G2_Enter();
 	void G2_Tick(float _dt);
 	void G2_Exit();
+
+	static int32 BatchTickCount;
+	static void B1_BatchTick(TArrayView<void*> _owners, float _dt);
+};
+
+UCLASS()
+class UTestPrefetchStateMachine : public UHierarchicalStateMachine
+{
+	GENERATED_BODY()
+
+public:
+	// Prefetches requested instead of loaded, with their priority
+	TArray<TPair<FSoftObjectPath, TAsyncLoadPriority>> Requests;
+
+protected:
+	virtual TSharedPtr<FStreamableHandle> _RequestPrefetch(const FSoftObjectPath& _asset, TAsyncLoadPriority _priority) override;
 };
@@ -40,6 +40,7 @@ public class StateMachineTests : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore",
+				"StateMachineCore",
 				"StateMachineRuntime"
 				// ... add private dependencies that you statically link with here ...
 			}